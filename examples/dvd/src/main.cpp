@@ -14,6 +14,7 @@
 #include <render/vulkan/RenderPass.h>
 #include <render/vulkan/Texture.h>
 #include <render/vulkan/Queue.h>
+#include <render/vulkan/TransferBatch.h>
 #include <render/vulkan/Framebuffer.h>
 #include <render/core/FrameContext.h>
 #include <render/core/FrameManager.h>
@@ -275,7 +276,7 @@ class Screensaver : public IWithRendering {
         }
 
         bool initDrawData() {
-            m_vertices = allocateVertices(&m_vfmt, 4);
+            m_vertices = allocateVertices(&m_vfmt, 4, BP_DEVICE_LOCAL);
             if (!m_vertices) abort();
 
             if (m_vertices->beginUpdate()) {
@@ -288,6 +289,8 @@ class Screensaver : public IWithRendering {
                 m_vertices->commitUpdate();
             }
 
+            if (!getTransferBatch()->flush(getLogicalDevice()->getGraphicsQueue())) abort();
+
             m_uniforms = allocateUniformObject(&m_ufmt);
             if (!m_uniforms) abort();
 
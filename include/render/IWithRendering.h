@@ -17,17 +17,25 @@ namespace render {
         class SwapChain;
         class SwapChainSupport;
         class ShaderCompiler;
+        class PipelineCache;
+        class PipelineCompiler;
         class LogicalDevice;
         class CommandBuffer;
         class Pipeline;
         class RenderPass;
         class VertexBufferFactory;
         class Vertices;
+        class TransferBatch;
+        class IndexBufferFactory;
+        class Indices;
         class UniformBufferFactory;
         class UniformObject;
+        class StorageBufferFactory;
+        class StorageArray;
         class DescriptorFactory;
         class DescriptorSet;
         class Texture;
+        class BindlessTable;
     };
 
     namespace core {
@@ -56,6 +64,7 @@ namespace render {
             virtual bool setupDevice(vulkan::LogicalDevice* device);
             virtual bool setupSwapchain(vulkan::SwapChain* swapChain, const vulkan::SwapChainSupport& support);
             virtual bool setupShaderCompiler(vulkan::ShaderCompiler* shaderCompiler);
+            virtual bool setupPipelineCache(vulkan::PipelineCache* cache);
             virtual void onWindowResize(::utils::Window* win, u32 width, u32 height);
 
             ::utils::Window* getWindow() const;
@@ -66,12 +75,20 @@ namespace render {
             vulkan::SwapChain* getSwapChain() const;
             vulkan::RenderPass* getRenderPass() const;
             vulkan::ShaderCompiler* getShaderCompiler() const;
+            vulkan::PipelineCache* getPipelineCache() const;
+            vulkan::PipelineCompiler* getPipelineCompiler() const;
+
+            // Only exists if setupDevice called LogicalDevice::enableBindless
+            vulkan::BindlessTable* getBindlessTable() const;
             utils::SimpleDebugDraw* getDebugDraw() const;
             utils::ImGuiContext* getImGui() const;
             core::FrameManager* getFrameManager() const;
+            vulkan::TransferBatch* getTransferBatch() const;
 
-            vulkan::Vertices* allocateVertices(core::DataFormat* format, u32 count);
+            vulkan::Vertices* allocateVertices(core::DataFormat* format, u32 count, BUFFER_PLACEMENT placement = BP_HOST_VISIBLE);
+            vulkan::Indices* allocateIndices(u32 count, bool use32BitIndices = false);
             vulkan::UniformObject* allocateUniformObject(core::DataFormat* format);
+            vulkan::StorageArray* allocateStorageArray(core::DataFormat* format, u32 count);
             vulkan::DescriptorSet* allocateDescriptor(vulkan::Pipeline* pipeline);
             core::FrameContext* getFrame();
             void releaseFrame(core::FrameContext* frame);
@@ -85,9 +102,14 @@ namespace render {
             vulkan::SwapChain* m_swapChain;
             vulkan::RenderPass* m_renderPass;
             vulkan::ShaderCompiler* m_shaderCompiler;
+            vulkan::PipelineCache* m_pipelineCache;
+            vulkan::PipelineCompiler* m_pipelineCompiler;
             vulkan::VertexBufferFactory* m_vboFactory;
+            vulkan::IndexBufferFactory* m_iboFactory;
             vulkan::UniformBufferFactory* m_uboFactory;
+            vulkan::StorageBufferFactory* m_sboFactory;
             vulkan::DescriptorFactory* m_descriptorFactory;
+            vulkan::BindlessTable* m_bindless;
             utils::SimpleDebugDraw* m_debugDraw;
             utils::ImGuiContext* m_imgui;
             core::FrameManager* m_frames;
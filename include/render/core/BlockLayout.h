@@ -0,0 +1,266 @@
+#pragma once
+#include <render/types.h>
+#include <render/core/DataFormat.h>
+
+#include <type_traits>
+#include <utility>
+#include <string.h>
+
+namespace render {
+    namespace core {
+        constexpr u32 AlignUp(u32 value, u32 alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        // Number of column vectors in a type, 1 for scalars and vectors
+        constexpr u32 TypeColumns(DATA_TYPE type) {
+            switch (type) {
+                case dt_mat2i: case dt_mat2f: case dt_mat2ui: return 2;
+                case dt_mat3i: case dt_mat3f: case dt_mat3ui: return 3;
+                case dt_mat4i: case dt_mat4f: case dt_mat4ui: return 4;
+                default: return 1;
+            }
+        }
+
+        // Type of each column of a matrix, the type itself for scalars and vectors
+        constexpr DATA_TYPE ColumnType(DATA_TYPE type) {
+            switch (type) {
+                case dt_mat2i: return dt_vec2i;
+                case dt_mat2f: return dt_vec2f;
+                case dt_mat2ui: return dt_vec2ui;
+                case dt_mat3i: return dt_vec3i;
+                case dt_mat3f: return dt_vec3f;
+                case dt_mat3ui: return dt_vec3ui;
+                case dt_mat4i: return dt_vec4i;
+                case dt_mat4f: return dt_vec4f;
+                case dt_mat4ui: return dt_vec4ui;
+                default: return type;
+            }
+        }
+
+        // Number of 4 byte components in each column of a type
+        constexpr u32 TypeRows(DATA_TYPE type) {
+            switch (type) {
+                case dt_int: case dt_float: case dt_uint: return 1;
+                case dt_vec2i: case dt_vec2f: case dt_vec2ui: return 2;
+                case dt_mat2i: case dt_mat2f: case dt_mat2ui: return 2;
+                case dt_vec3i: case dt_vec3f: case dt_vec3ui: return 3;
+                case dt_mat3i: case dt_mat3f: case dt_mat3ui: return 3;
+                case dt_vec4i: case dt_vec4f: case dt_vec4ui: return 4;
+                case dt_mat4i: case dt_mat4f: case dt_mat4ui: return 4;
+                default: return 0;
+            }
+        }
+
+        constexpr u32 BlockAlignment(DATA_TYPE type, BLOCK_LAYOUT layout, bool isArray) {
+            u32 rows = TypeRows(type);
+            u32 alignment = rows == 1 ? 4 : (rows == 2 ? 8 : 16);
+
+            // matrices are laid out as arrays of column vectors
+            if (layout == BL_STD140 && (isArray || TypeColumns(type) > 1)) return 16;
+            return alignment;
+        }
+
+        // Distance between the columns of a matrix, or the size of a scalar or vector
+        constexpr u32 BlockColumnStride(DATA_TYPE type, BLOCK_LAYOUT layout) {
+            if (TypeColumns(type) == 1) return TypeRows(type) * 4;
+            return BlockAlignment(type, layout, true);
+        }
+
+        // Bytes occupied by a single value of a type that isn't part of an array
+        constexpr u32 BlockElementSize(DATA_TYPE type, BLOCK_LAYOUT layout) {
+            return TypeColumns(type) * BlockColumnStride(type, layout);
+        }
+
+        constexpr u32 BlockArrayStride(DATA_TYPE type, BLOCK_LAYOUT layout) {
+            return AlignUp(BlockElementSize(type, layout), BlockAlignment(type, layout, true));
+        }
+
+        template <typename T>
+        struct DataTypeOf { static constexpr bool IsSupported = false; };
+
+        #define dataType(T, dt) template <> struct DataTypeOf<T> { static constexpr bool IsSupported = true; static constexpr DATA_TYPE Type = dt; }
+        dataType(i32, dt_int);
+        dataType(f32, dt_float);
+        dataType(u32, dt_uint);
+        dataType(vec2i, dt_vec2i);
+        dataType(vec2f, dt_vec2f);
+        dataType(vec2ui, dt_vec2ui);
+        dataType(vec3i, dt_vec3i);
+        dataType(vec3f, dt_vec3f);
+        dataType(vec3ui, dt_vec3ui);
+        dataType(vec4i, dt_vec4i);
+        dataType(vec4f, dt_vec4f);
+        dataType(vec4ui, dt_vec4ui);
+        dataType(mat2f, dt_mat2f);
+        dataType(mat3f, dt_mat3f);
+        dataType(mat4f, dt_mat4f);
+        #undef dataType
+
+        template <auto Member>
+        struct BlockMember;
+
+        template <typename Cls, typename T, T Cls::* Member>
+        struct BlockMember<Member> {
+            using Class = Cls;
+            using Element = std::remove_extent_t<T>;
+
+            static_assert(DataTypeOf<Element>::IsSupported, "Member type can't be used in a StructLayout");
+
+            // Arrays of 1 are treated as single values, the same way DataFormat treats them
+            static constexpr u32 Count = std::is_array_v<T> ? u32(std::extent_v<T>) : 1;
+            static constexpr bool IsArray = Count > 1;
+            static constexpr DATA_TYPE Type = DataTypeOf<Element>::Type;
+
+            static constexpr u32 ColumnSize = TypeRows(Type) * 4;
+
+            static_assert(sizeof(Element) == TypeColumns(Type) * ColumnSize, "Member type has unexpected padding");
+        };
+
+        template <auto First, auto... Rest>
+        struct FirstBlockMember {
+            using Info = BlockMember<First>;
+        };
+
+        /*
+         * Compile time std140 / std430 layout of a C++ struct, built from member pointers in declaration
+         * order. Pack copies each member to its offset in the block with the column and array strides
+         * resolved at compile time, or copies the whole struct at once when its layout already matches.
+         *
+         *     struct uniforms {
+         *         mat4f viewProj;
+         *         vec3f color;
+         *         f32 alpha;
+         *
+         *         using UniformLayout = core::StructLayout<BL_STD140, &uniforms::viewProj, &uniforms::color, &uniforms::alpha>;
+         *     };
+         *
+         * UniformObject::set uses UniformLayout (and StorageArray::set uses StorageLayout) instead of
+         * interpreting the buffer's DataFormat when the struct declares one. Describe adds the same members
+         * to a DataFormat so the two can't disagree.
+         */
+        template <BLOCK_LAYOUT Layout, auto... Members>
+        class StructLayout {
+            public:
+                using Class = typename FirstBlockMember<Members...>::Info::Class;
+                static_assert((std::is_same_v<typename BlockMember<Members>::Class, Class> && ...), "All members must belong to the same struct");
+
+                static constexpr BLOCK_LAYOUT Rule = Layout;
+                static constexpr u32 MemberCount = sizeof...(Members);
+
+            private:
+                struct computed_layout {
+                    u32 offsets[MemberCount];
+                    u32 size;
+                };
+
+                template <auto Member>
+                static constexpr u32 MemberAlignment() {
+                    using Info = BlockMember<Member>;
+                    return BlockAlignment(Info::Type, Layout, Info::IsArray);
+                }
+
+                template <auto Member>
+                static constexpr u32 MemberStride() {
+                    using Info = BlockMember<Member>;
+                    if constexpr (Info::IsArray) return BlockArrayStride(Info::Type, Layout);
+                    else return BlockElementSize(Info::Type, Layout);
+                }
+
+                // True when the member is stored in the block exactly as it is in memory
+                template <auto Member>
+                static constexpr bool MemberIsTight() {
+                    using Info = BlockMember<Member>;
+                    return BlockColumnStride(Info::Type, Layout) == Info::ColumnSize && MemberStride<Member>() == sizeof(typename Info::Element);
+                }
+
+                static constexpr computed_layout ComputeLayout() {
+                    computed_layout out = {};
+                    u32 end = 0;
+                    u32 maxAlignment = 4;
+                    u32 idx = 0;
+
+                    ((
+                        end = AlignUp(end, MemberAlignment<Members>()),
+                        out.offsets[idx++] = end,
+                        end += MemberStride<Members>() * BlockMember<Members>::Count,
+                        maxAlignment = MemberAlignment<Members>() > maxAlignment ? MemberAlignment<Members>() : maxAlignment
+                    ), ...);
+
+                    if (Layout == BL_STD140) maxAlignment = AlignUp(maxAlignment, 16);
+                    out.size = AlignUp(end, maxAlignment);
+                    return out;
+                }
+
+                static constexpr computed_layout Computed = ComputeLayout();
+
+            public:
+                // Size of the block, including padding at the end
+                static constexpr u32 Size = Computed.size;
+
+                static constexpr u32 Offset(u32 memberIdx) { return Computed.offsets[memberIdx]; }
+
+                static void Pack(const Class& src, void* dst) {
+                    if (IsIdentity) {
+                        memcpy(dst, &src, Size < sizeof(Class) ? Size : sizeof(Class));
+                        return;
+                    }
+
+                    PackMembers(src, (u8*)dst, std::make_index_sequence<MemberCount>());
+                }
+
+                static void Describe(DataFormat& fmt) {
+                    (fmt.addAttr(Members), ...);
+                }
+
+            private:
+                template <size_t... Indices>
+                static void PackMembers(const Class& src, u8* dst, std::index_sequence<Indices...>) {
+                    (PackMember<Members>(src, dst + Offset(Indices)), ...);
+                }
+
+                template <auto Member>
+                static void PackMember(const Class& src, u8* dst) {
+                    using Info = BlockMember<Member>;
+                    constexpr u32 elementSize = sizeof(typename Info::Element);
+                    constexpr u32 columnStride = BlockColumnStride(Info::Type, Layout);
+                    constexpr u32 stride = MemberStride<Member>();
+
+                    const u8* s = (const u8*)&(src.*Member);
+
+                    if constexpr (MemberIsTight<Member>()) {
+                        memcpy(dst, s, elementSize * Info::Count);
+                    } else if constexpr (columnStride == Info::ColumnSize) {
+                        for (u32 e = 0;e < Info::Count;e++) memcpy(dst + (e * stride), s + (e * elementSize), elementSize);
+                    } else {
+                        for (u32 e = 0;e < Info::Count;e++) {
+                            for (u32 c = 0;c < TypeColumns(Info::Type);c++) {
+                                memcpy(dst + (e * stride) + (c * columnStride), s + (e * elementSize) + (c * Info::ColumnSize), Info::ColumnSize);
+                            }
+                        }
+                    }
+                }
+
+                template <auto Member>
+                static u32 SourceOffset() {
+                    return u32((u8*)&(((Class*)nullptr)->*Member) - (u8*)nullptr);
+                }
+
+                static bool ComputeIsIdentity() {
+                    bool result = true;
+                    u32 idx = 0;
+                    ((result = result && MemberIsTight<Members>() && SourceOffset<Members>() == Offset(idx), idx++), ...);
+                    return result;
+                }
+
+                // Evaluated during static initialization, Pack is still correct if it's used before then
+                static inline const bool IsIdentity = ComputeIsIdentity();
+        };
+
+        template <typename T>
+        concept HasUniformLayout = requires { typename T::UniformLayout; };
+
+        template <typename T>
+        concept HasStorageLayout = requires { typename T::StorageLayout; };
+    };
+};
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+#include <render/types.h>
+
+#include <utils/Array.h>
+
+namespace render {
+    namespace core {
+        /*
+         * Max heap of containers ordered by how much free capacity they have, so the one with the most
+         * room is always on top. T provides the capacity through GetCapacity and stores its own position
+         * in HeapIndex, which lets update and remove run in O(log n) without searching for the item.
+         */
+        template <typename T, u32 (T::*GetCapacity)() const, u32 T::*HeapIndex>
+        class CapacityHeap {
+            public:
+                static constexpr u32 InvalidIndex = 0xFFFFFFFF;
+
+                u32 size() const { return m_items.size(); }
+                T* operator[](u32 idx) const { return m_items[idx]; }
+
+                // Item with the most free capacity, or null if the heap is empty
+                T* top() const { return m_items.size() > 0 ? m_items[0] : nullptr; }
+
+                void insert(T* item) {
+                    item->*HeapIndex = m_items.size();
+                    m_items.push(item);
+                    siftUp(item->*HeapIndex);
+                }
+
+                void remove(T* item) {
+                    u32 idx = item->*HeapIndex;
+                    if (idx >= m_items.size() || m_items[idx] != item) return;
+
+                    u32 lastIdx = m_items.size() - 1;
+                    if (idx != lastIdx) {
+                        m_items[idx] = m_items[lastIdx];
+                        m_items[idx]->*HeapIndex = idx;
+                    }
+
+                    m_items.remove(lastIdx);
+                    item->*HeapIndex = InvalidIndex;
+
+                    if (idx < m_items.size()) update(m_items[idx]);
+                }
+
+                // Must be called whenever the free capacity of an item in the heap changes
+                void update(T* item) {
+                    u32 idx = item->*HeapIndex;
+                    if (idx >= m_items.size() || m_items[idx] != item) return;
+
+                    if (idx > 0 && capacity(idx) > capacity((idx - 1) / 2)) siftUp(idx);
+                    else siftDown(idx);
+                }
+
+                template <typename F>
+                void each(F&& cb) {
+                    for (u32 i = 0;i < m_items.size();i++) cb(m_items[i]);
+                }
+
+                void clear() {
+                    for (u32 i = 0;i < m_items.size();i++) m_items[i]->*HeapIndex = InvalidIndex;
+                    m_items.clear();
+                }
+
+            protected:
+                u32 capacity(u32 idx) const { return (m_items[idx]->*GetCapacity)(); }
+
+                void swap(u32 a, u32 b) {
+                    T* t = m_items[a];
+                    m_items[a] = m_items[b];
+                    m_items[b] = t;
+                    m_items[a]->*HeapIndex = a;
+                    m_items[b]->*HeapIndex = b;
+                }
+
+                void siftUp(u32 idx) {
+                    while (idx > 0) {
+                        u32 parent = (idx - 1) / 2;
+                        if (capacity(parent) >= capacity(idx)) break;
+
+                        swap(parent, idx);
+                        idx = parent;
+                    }
+                }
+
+                void siftDown(u32 idx) {
+                    u32 count = m_items.size();
+                    while (true) {
+                        u32 largest = idx;
+                        u32 left = idx * 2 + 1;
+                        u32 right = left + 1;
+
+                        if (left < count && capacity(left) > capacity(largest)) largest = left;
+                        if (right < count && capacity(right) > capacity(largest)) largest = right;
+                        if (largest == idx) break;
+
+                        swap(largest, idx);
+                        idx = largest;
+                    }
+                }
+
+                Array<T*> m_items;
+        };
+    };
+};
\ No newline at end of file
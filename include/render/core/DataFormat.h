@@ -14,7 +14,20 @@ namespace render {
                     u32 elementCount;
                     u32 offset;
                     u32 size;
+
+                    // Size and offset of the attribute in a std140 uniform block
                     u32 uniformAlignedSize;
+                    u32 uniformOffset;
+
+                    // Size and offset of the attribute in a std430 storage block
+                    u32 storageAlignedSize;
+                    u32 storageOffset;
+                };
+
+                // One vertex shader input location
+                struct VertexAttribute {
+                    DATA_TYPE type;
+                    u32 offset;
                 };
 
                 DataFormat();
@@ -77,15 +90,40 @@ namespace render {
                 void setSize(u32 size);
                 u32 getSize() const;
                 u32 getUniformBlockSize() const;
+
+                // Size of the format in a std430 block, also the stride between elements of an array of it
+                u32 getStorageBlockSize() const;
+                u32 getStorageAlignment() const;
                 bool isValid() const;
                 bool isEqualTo(const DataFormat* format) const;
 
+                /*
+                 * Structural hash of the format, formats that are equal according to isEqualTo always
+                 * have the same hash. Updated as attributes are added, so it's free to call.
+                 */
+                u64 getHash() const;
+
+                /*
+                 * Copies an object with this format from src to dst, placing each attribute at its offset in
+                 * a block with the given layout
+                 */
+                void packBlock(BLOCK_LAYOUT layout, const void* src, void* dst) const;
+
+                /*
+                 * Flattens the format into one entry per vertex input location, in attribute order. Arrays
+                 * and nested structs are expanded and matrices are split into one entry per column
+                 */
+                void getVertexAttributes(Array<VertexAttribute>& out, u32 baseOffset = 0) const;
+
                 static u32 AttributeSize(DATA_TYPE type, bool uniformAligned = false);
             
             protected:
                 Array<Attribute> m_attrs;
                 u32 m_size;
                 u32 m_uniformBlockSize;
+                u32 m_storageBlockSize;
+                u32 m_storageAlignment;
+                u64 m_attrHash;
         };
     };
 };
\ No newline at end of file
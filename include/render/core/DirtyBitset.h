@@ -0,0 +1,78 @@
+#pragma once
+#include <render/types.h>
+
+#include <bit>
+
+namespace render {
+    namespace core {
+        /*
+         * Tracks which elements of a buffer were modified since the last time they were consumed, one bit
+         * per element. Runs of set bits are found a word (or several, with AVX2 / NEON) at a time rather
+         * than testing every element, and only the words between the first and last modification are
+         * ever scanned.
+         */
+        class DirtyBitset {
+            public:
+                DirtyBitset(u32 count);
+                ~DirtyBitset();
+
+                void set(u32 idx);
+                void setRange(u32 first, u32 count);
+                bool any() const;
+                void clear();
+                u32 getCount() const;
+
+                /*
+                 * Calls cb(first, count) for each run of set bits in order and clears them. Runs separated
+                 * by maxGap or fewer clear bits are reported as one run.
+                 */
+                template <typename F>
+                void consumeRuns(u32 maxGap, F&& cb) {
+                    if (!any()) return;
+
+                    u32 runStart = 0;
+                    u32 runEnd = 0;
+                    bool hasRun = false;
+
+                    for (u32 w = findNonZeroWord(m_minWord, m_endWord);w < m_endWord;w = findNonZeroWord(w + 1, m_endWord)) {
+                        u64 bits = m_words[w];
+                        m_words[w] = 0;
+
+                        while (bits) {
+                            u32 start = u32(std::countr_zero(bits));
+                            u64 shifted = ~(bits >> start);
+                            u32 length = shifted == 0 ? 64 - start : u32(std::countr_zero(shifted));
+                            bits = (start + length >= 64) ? 0 : bits & (~u64(0) << (start + length));
+
+                            u32 idx = (w * 64) + start;
+                            if (hasRun && idx <= runEnd + maxGap) {
+                                runEnd = idx + length;
+                                continue;
+                            }
+
+                            if (hasRun) cb(runStart, runEnd - runStart);
+                            runStart = idx;
+                            runEnd = idx + length;
+                            hasRun = true;
+                        }
+                    }
+
+                    if (hasRun) cb(runStart, runEnd - runStart);
+
+                    m_minWord = m_wordCount;
+                    m_endWord = 0;
+                }
+
+            protected:
+                // Index of the first non-zero word in [begin, end), or end if there is none
+                u32 findNonZeroWord(u32 begin, u32 end) const;
+
+                u64* m_words;
+                u32 m_count;
+                u32 m_wordCount;
+                // [m_minWord, m_endWord) covers every word with set bits, empty when m_minWord >= m_endWord
+                u32 m_minWord;
+                u32 m_endWord;
+        };
+    };
+};
\ No newline at end of file
@@ -11,16 +11,25 @@ namespace render {
         class SwapChain;
         class Framebuffer;
         class RenderPass;
+        class Pipeline;
+        class DescriptorSet;
+        class TransferBatch;
     };
 
     namespace core {
+        class DataFormat;
         class FrameManager;
+        struct TransientAllocation;
+
         class FrameContext : public ::utils::IWithLogging {
             public:
                 vulkan::CommandBuffer* getCommandBuffer() const;
                 vulkan::SwapChain* getSwapChain() const;
                 vulkan::Framebuffer* getFramebuffer() const;
                 u32 getSwapChainImageIndex() const;
+
+                // Index of this frame in [0, FrameManager::getFrameCount()), use it to select per-frame resources
+                u32 getFrameIndex() const;
                 void setClearColor(u32 attachmentIdx, const vec4f& clearColor);
                 void setClearColor(u32 attachmentIdx, const vec4ui& clearColor);
                 void setClearColor(u32 attachmentIdx, const vec4i& clearColor);
@@ -28,6 +37,33 @@ namespace render {
                 bool begin();
                 bool end();
 
+                /*
+                 * Allocates memory that stays valid until this frame's fence is waited on again, only
+                 * valid between begin() and end()
+                 */
+                bool allocTransient(u64 size, u64 alignment, TransientAllocation& out);
+
+                /*
+                 * Allocates transient space for count instances laid out according to fmt, for per-instance
+                 * data that's rebuilt every frame. Bind it with cb->bindVertexBuffer(binding, out.buffer,
+                 * out.offset) where binding was added with VK_VERTEX_INPUT_RATE_INSTANCE and draw with
+                 * firstInstance = 0
+                 */
+                bool allocInstances(const DataFormat* fmt, u32 count, TransientAllocation& out);
+
+                /*
+                 * Allocates a descriptor set that stays valid until this frame's fence is waited on again,
+                 * it must not be freed. Only valid between begin() and end()
+                 */
+                vulkan::DescriptorSet* allocateDescriptor(vulkan::Pipeline* pipeline);
+
+                /*
+                 * Records the batch's pending copies to this frame's command buffer. Its staging memory
+                 * is released when this frame's fence is waited on again, so the batch must be registered
+                 * with FrameManager::addTransferBatch. Must be called outside of a render pass
+                 */
+                void recordTransfers(vulkan::TransferBatch* batch);
+
             private:
                 friend class FrameManager;
                 FrameContext();
@@ -45,10 +81,11 @@ namespace render {
                 FrameManager* m_mgr;
 
                 VkSemaphore m_swapChainReady;
-                VkSemaphore m_renderComplete;
                 VkFence m_fence;
                 bool m_frameStarted;
+                bool m_isLive;
                 u32 m_scImageIdx;
+                u32 m_frameIdx;
         };
     };
 };
\ No newline at end of file
@@ -2,7 +2,7 @@
 #include <render/types.h>
 
 #include <utils/ILogListener.h>
-#include <utils/List.h>
+#include <vulkan/vulkan.h>
 
 namespace render {
     namespace vulkan {
@@ -12,22 +12,48 @@ namespace render {
         class SwapChain;
         class RenderPass;
         class Framebuffer;
+        class TransientDescriptorAllocator;
+        class TransferBatch;
     };
 
     namespace core {
         class FrameContext;
+        class TransientAllocator;
 
         class FrameManager : public ::utils::IWithLogging {
             public:
-                FrameManager(vulkan::SwapChain* swapChain, vulkan::RenderPass* renderPass);
+                /*
+                 * framesInFlight is the number of frames the CPU may record ahead of the GPU, it's
+                 * independent of the number of swapchain images. Each frame also gets transientBytesPerFrame
+                 * bytes of host visible memory to allocate from with FrameContext::allocTransient, and
+                 * descriptor pools of transientSetsPerPool sets for FrameContext::allocateDescriptor
+                 */
+                FrameManager(
+                    vulkan::SwapChain* swapChain,
+                    vulkan::RenderPass* renderPass,
+                    u32 framesInFlight = 2,
+                    u64 transientBytesPerFrame = 4 * 1024 * 1024,
+                    u32 transientSetsPerPool = 256
+                );
                 ~FrameManager();
 
                 vulkan::CommandPool* getCommandPool() const;
                 u32 getFrameCount() const;
+                TransientAllocator* getTransientAllocator() const;
+                vulkan::TransientDescriptorAllocator* getTransientDescriptors() const;
 
                 bool init();
                 void shutdown();
 
+                /*
+                 * Staging memory recorded to a frame with FrameContext::recordTransfers is released from
+                 * registered batches when that frame slot's fence is waited on again. Batches must be
+                 * removed before they're destroyed
+                 */
+                void addTransferBatch(vulkan::TransferBatch* batch);
+                void removeTransferBatch(vulkan::TransferBatch* batch);
+
+                // Use the returned frame's getFrameIndex() to select per-frame resources
                 FrameContext* getFrame();
                 void releaseFrame(FrameContext* frame);
 
@@ -38,18 +64,23 @@ namespace render {
                 vulkan::SwapChain* m_swapChain;
                 vulkan::LogicalDevice* m_device;
                 vulkan::CommandPool* m_cmdPool;
+                TransientAllocator* m_transient;
+                vulkan::TransientDescriptorAllocator* m_transientDescriptors;
+                Array<vulkan::TransferBatch*> m_transferBatches;
                 Array<vulkan::Framebuffer*> m_framebuffers;
 
-                struct FrameNode {
-                    FrameContext* frame;
-                    FrameNode* next;
-                    FrameNode* last;
-                };
+                // fence of the last frame that rendered to each swapchain image
+                Array<VkFence> m_imageFences;
+
+                /*
+                 * One per swapchain image rather than per frame, the frame fence doesn't guarantee that
+                 * the presentation engine is done waiting on the last signal from a frame slot
+                 */
+                Array<VkSemaphore> m_renderComplete;
 
-                FrameNode* m_freeFrames;
-                FrameNode* m_liveFrames;
-                FrameNode* m_frames;
+                Array<FrameContext*> m_frames;
                 u32 m_frameCount;
+                u32 m_nextFrameIdx;
         };
     };
 };
\ No newline at end of file
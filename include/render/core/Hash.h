@@ -0,0 +1,13 @@
+#pragma once
+#include <render/types.h>
+
+namespace render {
+    namespace core {
+        constexpr u64 HashSeed = 0xCBF29CE484222325ull;
+
+        // Mixes v into h, start from HashSeed
+        constexpr u64 HashCombine(u64 h, u64 v) {
+            return h ^ (v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2));
+        }
+    };
+};
\ No newline at end of file
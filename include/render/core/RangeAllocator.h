@@ -0,0 +1,85 @@
+#pragma once
+#include <render/types.h>
+
+namespace render {
+    namespace core {
+        /*
+         * Two level segregated fit allocator for ranges of elements within a fixed capacity. Free ranges
+         * are always coalesced with their neighbors. The head of each free list is its largest range,
+         * which keeps getLargestFreeRange constant time. Allocation and free are constant time, except
+         * when the head of a free list is removed while other ranges are left in it. The new largest
+         * range of that list is then found by walking it. Range nodes are allocated as needed, so
+         * there is no limit on the number of live ranges.
+         */
+        class RangeAllocator {
+            public:
+                struct Range {
+                    u32 offset;
+                    u32 size;
+                    void* userData;
+
+                    private:
+                        friend class RangeAllocator;
+                        bool isFree;
+                        Range* prevPhys;
+                        Range* nextPhys;
+                        Range* prevFree;
+                        Range* nextFree;
+                };
+
+                // Free ranges smaller than minSplitSize stay attached to the range they were split from
+                RangeAllocator(u32 capacity, u32 minSplitSize = 4);
+                ~RangeAllocator();
+
+                Range* allocate(u32 size);
+                void free(Range* range);
+                void reset();
+
+                u32 getCapacity() const;
+                u32 getUsedSize() const;
+                u32 getFreeSize() const;
+                u32 getAllocationCount() const;
+                u32 getFreeRangeCount() const;
+                u32 getLargestFreeRange() const;
+
+                // 0 when all free space is contiguous, approaching 1 as it is split into many small ranges
+                f32 getFragmentation() const;
+
+                // Calls cb for every allocated range, in order of offset
+                template <typename F>
+                void eachAllocated(F&& cb) const {
+                    Range* r = m_physHead;
+                    while (r) {
+                        Range* next = r->nextPhys;
+                        if (!r->isFree) cb(r);
+                        r = next;
+                    }
+                }
+
+            protected:
+                static constexpr u32 SL_BITS = 4;
+                static constexpr u32 SL_COUNT = 1 << SL_BITS;
+                static constexpr u32 FL_COUNT = 32;
+
+                static void mapSize(u32 size, u32& fl, u32& sl);
+                Range* findFree(u32 size);
+                void insertFree(Range* r);
+                void removeFree(Range* r);
+                Range* getNode();
+                void releaseNode(Range* r);
+                void destroyNodes();
+
+                u32 m_capacity;
+                u32 m_minSplitSize;
+                u32 m_usedSize;
+                u32 m_allocationCount;
+                u32 m_freeRangeCount;
+
+                u32 m_flBitmap;
+                u32 m_slBitmap[FL_COUNT];
+                Range* m_freeHeads[FL_COUNT][SL_COUNT];
+                Range* m_physHead;
+                Range* m_unusedNodes;
+        };
+    };
+};
\ No newline at end of file
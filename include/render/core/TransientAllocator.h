@@ -0,0 +1,71 @@
+#pragma once
+#include <render/types.h>
+
+#include <utils/ILogListener.h>
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class Buffer;
+    };
+
+    namespace core {
+        struct TransientAllocation {
+            void* data;
+            vulkan::Buffer* buffer;
+            u64 offset;
+            u64 size;
+        };
+
+        /*
+         * Hands out short lived host visible memory for data that only has to survive until the
+         * GPU is done with the frame it was allocated in (per-draw uniforms, debug geometry, etc).
+         * Each frame slot owns a region of one persistently mapped buffer, allocations bump a
+         * pointer through that region and the whole region is reset once the slot's fence has
+         * been waited on. Allocations are locked, so tasks recording on other threads (see
+         * ParallelRecorder) may allocate from the frame they're recording for.
+         */
+        class TransientAllocator : public ::utils::IWithLogging {
+            public:
+                TransientAllocator(vulkan::LogicalDevice* device, u32 frameCount, u64 bytesPerFrame);
+                ~TransientAllocator();
+
+                bool init();
+                void shutdown();
+
+                vulkan::Buffer* getBuffer() const;
+                u32 getFrameCount() const;
+                u64 getBytesPerFrame() const;
+                u64 getUsedSize(u32 frameIdx) const;
+
+                // Only call this after the GPU is done with everything allocated for the frame
+                void reset(u32 frameIdx);
+
+                /*
+                 * alignment must be a power of 2 (or 0). The returned offset is relative to the
+                 * start of getBuffer(), so it can be passed directly to descriptor writes or
+                 * vertex buffer bindings
+                 */
+                bool alloc(u32 frameIdx, u64 size, u64 alignment, TransientAllocation& out);
+
+                template <typename T>
+                T* alloc(u32 frameIdx, TransientAllocation& out, u32 count = 1) {
+                    if (!alloc(frameIdx, sizeof(T) * count, alignof(T), out)) return nullptr;
+                    return (T*)out.data;
+                }
+
+            protected:
+                vulkan::LogicalDevice* m_device;
+                vulkan::Buffer* m_buffer;
+                u8* m_mappedMemory;
+                u32 m_frameCount;
+                u64 m_bytesPerFrame;
+                u64 m_minAlignment;
+                Array<u64> m_heads;
+                std::mutex m_lock;
+        };
+    };
+};
\ No newline at end of file
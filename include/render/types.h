@@ -132,4 +132,24 @@ namespace render {
         BO_MIN,
         BO_MAX
     };
+
+    enum BUFFER_PLACEMENT {
+        // System memory that the GPU reads over the bus, best for data that changes every frame
+        BP_HOST_VISIBLE,
+
+        // Video memory, only written through staging copies
+        BP_DEVICE_LOCAL,
+
+        // Video memory that the CPU can write directly (resizable BAR or unified memory), falls
+        // back to BP_HOST_VISIBLE when the device doesn't expose it
+        BP_DEVICE_LOCAL_MAPPED
+    };
+
+    enum BLOCK_LAYOUT {
+        // Uniform block rules, arrays and matrix columns are padded to 16 bytes
+        BL_STD140,
+
+        // Storage block rules, arrays and matrix columns are only padded to the alignment of their elements
+        BL_STD430
+    };
 };
\ No newline at end of file
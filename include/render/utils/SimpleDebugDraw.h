@@ -2,6 +2,7 @@
 #include <render/types.h>
 #include <render/utils/DebugDraw.h>
 #include <render/core/DataFormat.h>
+#include <render/core/BlockLayout.h>
 
 #include <utils/Input.h>
 #include <utils/Timer.h>
@@ -31,6 +32,8 @@ namespace render {
 
                 struct uniforms {
                     mat4f viewProj;
+
+                    using UniformLayout = core::StructLayout<BL_STD140, &uniforms::viewProj>;
                 };
 
                 SimpleDebugDraw();
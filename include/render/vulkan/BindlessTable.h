@@ -0,0 +1,99 @@
+#pragma once
+#include <render/types.h>
+
+#include <vulkan/vulkan.h>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class Texture;
+        class Buffer;
+        class StorageArray;
+
+        /*
+         * One global descriptor set holding every sampled texture and storage buffer that was added
+         * to it, shaders select them by index. Requires LogicalDevice::enableBindless.
+         *
+         * Pipelines that use the table (see Pipeline::setBindlessTable) get it at set 0 and their
+         * own descriptors move to set 1. As long as those pipelines use the same push constant
+         * ranges the table stays bound across pipeline changes, so it only needs to be bound once
+         * per command buffer.
+         */
+        class BindlessTable {
+            public:
+                static constexpr u32 InvalidIndex = 0xFFFFFFFF;
+                static constexpr u32 TextureBinding = 0;
+                static constexpr u32 BufferBinding = 1;
+
+                /*
+                 * GLSL declarations for the table, insert it after the #version directive. Provides
+                 * bindlessTexture(idx) and BINDLESS_BUFFER(Type, name), the latter declares name[] where
+                 * name[idx].data is a runtime sized array of Type
+                 */
+                static const char* ShaderHeader;
+
+                BindlessTable(LogicalDevice* device, u32 maxTextures, u32 maxBuffers, u32 framesInFlight);
+                ~BindlessTable();
+
+                bool init();
+                void shutdown();
+
+                LogicalDevice* getDevice() const;
+                VkDescriptorSet get() const;
+                VkDescriptorSetLayout getLayout() const;
+                u32 getTextureCapacity() const;
+                u32 getBufferCapacity() const;
+                u32 getTextureCount() const;
+                u32 getBufferCount() const;
+
+                // Returns the texture's existing index if it was already added
+                u32 add(Texture* tex);
+                void remove(Texture* tex);
+
+                u32 add(Buffer* buffer);
+                u32 add(StorageArray* array);
+
+                // Removing an index that isn't currently in use is reported and ignored
+                void removeBuffer(u32 index);
+
+                /*
+                 * Call once per frame. Removed indices are only handed out again once no frame that
+                 * could still reference them is in flight
+                 */
+                void advanceFrame();
+
+            private:
+                struct retired_index {
+                    u32 index;
+                    u32 framesRemaining;
+                    bool isTexture;
+                };
+
+                u32 addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+                u32 allocIndex(Array<u32>& freeList, u32& next, u32 capacity);
+                void retire(u32 index, bool isTexture);
+
+                LogicalDevice* m_device;
+                u32 m_maxTextures;
+                u32 m_maxBuffers;
+                u32 m_framesInFlight;
+
+                VkDescriptorPool m_pool;
+                VkDescriptorSetLayout m_layout;
+                VkDescriptorSet m_set;
+
+                // indexed by slot so textures can be detached if the table goes away first
+                Array<Texture*> m_textures;
+
+                // indexed by slot, guards against the same buffer index being removed (and freed) twice
+                Array<bool> m_liveBuffers;
+                Array<u32> m_freeTextures;
+                Array<u32> m_freeBuffers;
+                Array<retired_index> m_retired;
+                u32 m_nextTexture;
+                u32 m_nextBuffer;
+                u32 m_textureCount;
+                u32 m_bufferCount;
+        };
+    };
+};
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <render/types.h>
+#include <render/vulkan/MemoryAllocator.h>
 
 #include <vulkan/vulkan.h>
 
@@ -15,6 +16,7 @@ namespace render {
                 LogicalDevice* getDevice() const;
                 VkBuffer get() const;
                 VkDeviceMemory getMemory() const;
+                u64 getMemoryOffset() const;
                 VkBufferUsageFlags getUsage() const;
                 VkSharingMode getSharingMode() const;
                 VkMemoryPropertyFlags getMemoryFlags() const;
@@ -37,7 +39,7 @@ namespace render {
                 LogicalDevice* m_device;
                 u64 m_size;
                 VkBuffer m_buffer;
-                VkDeviceMemory m_memory;
+                MemoryAllocation m_memory;
                 VkBufferUsageFlags m_usage;
                 VkSharingMode m_sharingMode;
                 VkMemoryPropertyFlags m_memoryFlags;
@@ -12,10 +12,32 @@ namespace render {
         class VertexBuffer;
         class Buffer;
         class Vertices;
+        class IndexBuffer;
+        class Indices;
         class DescriptorSet;
+        class UniformObject;
         class RenderPass;
         class SwapChain;
+        class BindlessTable;
 
+        // Binds are counted per recorded (or dropped) command, not per binding it covers
+        struct CommandBufferStats {
+            u32 pipelineBinds;
+            u32 pipelineBindsElided;
+            u32 descriptorSetBinds;
+            u32 descriptorSetBindsElided;
+            u32 vertexBufferBinds;
+            u32 vertexBufferBindsElided;
+            u32 indexBufferBinds;
+            u32 indexBufferBindsElided;
+            u32 dynamicStateSets;
+            u32 dynamicStateSetsElided;
+        };
+
+        /*
+         * Shadows the bound pipelines, descriptor sets, vertex/index buffers, viewport and scissor so
+         * binds that wouldn't change anything are dropped instead of being recorded
+         */
         class CommandBuffer {
             public:
                 VkCommandBuffer get() const;
@@ -25,29 +47,126 @@ namespace render {
                 static void FreeImmediate(CommandBuffer* cb);
 
                 bool begin(VkCommandBufferUsageFlagBits flags = VkCommandBufferUsageFlagBits(0));
+
+                /*
+                 * Begins a secondary buffer that continues the given subpass of the render pass, it can
+                 * then be executed from a primary that began the pass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                 */
+                bool beginSecondary(RenderPass* pass, Framebuffer* target, u32 subpass = 0, VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
                 bool end();
                 bool reset();
 
-                void beginRenderPass(RenderPass* pass, SwapChain* swap, Framebuffer* target);
-                void beginRenderPass(GraphicsPipeline* pipeline, Framebuffer* target);
+                void beginRenderPass(RenderPass* pass, SwapChain* swap, Framebuffer* target, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+                void beginRenderPass(GraphicsPipeline* pipeline, Framebuffer* target, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
                 void endRenderPass();
+                void executeCommands(CommandBuffer* secondary);
+                void executeCommands(u32 count, const VkCommandBuffer* secondaries);
                 void bindPipeline(Pipeline* pipeline, VkPipelineBindPoint bindPoint);
-                void bindDescriptorSet(DescriptorSet* set, VkPipelineBindPoint bindPoint);
+                void bindDescriptorSet(DescriptorSet* set, VkPipelineBindPoint bindPoint, u32 dynamicOffsetCount = 0, const u32* dynamicOffsets = nullptr);
+                void bindDescriptorSet(DescriptorSet* set, VkPipelineBindPoint bindPoint, UniformObject* dynamicUniform);
+
+                // Binds the table at set 0, requires a bound pipeline that was created with the table
+                void bindBindlessTable(BindlessTable* table, VkPipelineBindPoint bindPoint);
+                /*
+                 * Pushes data for one of the bound pipeline's push constant ranges (see
+                 * Pipeline::addPushConstantRange)
+                 */
+                void pushConstants(u32 rangeIndex, const void* data, u32 size);
+
+                template <typename T>
+                void pushConstants(const T& data, u32 rangeIndex = 0) { pushConstants(rangeIndex, &data, sizeof(T)); }
+
                 void bindVertexBuffer(VertexBuffer* vbo);
-                void bindVertexBuffer(Buffer* vbo);
+                void bindVertexBuffer(Buffer* vbo, u64 offset = 0);
+
+                // Binds vbo to one of the bindings added with GraphicsPipeline::addVertexBinding
+                void bindVertexBuffer(u32 binding, Buffer* vbo, u64 offset = 0);
+
+                /*
+                 * Binds buffers to consecutive bindings starting at firstBinding (see
+                 * GraphicsPipeline::addVertexBinding), offsets may be null if they're all 0
+                 */
+                void bindVertexBuffers(u32 firstBinding, u32 count, const VkBuffer* buffers, const VkDeviceSize* offsets = nullptr);
+                void bindIndexBuffer(IndexBuffer* ibo);
+                void bindIndexBuffer(Buffer* ibo, VkIndexType type, u64 offset = 0);
                 void setViewport(f32 x, f32 y, f32 width, f32 height, f32 minZ, f32 maxZ);
                 void setScissor(i32 x, i32 y, u32 width, u32 height);
                 void draw(Vertices* vertices);
                 void draw(u32 vertexCount, u32 firstVertex = 0, u32 instanceCount = 1, u32 firstInstance = 0);
 
+                // if vertices is specified the indices are treated as relative to the start of that allocation
+                void drawIndexed(Indices* indices, Vertices* vertices = nullptr, u32 instanceCount = 1, u32 firstInstance = 0);
+                void drawIndexed(u32 indexCount, u32 firstIndex = 0, i32 vertexOffset = 0, u32 instanceCount = 1, u32 firstInstance = 0);
+
+                /*
+                 * Draws drawCount commands read from args at offset (see IndirectDrawBuffer). If the
+                 * device doesn't support multiDrawIndirect this records one indirect draw per command
+                 */
+                void drawIndirect(Buffer* args, u64 offset, u32 drawCount, u32 stride = sizeof(VkDrawIndirectCommand));
+                void drawIndexedIndirect(Buffer* args, u64 offset, u32 drawCount, u32 stride = sizeof(VkDrawIndexedIndirectCommand));
+
+                /*
+                 * The number of commands is read from a u32 in countBuffer at countOffset when the command
+                 * executes, capped at maxDrawCount. Requires LogicalDevice::enableDrawIndirectCount
+                 */
+                void drawIndirectCount(Buffer* args, u64 offset, Buffer* countBuffer, u64 countOffset, u32 maxDrawCount, u32 stride = sizeof(VkDrawIndirectCommand));
+                void drawIndexedIndirectCount(Buffer* args, u64 offset, Buffer* countBuffer, u64 countOffset, u32 maxDrawCount, u32 stride = sizeof(VkDrawIndexedIndirectCommand));
+
+                /*
+                 * Forgets the shadowed state so the next binds are all recorded, call this after recording
+                 * commands into get() directly that bind anything or set dynamic state
+                 */
+                void invalidateState();
+
+                // Counts since the last begin()
+                const CommandBufferStats& getStats() const;
+
             protected:
                 friend class CommandPool;
+
+                static constexpr u32 MaxTrackedSets = 4;
+                static constexpr u32 MaxTrackedDynamicOffsets = 8;
+                static constexpr u32 MaxVertexBindings = 16;
+
+                struct bound_set {
+                    VkDescriptorSet set;
+                    u32 dynamicOffsetCount;
+                    u32 dynamicOffsets[MaxTrackedDynamicOffsets];
+                };
+
+                struct bind_point_state {
+                    Pipeline* pipeline;
+                    VkPipeline handle;
+                    VkPipelineLayout layout;
+                    bound_set sets[MaxTrackedSets];
+                };
+
+                bind_point_state* getBindPointState(VkPipelineBindPoint bindPoint);
+                void recordDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, u32 setIdx, VkDescriptorSet set, u32 dynamicOffsetCount, const u32* dynamicOffsets);
+                void recordVertexBuffer(u32 binding, VkBuffer buffer, VkDeviceSize offset);
+                void recordIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type);
+
                 LogicalDevice* m_device;
                 CommandPool* m_pool;
                 VkCommandBuffer m_buffer;
                 Pipeline* m_boundPipeline;
+                bool m_isPrimary;
                 bool m_isRecording;
 
+                // shadowed state
+                bind_point_state m_graphicsState;
+                bind_point_state m_computeState;
+                VkBuffer m_vertexBuffers[MaxVertexBindings];
+                VkDeviceSize m_vertexOffsets[MaxVertexBindings];
+                VkBuffer m_indexBuffer;
+                VkDeviceSize m_indexOffset;
+                VkIndexType m_indexType;
+                VkViewport m_viewport;
+                VkRect2D m_scissor;
+                bool m_viewportValid;
+                bool m_scissorValid;
+                CommandBufferStats m_stats;
+
                 CommandBuffer();
                 ~CommandBuffer();
         };
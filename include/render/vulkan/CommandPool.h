@@ -24,6 +24,9 @@ namespace render {
                 CommandBuffer* createBuffer(bool primary);
                 void freeBuffer(CommandBuffer* buffer);
 
+                // Resets every buffer allocated from the pool at once, none of them may be pending execution
+                bool reset();
+
             protected:
                 LogicalDevice* m_device;
                 const QueueFamily* m_family;
@@ -4,7 +4,7 @@
 
 #include <utils/ILogListener.h>
 #include <vulkan/vulkan.h>
-#include <glslang/Public/ShaderLang.h>
+#include <vector>
 
 namespace render {
     namespace core {
@@ -21,7 +21,7 @@ namespace render {
                 virtual ~ComputePipeline();
 
                 bool setComputeShader(const String& source);
-                void addUniformBlock(u32 bindIndex);
+                void addUniformBlock(u32 bindIndex, bool isDynamic = false);
                 void addStorageBuffer(u32 bindIndex);
 
                 bool init();
@@ -34,18 +34,18 @@ namespace render {
 
             protected:
                 bool processShader(
-                    glslang::TProgram& prog,
-                    EShLanguage lang,
+                    const std::vector<u32>& code,
+                    VkShaderStageFlagBits stage,
                     Array<VkPipelineShaderStageCreateInfo>& stages
                 );
 
                 ShaderCompiler* m_compiler;
                 LogicalDevice* m_device;
                 Array<u32> m_uniformBlockBindings;
+                Array<u32> m_dynamicUniformBlockBindings;
                 Array<u32> m_storageBufferBindings;
 
-                String m_computeShaderSrc;
-                glslang::TShader* m_computeShader;
+                std::vector<u32> m_computeShader;
 
                 Array<VkShaderModule> m_shaderModules;
         };
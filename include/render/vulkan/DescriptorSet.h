@@ -1,16 +1,21 @@
 #pragma once
 #include <render/types.h>
+#include <render/vulkan/DescriptorSetLayout.h>
 
 #include <vulkan/vulkan.h>
 
+#include <mutex>
+
 namespace render {
     namespace vulkan {
         class LogicalDevice;
         class Pipeline;
         class Texture;
         class UniformObject;
+        class UniformBuffer;
         class DescriptorSet;
         class Buffer;
+        class StorageArray;
 
         class DescriptorPool {
             public:
@@ -45,6 +50,7 @@ namespace render {
         class DescriptorSet {
             public:
                 DescriptorPool* getPool() const;
+                DescriptorSetLayout* getLayout() const;
                 VkDescriptorSet get() const;
 
                 void add(Texture* tex, u32 bindingIndex);
@@ -53,12 +59,30 @@ namespace render {
                 void set(Texture* tex, u32 bindingIndex);
                 void set(UniformObject* uo, u32 bindingIndex);
                 void set(Buffer* storageBuffer, u32 bindingIndex);
+
+                /*
+                 * Binds a whole uniform buffer to a dynamic uniform block, the object that is visible to
+                 * shaders is selected with UniformObject::getDynamicOffset when the set is bound
+                 */
+                void add(UniformBuffer* dynamicUniforms, u32 bindingIndex);
+                void set(UniformBuffer* dynamicUniforms, u32 bindingIndex);
+
+                // Binds only the range of the storage buffer that belongs to the array
+                void add(StorageArray* storageArray, u32 bindingIndex);
+                void set(StorageArray* storageArray, u32 bindingIndex);
+
+                /*
+                 * Writes every descriptor with a single vkUpdateDescriptorSetWithTemplate call when all of
+                 * the layout's bindings have been added, only falls back to individual writes otherwise
+                 */
                 void update();
 
+                // Does nothing for sets that came from a TransientDescriptorAllocator
                 void free();
 
             private:
                 friend class DescriptorPool;
+                friend class TransientDescriptorAllocator;
 
                 DescriptorSet();
 
@@ -66,18 +90,66 @@ namespace render {
                     UniformObject* uniform;
                     Texture* tex;
                     Buffer* storageBuffer;
+                    UniformBuffer* dynamicUniforms;
+                    StorageArray* storageArray;
                     u32 bindingIdx;
                 };
 
                 Array<descriptor> m_descriptors;
+                Array<DescriptorSetLayout::slot> m_data;
+
+                // parallel to m_data, set for the slots that the last update() wrote
+                Array<bool> m_isSlotFilled;
+                Array<VkWriteDescriptorSet> m_writes;
 
+                LogicalDevice* m_device;
                 DescriptorPool* m_pool;
+                DescriptorSetLayout* m_layout;
                 DescriptorSet* m_next;
                 DescriptorSet* m_last;
 
                 VkDescriptorSet m_set;
         };
 
+        /*
+         * Hands out descriptor sets that only live until the GPU is done with the frame they were
+         * allocated in. Each frame slot has its own pools which are reset in one call once the slot's
+         * fence has been waited on, sets are never freed individually. The pipeline a set was
+         * allocated for must outlive the frame. Allocation is locked so sets can be allocated from
+         * multiple recording threads, each set must still only be updated by one thread at a time
+         */
+        class TransientDescriptorAllocator {
+            public:
+                TransientDescriptorAllocator(LogicalDevice* device, u32 frameCount, u32 maxSetsPerPool);
+                ~TransientDescriptorAllocator();
+
+                bool init();
+                void shutdown();
+
+                u32 getFrameCount() const;
+                u32 getUsedSetCount(u32 frameIdx) const;
+
+                // Only call this after the GPU is done with every set allocated for the frame
+                void reset(u32 frameIdx);
+                DescriptorSet* allocate(u32 frameIdx, Pipeline* pipeline);
+
+            private:
+                struct frame_pools {
+                    Array<VkDescriptorPool> pools;
+                    Array<DescriptorSet*> sets;
+                    u32 currentPool;
+                    u32 usedSets;
+                };
+
+                VkDescriptorPool createPool();
+
+                LogicalDevice* m_device;
+                u32 m_frameCount;
+                u32 m_maxSetsPerPool;
+                Array<frame_pools> m_frames;
+                std::mutex m_lock;
+        };
+
         class DescriptorFactory {
             public:
                 DescriptorFactory(LogicalDevice* device, u32 maxSetsPerPool);
@@ -89,6 +161,9 @@ namespace render {
                 LogicalDevice* m_device;
                 u32 m_maxSetsPerPool;
                 Array<DescriptorPool*> m_pools;
+
+                // pool that served the last allocation, it's checked first
+                DescriptorPool* m_current;
         };
     };
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include <render/types.h>
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <mutex>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class DescriptorSetLayoutCache;
+
+        class DescriptorSetLayout {
+            public:
+                /*
+                 * Descriptor sets are written from an array with one of these per binding, in the order
+                 * of getBinding. The update template reads the member that matches the binding's type
+                 */
+                union slot {
+                    VkDescriptorBufferInfo buffer;
+                    VkDescriptorImageInfo image;
+                };
+
+                VkDescriptorSetLayout get() const;
+                VkDescriptorUpdateTemplate getUpdateTemplate() const;
+                u64 getHash() const;
+                u32 getBindingCount() const;
+                const VkDescriptorSetLayoutBinding& getBinding(u32 slotIdx) const;
+
+                // Returns -1 if the layout has no binding with that index
+                i32 getSlot(u32 bindingIndex) const;
+
+            private:
+                friend class DescriptorSetLayoutCache;
+
+                DescriptorSetLayout(LogicalDevice* device, u64 hash);
+                ~DescriptorSetLayout();
+
+                bool init();
+                void shutdown();
+                bool isEqualTo(const Array<VkDescriptorSetLayoutBinding>& bindings) const;
+
+                LogicalDevice* m_device;
+                VkDescriptorSetLayout m_layout;
+                VkDescriptorUpdateTemplate m_template;
+                Array<VkDescriptorSetLayoutBinding> m_bindings;
+                u64 m_hash;
+                u32 m_refCount;
+        };
+
+        class DescriptorSetLayoutCache {
+            public:
+                DescriptorSetLayoutCache(LogicalDevice* device);
+                ~DescriptorSetLayoutCache();
+
+                /*
+                 * Returns a layout for the bindings with a reference added for the caller, pipelines with
+                 * the same bindings (in any order) share one layout. Every get must be paired with a release.
+                 * Bindings must have a descriptorCount of 1, returns null otherwise
+                 */
+                DescriptorSetLayout* get(const Array<VkDescriptorSetLayoutBinding>& bindings);
+                void acquire(DescriptorSetLayout* layout);
+                void release(DescriptorSetLayout* layout);
+                u32 getLayoutCount() const;
+
+                void shutdown();
+
+            private:
+                static u64 HashBindings(const Array<VkDescriptorSetLayoutBinding>& sortedBindings);
+
+                LogicalDevice* m_device;
+                std::mutex m_lock;
+                std::unordered_map<u64, Array<DescriptorSetLayout*>> m_layouts;
+                u32 m_layoutCount;
+        };
+    };
+};
\ No newline at end of file
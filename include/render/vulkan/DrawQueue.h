@@ -0,0 +1,95 @@
+#pragma once
+#include <render/types.h>
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+
+namespace render {
+    namespace vulkan {
+        class CommandBuffer;
+        class Pipeline;
+        class DescriptorSet;
+        class UniformObject;
+        class Vertices;
+        class Indices;
+
+        struct DrawPacket {
+            Pipeline* pipeline;
+
+            // optional, dynamicUniform selects the object when the set has a dynamic uniform block
+            DescriptorSet* descriptorSet;
+            UniformObject* dynamicUniform;
+
+            Vertices* vertices;
+
+            // when set the draw is indexed, relative to the start of vertices
+            Indices* indices;
+            u32 instanceCount;
+            u32 firstInstance;
+
+            // distance from the camera, used to order draws within a bucket
+            f32 depth;
+            bool isTransparent;
+        };
+
+        /*
+         * Collects draws and records them sorted by a 64 bit key instead of in call order.
+         *
+         * Opaque draws come first, grouped by pipeline and then descriptor set so binds are only
+         * recorded when they change (see CommandBuffer's redundant state elision), and front to back
+         * within each group to get the most out of early depth testing. Transparent draws follow,
+         * strictly back to front.
+         */
+        class DrawQueue {
+            public:
+                DrawQueue();
+                ~DrawQueue();
+
+                // Returns the index of the draw
+                u32 add(const DrawPacket& draw);
+
+                // The data is copied, it's pushed to the range of the draw's pipeline before drawing
+                void setPushConstants(u32 drawIdx, u32 rangeIndex, const void* data, u32 size);
+
+                template <typename T>
+                void setPushConstants(u32 drawIdx, const T& data, u32 rangeIndex = 0) { setPushConstants(drawIdx, rangeIndex, &data, sizeof(T)); }
+
+                u32 getCount() const;
+
+                /*
+                 * Sorts and records every draw into cb, which must be inside a render pass. Viewport
+                 * and scissor are left to the caller. The queue is cleared afterwards
+                 */
+                void submit(CommandBuffer* cb);
+                void clear();
+
+            private:
+                struct packet {
+                    DrawPacket draw;
+                    u32 pushConstantOffset;
+                    u32 pushConstantSize;
+                    u32 pushConstantRange;
+                };
+
+                struct sort_entry {
+                    u64 key;
+                    u32 index;
+                };
+
+                static u64 EncodeKey(u32 pipelineId, u32 setId, f32 depth, bool isTransparent);
+                u32 getPipelineId(Pipeline* pipeline);
+                u32 getSetId(DescriptorSet* set);
+                void sort();
+
+                Array<packet> m_packets;
+                std::vector<u8> m_pushConstantData;
+                std::vector<sort_entry> m_entries;
+                std::vector<sort_entry> m_scratch;
+
+                // dense ids for the key, reassigned every time the queue is cleared
+                std::unordered_map<Pipeline*, u32> m_pipelineIds;
+                std::unordered_map<DescriptorSet*, u32> m_setIds;
+        };
+    };
+};
\ No newline at end of file
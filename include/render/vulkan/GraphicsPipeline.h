@@ -6,7 +6,7 @@
 #include <utils/ILogListener.h>
 
 #include <vulkan/vulkan.h>
-#include <glslang/Public/ShaderLang.h>
+#include <vector>
 
 namespace render {
     namespace vulkan {
@@ -17,18 +17,36 @@ namespace render {
 
         class GraphicsPipeline : public Pipeline, public ::utils::IWithLogging {
             public:
+                static constexpr u32 InvalidBinding = 0xFFFFFFFF;
+
                 GraphicsPipeline(ShaderCompiler* compiler, LogicalDevice* device, SwapChain* swapChain, RenderPass* render);
                 virtual ~GraphicsPipeline();
 
                 void reset();
 
                 void addSampler(u32 bindIndex, VkShaderStageFlagBits stages);
-                void addUniformBlock(u32 bindIndex, const core::DataFormat* fmt, VkShaderStageFlagBits stages);
+                /*
+                 * Dynamic uniform blocks are bound with one descriptor that covers a single object of the
+                 * buffer, the object to use is selected by passing a dynamic offset when the set is bound
+                 */
+                void addUniformBlock(u32 bindIndex, const core::DataFormat* fmt, VkShaderStageFlagBits stages, bool isDynamic = false);
+
+                // Sets the format of binding 0, which is read per vertex
                 void setVertexFormat(const core::DataFormat* fmt);
+
+                /*
+                 * Adds a vertex buffer binding and returns its index (or InvalidBinding if the pipeline was
+                 * already initialized). Binding 0 is always the one set by setVertexFormat, so added bindings
+                 * start at 1 even if it isn't used. Use VK_VERTEX_INPUT_RATE_INSTANCE for per-instance data
+                 * (see FrameContext::allocInstances). Input locations continue from the previous binding's,
+                 * every array element and matrix column takes a location of its own
+                 */
+                u32 addVertexBinding(const core::DataFormat* fmt, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX);
                 bool setVertexShader(const String& source);
                 bool setFragmentShader(const String& source);
                 bool setGeometryShader(const String& source);
                 void addDynamicState(VkDynamicState state);
+                bool isStateDynamic(VkDynamicState state) const;
 
                 void setViewport(f32 x, f32 y, f32 w, f32 h, f32 minZ, f32 maxZ);
                 void setScissor(f32 x, f32 y, f32 w, f32 h);
@@ -61,8 +79,8 @@ namespace render {
 
             protected:
                 bool processShader(
-                    glslang::TProgram& prog,
-                    EShLanguage lang,
+                    const std::vector<u32>& code,
+                    VkShaderStageFlagBits stage,
                     Array<VkPipelineShaderStageCreateInfo>& stages
                 );
 
@@ -70,6 +88,7 @@ namespace render {
                     u32 binding;
                     VkShaderStageFlagBits stages;
                     const core::DataFormat* format;
+                    bool isDynamic;
                 };
 
                 struct sampler_info {
@@ -77,23 +96,32 @@ namespace render {
                     VkShaderStageFlagBits stages;
                 };
 
+                struct vertex_binding {
+                    const core::DataFormat* format;
+                    VkVertexInputRate inputRate;
+                };
+
                 ShaderCompiler* m_compiler;
                 SwapChain* m_swapChain;
                 RenderPass* m_renderPass;
-                const core::DataFormat* m_vertexFormat;
+                Array<vertex_binding> m_vertexBindings;
                 Array<uniform_block> m_uniformBlocks;
                 Array<sampler_info> m_samplers;
                 bool m_isInitialized;
                 bool m_scissorIsSet;
 
+                std::vector<u32> m_vertexShader;
+                std::vector<u32> m_fragShader;
+                std::vector<u32> m_geomShader;
+
+                // kept so that stages which weren't cached can be linked together once (see ShaderCompiler::validateLinkage)
                 String m_vertexShaderSrc;
-                glslang::TShader* m_vertexShader;
                 String m_fragShaderSrc;
-                glslang::TShader* m_fragShader;
                 String m_geomShaderSrc;
-                glslang::TShader* m_geomShader;
+                bool m_needsLinkCheck;
 
                 Array<VkShaderModule> m_shaderModules;
+                Array<VkPipelineShaderStageCreateInfo> m_shaderStages;
                 Array<VkDynamicState> m_dynamicState;
 
                 // state
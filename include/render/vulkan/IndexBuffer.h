@@ -0,0 +1,121 @@
+#pragma once
+#include <render/types.h>
+#include <render/vulkan/Buffer.h>
+#include <render/core/RangeAllocator.h>
+#include <render/core/CapacityHeap.h>
+
+#include <utils/Array.h>
+#include <vulkan/vulkan.h>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class Indices;
+        class IndexBufferFactory;
+
+        class IndexBuffer {
+            public:
+                // type must be VK_INDEX_TYPE_UINT16 or VK_INDEX_TYPE_UINT32
+                IndexBuffer(LogicalDevice* device, VkIndexType type, u32 indexCapacity);
+                ~IndexBuffer();
+
+                bool init();
+                void shutdown();
+
+                LogicalDevice* getDevice() const;
+                VkIndexType getType() const;
+                u32 getIndexSize() const;
+                VkBuffer getBuffer() const;
+                VkDeviceMemory getMemory() const;
+                u32 getCapacity() const;
+                u32 getCurrentMaximumBlockSize() const;
+                u32 getUsedCount() const;
+                u32 getAllocationCount() const;
+                f32 getFragmentation() const;
+
+                Indices* allocate(u32 count);
+                void free(Indices* indices);
+
+                static u32 IndexSize(VkIndexType type);
+            
+            private:
+                friend class Indices;
+                friend class IndexBufferFactory;
+
+                void freeAllIndices();
+
+                LogicalDevice* m_device;
+                Buffer m_buffer;
+                VkIndexType m_type;
+                u32 m_indexSize;
+                core::RangeAllocator m_allocator;
+                u32 m_capacity;
+                u32 m_memoryMapRefCount;
+
+                // factory that owns this buffer, notified when the free capacity changes
+                IndexBufferFactory* m_factory;
+                u32 m_heapIndex;
+        };
+
+        class Indices {
+            public:
+                // index of the first index in the buffer, use as firstIndex when drawing
+                u32 getOffset() const;
+                u32 getByteOffset() const;
+                u32 getSize() const;
+                u32 getCount() const;
+                VkIndexType getType() const;
+                IndexBuffer* getBuffer() const;
+                void free();
+
+                bool beginUpdate();
+                bool write(const void* data, u32 offset, u32 count);
+                
+                // will dereference null pointer if beginUpdate is not called or
+                // if a beginUpdate failure is ignored
+                template <typename IndexTp>
+                IndexTp& at(u32 idx) { return ((IndexTp*)m_buffer->m_buffer.getPointer())[m_range->offset + idx]; }
+
+                bool commitUpdate();
+
+            private:
+                friend class IndexBuffer;
+
+                Indices(IndexBuffer* buf, core::RangeAllocator::Range* range, u32 count);
+                ~Indices();
+
+                IndexBuffer* m_buffer;
+                core::RangeAllocator::Range* m_range;
+                u32 m_count;
+        };
+
+        class IndexBufferFactory {
+            public:
+                IndexBufferFactory(LogicalDevice* device, u32 minBufferCapacity);
+                ~IndexBufferFactory();
+
+                void freeAll();
+
+                Indices* allocate(VkIndexType type, u32 count);
+            
+            private:
+                friend class IndexBuffer;
+
+                typedef core::CapacityHeap<
+                    IndexBuffer,
+                    &IndexBuffer::getCurrentMaximumBlockSize,
+                    &IndexBuffer::m_heapIndex
+                > buffer_heap;
+
+                buffer_heap* getBuffers(VkIndexType type);
+                void onCapacityChanged(IndexBuffer* buf);
+
+                LogicalDevice* m_device;
+                u32 m_minBufferCapacity;
+
+                // the buffer with the largest free range is always on top
+                buffer_heap m_u16Buffers;
+                buffer_heap m_u32Buffers;
+        };
+    };
+};
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+#include <render/types.h>
+
+#include <utils/ILogListener.h>
+#include <vulkan/vulkan.h>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class Buffer;
+        class CommandBuffer;
+        class VertexBuffer;
+        class IndexBuffer;
+        class Vertices;
+        class Indices;
+
+        /*
+         * Builds indirect draw commands for ranges that live in the same vertex (and index) buffer
+         * so all of them can be drawn with a single call. Each frame slot owns a region of one
+         * persistently mapped buffer which is rebuilt after begin().
+         *
+         *   args->begin(frame->getFrameIndex());
+         *   for (each mesh) args->add(mesh->indices, mesh->vertices);
+         *   cb->bindPipeline(...);
+         *   args->draw(cb);
+         *
+         * The buffer is also usable as a storage buffer, so the commands can be culled or generated
+         * by a compute shader and drawn with CommandBuffer::drawIndexedIndirectCount
+         */
+        class IndirectDrawBuffer : public ::utils::IWithLogging {
+            public:
+                IndirectDrawBuffer(LogicalDevice* device, u32 frameCount, u32 maxDrawsPerFrame);
+                ~IndirectDrawBuffer();
+
+                bool init();
+                void shutdown();
+
+                Buffer* getBuffer() const;
+                u32 getMaxDrawsPerFrame() const;
+                u32 getDrawCount() const;
+                u32 getIndexedDrawCount() const;
+
+                // Offsets of the current frame's VkDrawIndirectCommand / VkDrawIndexedIndirectCommand arrays
+                u64 getDrawOffset() const;
+                u64 getIndexedDrawOffset() const;
+
+                // Only call this after the GPU is done with the commands built for the frame slot
+                void begin(u32 frameIdx);
+
+                /*
+                 * Every range added between begin() and draw() must come from the same vertex buffer,
+                 * and every indexed range from the same index buffer. firstInstance must be 0 unless
+                 * the device supports drawIndirectFirstInstance
+                 */
+                bool add(Vertices* vertices, u32 instanceCount = 1, u32 firstInstance = 0);
+                bool add(Indices* indices, Vertices* vertices, u32 instanceCount = 1, u32 firstInstance = 0);
+
+                // Binds the shared vertex and index buffers and records one call per command type
+                void draw(CommandBuffer* cb);
+
+            protected:
+                bool useBuffers(VertexBuffer* vbo, IndexBuffer* ibo, u32 firstInstance);
+
+                LogicalDevice* m_device;
+                Buffer* m_buffer;
+                u8* m_mappedMemory;
+                u32 m_frameCount;
+                u32 m_maxDraws;
+                u64 m_bytesPerFrame;
+
+                // offset of the non-indexed commands within each frame's region
+                u64 m_drawRegionOffset;
+
+                u32 m_frameIdx;
+                u32 m_drawCount;
+                u32 m_indexedDrawCount;
+                VertexBuffer* m_vertexBuffer;
+                IndexBuffer* m_indexBuffer;
+        };
+    };
+};
\ No newline at end of file
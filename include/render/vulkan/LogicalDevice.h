@@ -7,6 +7,9 @@
 namespace render {
     namespace vulkan {
         class Instance;
+        class MemoryAllocator;
+        class DescriptorSetLayoutCache;
+        class PipelineCache;
         class PhysicalDevice;
         class Queue;
         class QueueFamily;
@@ -22,6 +25,20 @@ namespace render {
                 bool isExtensionEnabled(const char* name) const;
                 bool enableLayer(const char* name);
                 bool isLayerEnabled(const char* name) const;
+
+                /*
+                 * Enables the descriptor indexing features needed by BindlessTable, must be called before
+                 * init(). Returns false if the physical device doesn't support them
+                 */
+                bool enableBindless();
+                bool isBindlessEnabled() const;
+
+                /*
+                 * Enables CommandBuffer::draw*IndirectCount, must be called before init(). Returns false
+                 * if the physical device doesn't support it
+                 */
+                bool enableDrawIndirectCount();
+                bool isDrawIndirectCountEnabled() const;
                 bool waitForIdle() const;
 
                 bool init(bool needsGraphics, bool needsCompute, bool needsTransfer, Surface* surface);
@@ -30,6 +47,10 @@ namespace render {
                 VkDevice get() const;
                 PhysicalDevice* getPhysicalDevice() const;
                 Instance* getInstance() const;
+                MemoryAllocator* getMemoryAllocator() const;
+                DescriptorSetLayoutCache* getDescriptorSetLayoutCache() const;
+                PipelineCache* getPipelineCache() const;
+                void setPipelineCache(PipelineCache* cache);
                 const Array<Queue*>& getQueues() const;
                 const Queue* getPresentationQueue() const;
                 const Queue* getComputeQueue() const;
@@ -49,6 +70,8 @@ namespace render {
                 ) const;
 
                 bool m_isInitialized;
+                bool m_bindlessEnabled;
+                bool m_drawIndirectCountEnabled;
                 VkDevice m_device;
                 PhysicalDevice* m_physicalDevice;
                 Array<const char*> m_enabledExtensions;
@@ -57,6 +80,9 @@ namespace render {
                 Queue* m_presentQueue;
                 Queue* m_computeQueue;
                 Queue* m_gfxQueue;
+                MemoryAllocator* m_memoryAllocator;
+                DescriptorSetLayoutCache* m_layoutCache;
+                PipelineCache* m_pipelineCache;
         };
     };
 };
\ No newline at end of file
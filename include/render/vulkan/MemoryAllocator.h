@@ -0,0 +1,130 @@
+#pragma once
+#include <render/types.h>
+
+#include <vulkan/vulkan.h>
+#include <mutex>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class MemoryAllocator;
+        class MemoryBlock;
+
+        struct MemoryAllocation {
+            VkDeviceMemory memory;
+            u64 offset;
+            u64 size;
+            u32 memoryTypeIndex;
+            MemoryBlock* block;
+            void* node;
+            bool isLinear;
+        };
+
+        struct MemoryHeapStats {
+            u32 blockCount;
+            u32 allocationCount;
+            u32 freeRangeCount;
+            u64 heapSize;
+            u64 bytesReserved;
+            u64 bytesUsed;
+            u64 bytesFree;
+            u64 largestFreeRange;
+
+            // 0 when all free space is contiguous, approaching 1 as it is split into many small ranges
+            f32 fragmentation;
+        };
+
+        class MemoryBlock {
+            public:
+                MemoryBlock(MemoryAllocator* allocator, u32 memoryTypeIndex, u64 size, bool isDedicated);
+                ~MemoryBlock();
+
+                bool init();
+                void shutdown();
+
+                VkDeviceMemory get() const;
+                u32 getMemoryTypeIndex() const;
+                u64 getSize() const;
+                u64 getUsedSize() const;
+                u32 getAllocationCount() const;
+                bool isDedicated() const;
+                bool isEmpty() const;
+
+                bool allocate(u64 size, u64 alignment, MemoryAllocation& out);
+                void free(const MemoryAllocation& allocation);
+
+                void* map();
+
+                void getStats(MemoryHeapStats& stats) const;
+
+            protected:
+                static constexpr u32 SL_BITS = 4;
+                static constexpr u32 SL_COUNT = 1 << SL_BITS;
+                static constexpr u32 FL_COUNT = 64;
+
+                struct node {
+                    u64 offset;
+                    u64 size;
+                    bool isFree;
+                    node* prevPhys;
+                    node* nextPhys;
+                    node* prevFree;
+                    node* nextFree;
+                };
+
+                static void mapSize(u64 size, u32& fl, u32& sl);
+                node* findFree(u64 size);
+                void insertFree(node* n);
+                void removeFree(node* n);
+                node* getNode();
+                void releaseNode(node* n);
+
+                MemoryAllocator* m_allocator;
+                VkDeviceMemory m_memory;
+                u32 m_memoryTypeIndex;
+                u64 m_size;
+                u64 m_usedSize;
+                u32 m_allocationCount;
+                bool m_isDedicated;
+                void* m_mappedMemory;
+
+                u64 m_flBitmap;
+                u32 m_slBitmap[FL_COUNT];
+                node* m_freeHeads[FL_COUNT][SL_COUNT];
+                node* m_physHead;
+                node* m_unusedNodes;
+        };
+
+        class MemoryAllocator {
+            public:
+                MemoryAllocator(LogicalDevice* device);
+                ~MemoryAllocator();
+
+                LogicalDevice* getDevice() const;
+                u64 getPreferredBlockSize(u32 memoryTypeIndex) const;
+
+                /*
+                 * Allocations for linear resources (buffers) and optimal-tiling images are kept in
+                 * separate blocks so that bufferImageGranularity never has to be accounted for
+                 */
+                bool allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags flags, bool isLinear, MemoryAllocation& out);
+                void free(MemoryAllocation& allocation);
+
+                /*
+                 * Host visible blocks are mapped once on first use and stay mapped until they are released,
+                 * the returned pointer already accounts for the allocation's offset
+                 */
+                void* map(const MemoryAllocation& allocation);
+
+                bool getHeapStats(u32 heapIndex, MemoryHeapStats& out);
+                u32 getHeapCount() const;
+
+                void shutdown();
+
+            protected:
+                LogicalDevice* m_device;
+                std::mutex m_lock;
+                Array<MemoryBlock*> m_blocks[VK_MAX_MEMORY_TYPES][2];
+        };
+    };
+};
\ No newline at end of file
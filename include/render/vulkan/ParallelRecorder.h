@@ -0,0 +1,105 @@
+#pragma once
+#include <render/types.h>
+
+#include <utils/ILogListener.h>
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class CommandPool;
+        class CommandBuffer;
+        class RenderPass;
+        class Framebuffer;
+
+        /*
+         * Records secondary command buffers for one subpass on worker threads. Every worker (and the
+         * thread calling end(), which helps out while it waits) has its own command pool per frame
+         * slot, so recording never takes a lock and the pools are reset in one call when the slot is
+         * reused.
+         *
+         *   cb->beginRenderPass(pipeline, frame->getFramebuffer(), VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+         *   recorder->begin(frame->getFrameIndex(), renderPass, frame->getFramebuffer());
+         *   for (each chunk of draws) recorder->submit([=](CommandBuffer* scb) { ... });
+         *   recorder->end(cb);
+         *   cb->endRenderPass();
+         *
+         * Tasks may allocate from the frame with FrameContext::allocTransient, allocInstances and
+         * allocateDescriptor, those allocators are locked. Anything else shared between tasks
+         * (uniform objects, vertex buffer updates, TransferBatch) isn't, so it should be
+         * prepared on the calling thread before the tasks are submitted.
+         */
+        class ParallelRecorder : public ::utils::IWithLogging {
+            public:
+                using RecordFunc = std::function<void(CommandBuffer*)>;
+
+                // workerCount of 0 picks one less than the number of hardware threads
+                ParallelRecorder(LogicalDevice* device, u32 frameCount, u32 workerCount = 0);
+                ~ParallelRecorder();
+
+                bool init();
+                void shutdown();
+                u32 getWorkerCount() const;
+
+                /*
+                 * Starts a batch for the frame slot. Only call this once the slot's fence has been waited
+                 * on (after FrameContext::begin), since it resets the slot's command pools
+                 */
+                bool begin(u32 frameIdx, RenderPass* pass, Framebuffer* target, u32 subpass = 0);
+
+                // Each task records into its own secondary buffer which is begun and ended around it
+                void submit(RecordFunc task);
+
+                /*
+                 * Waits for every task submitted since begin() and executes their buffers from primary
+                 * in the order the tasks were submitted
+                 */
+                bool end(CommandBuffer* primary);
+
+            private:
+                struct task {
+                    RecordFunc func;
+                    CommandBuffer* buffer;
+                };
+
+                struct thread_pool {
+                    CommandPool* pool;
+                    Array<CommandBuffer*> buffers;
+                    u32 usedBuffers;
+                };
+
+                void workerMain(u32 threadIdx);
+                bool runNextTask(u32 threadIdx, std::unique_lock<std::mutex>& lock);
+                CommandBuffer* acquireBuffer(u32 threadIdx);
+
+                LogicalDevice* m_device;
+                u32 m_frameCount;
+                u32 m_workerCount;
+
+                // m_pools[frameIdx * (m_workerCount + 1) + threadIdx], the last thread index is the caller of end()
+                Array<thread_pool> m_pools;
+
+                RenderPass* m_renderPass;
+                Framebuffer* m_framebuffer;
+                u32 m_subpass;
+                u32 m_frameIdx;
+                bool m_isRecording;
+
+                bool m_isStopping;
+                u32 m_nextTask;
+                u32 m_pendingTasks;
+                std::mutex m_lock;
+                std::condition_variable m_workAvailable;
+                std::condition_variable m_taskFinished;
+                std::vector<task> m_tasks;
+                std::vector<std::thread> m_workers;
+                Array<VkCommandBuffer> m_executeList;
+        };
+    };
+};
\ No newline at end of file
@@ -31,6 +31,14 @@ namespace render {
                 const VkPhysicalDeviceProperties& getProperties() const;
                 const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const;
                 const VkPhysicalDeviceFeatures& getFeatures() const;
+                const VkPhysicalDeviceDescriptorIndexingFeatures& getDescriptorIndexingFeatures() const;
+                const VkPhysicalDeviceDescriptorIndexingProperties& getDescriptorIndexingProperties() const;
+
+                // True if the device supports every descriptor indexing feature a BindlessTable relies on
+                bool isBindlessSupported() const;
+
+                // vkCmdDraw*IndirectCount, core in 1.2 but still optional
+                bool isDrawIndirectCountSupported() const;
                 Instance* getInstance() const;
 
             protected:
@@ -42,6 +50,9 @@ namespace render {
                 VkPhysicalDeviceProperties m_props;
                 VkPhysicalDeviceFeatures m_features;
                 VkPhysicalDeviceMemoryProperties m_memoryProps;
+                VkPhysicalDeviceDescriptorIndexingFeatures m_indexingFeatures;
+                VkPhysicalDeviceDescriptorIndexingProperties m_indexingProps;
+                bool m_drawIndirectCountSupported;
                 Array<VkExtensionProperties> m_availableExtensions;
                 Array<VkLayerProperties> m_availableLayers;
         };
@@ -4,23 +4,58 @@
 #include <vulkan/vulkan.h>
 
 namespace render {
+    namespace core {
+        class DataFormat;
+    };
+
     namespace vulkan {
         class LogicalDevice;
+        class DescriptorSetLayout;
+        class BindlessTable;
         
         class Pipeline {
             public:
+                static constexpr u32 InvalidPushConstantRange = 0xFFFFFFFF;
+
                 Pipeline(LogicalDevice* device);
                 virtual ~Pipeline();
 
                 VkPipeline get() const;
                 VkPipelineLayout getLayout() const;
                 VkDescriptorSetLayout getDescriptorSetLayout() const;
+                DescriptorSetLayout* getSetLayout() const;
+
+                /*
+                 * Must be called before init(). The table is placed at set 0 and the pipeline's own
+                 * descriptors move to set 1 (see getDescriptorSetIndex)
+                 */
+                void setBindlessTable(BindlessTable* table);
+                BindlessTable* getBindlessTable() const;
+                u32 getDescriptorSetIndex() const;
+
+                /*
+                 * Ranges are laid out back to back in the order they're added, the data pushed for a range
+                 * must match the shader's push_constant block (std430) byte for byte. Must be called before
+                 * init(), returns the index of the range or InvalidPushConstantRange if it was called after
+                 */
+                u32 addPushConstantRange(VkShaderStageFlags stages, const core::DataFormat* fmt);
+                u32 addPushConstantRange(VkShaderStageFlags stages, u32 size);
+                const Array<VkPushConstantRange>& getPushConstantRanges() const;
+                u32 getPushConstantSize() const;
             
             protected:
+                bool validatePushConstants() const;
+
+                // Fills out with the set layouts for the pipeline layout and returns how many there are
+                u32 getSetLayouts(VkDescriptorSetLayout* out) const;
+
                 LogicalDevice* m_device;
                 VkPipelineLayout m_layout;
-                VkDescriptorSetLayout m_descriptorSetLayout;
+                DescriptorSetLayout* m_descriptorSetLayout;
+                BindlessTable* m_bindless;
                 VkPipeline m_pipeline;
+                Array<VkPushConstantRange> m_pushConstantRanges;
+                u32 m_pushConstantSize;
         };
     };
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include <render/types.h>
+
+#include <vulkan/vulkan.h>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+
+        class PipelineCache {
+            public:
+                PipelineCache(LogicalDevice* device);
+                ~PipelineCache();
+
+                LogicalDevice* getDevice() const;
+                VkPipelineCache get() const;
+                const String& getPath() const;
+
+                /*
+                 * Seeds the cache from the file at path if it exists and was produced by the same
+                 * driver/device, otherwise starts empty. save() writes back to the same path
+                 */
+                bool init(const String& path);
+                bool save();
+                void shutdown();
+
+            protected:
+                bool loadData(Array<u8>& data);
+                bool isCompatible(const u8* data, u64 size) const;
+
+                LogicalDevice* m_device;
+                VkPipelineCache m_cache;
+                String m_path;
+        };
+    };
+};
\ No newline at end of file
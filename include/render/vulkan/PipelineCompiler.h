@@ -0,0 +1,100 @@
+#pragma once
+#include <render/types.h>
+
+#include <utils/ILogListener.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace render {
+    namespace vulkan {
+        class Pipeline;
+        class GraphicsPipeline;
+        class ComputePipeline;
+        class PipelineCompiler;
+
+        class PipelineJob {
+            public:
+                bool isReady() const;
+                bool isFailed() const;
+                bool isDone() const;
+
+                /*
+                 * Returns the pipeline once it has finished compiling, otherwise the fallback. The fallback
+                 * must share a compatible layout with the real pipeline if descriptors get bound with it
+                 */
+                Pipeline* getPipeline(Pipeline* fallback = nullptr) const;
+                void wait();
+
+            private:
+                friend class PipelineCompiler;
+                PipelineJob(PipelineCompiler* compiler);
+                ~PipelineJob();
+
+                bool execute();
+
+                enum job_state : u8 {
+                    js_pending,
+                    js_compiling,
+                    js_ready,
+                    js_failed
+                };
+
+                PipelineCompiler* m_compiler;
+                GraphicsPipeline* m_graphicsPipeline;
+                ComputePipeline* m_computePipeline;
+                String m_vertexShaderSrc;
+                String m_fragShaderSrc;
+                String m_geomShaderSrc;
+                String m_computeShaderSrc;
+                std::atomic<u8> m_state;
+        };
+
+        class PipelineCompiler : public ::utils::IWithLogging {
+            public:
+                // workerCount of 0 picks one less than the number of hardware threads
+                PipelineCompiler(u32 workerCount = 0);
+                ~PipelineCompiler();
+
+                bool init();
+                void shutdown();
+                u32 getWorkerCount() const;
+
+                /*
+                 * Queues the pipeline to have its shaders compiled and be initialized on a worker thread.
+                 * The pipeline must not be used or modified by the caller until the job is done
+                 */
+                PipelineJob* compile(
+                    GraphicsPipeline* pipeline,
+                    const String& vertexShader,
+                    const String& fragmentShader,
+                    const String& geometryShader = String()
+                );
+                PipelineJob* compile(ComputePipeline* pipeline, const String& computeShader);
+
+                // Waits for the job if it's in progress
+                void free(PipelineJob* job);
+                void waitForIdle();
+
+            private:
+                friend class PipelineJob;
+
+                PipelineJob* enqueue(PipelineJob* job);
+                void workerMain();
+
+                u32 m_workerCount;
+                bool m_isStopping;
+                u32 m_activeJobs;
+                std::mutex m_lock;
+                std::condition_variable m_workAvailable;
+                std::condition_variable m_jobFinished;
+                std::deque<PipelineJob*> m_queue;
+                std::vector<std::thread> m_workers;
+                Array<PipelineJob*> m_jobs;
+        };
+    };
+};
\ No newline at end of file
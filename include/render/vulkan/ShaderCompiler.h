@@ -5,6 +5,10 @@
 #include <utils/ILogListener.h>
 #include <glslang/Public/ShaderLang.h>
 
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
 namespace render {
     namespace vulkan {
         class LogicalDevice;
@@ -16,11 +20,38 @@ namespace render {
                 bool init();
                 void shutdown();
 
+                /*
+                 * Compiled SPIR-V is persisted to this directory, keyed by a hash of the source, stage,
+                 * target environment and resource limits. An empty path disables the on-disk cache
+                 */
+                void setCacheDirectory(const String& path);
+                const String& getCacheDirectory() const;
+
                 glslang::TShader* compileShader(const String& source, EShLanguage type);
+
+                // Cache hits don't touch glslang at all, wasCached receives whether this was one
+                bool compileSpirv(const String& source, EShLanguage type, std::vector<u32>& out, bool* wasCached = nullptr);
+
+                /*
+                 * Links the stages of one pipeline into a single program without generating any code, only
+                 * to check that the interfaces between them match. Stages are compiled to SPIR-V on their
+                 * own so that they can be cached individually, which skips that check
+                 */
+                bool validateLinkage(const String* sources, const EShLanguage* types, u32 count);
             
             protected:
+                u64 hashShader(const String& source, EShLanguage type) const;
+                bool loadCached(u64 key, std::vector<u32>& out);
+                void storeCached(u64 key, const std::vector<u32>& code);
+                bool generateSpirv(glslang::TShader* shader, EShLanguage type, std::vector<u32>& out);
+
                 LogicalDevice* m_device;
                 bool m_isInitialized;
+                TBuiltInResource m_resources;
+                u64 m_resourceHash;
+                String m_cacheDir;
+                std::mutex m_cacheLock;
+                std::unordered_map<u64, std::vector<u32>> m_cache;
         };
     };
 };
\ No newline at end of file
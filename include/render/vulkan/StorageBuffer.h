@@ -0,0 +1,202 @@
+#pragma once
+#include <render/types.h>
+#include <render/vulkan/Buffer.h>
+#include <render/core/RangeAllocator.h>
+#include <render/core/CapacityHeap.h>
+#include <render/core/BlockLayout.h>
+#include <render/core/DirtyBitset.h>
+
+#include <utils/Array.h>
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+
+namespace render {
+    namespace core {
+        class DataFormat;
+    };
+
+    namespace vulkan {
+        class LogicalDevice;
+        class CommandBuffer;
+        class StorageArray;
+        class StorageBufferFactory;
+
+        /*
+         * Device local storage buffer holding arrays of elements laid out with std430 rules. Writes go to
+         * a persistently mapped staging copy and only the elements that were modified are copied to the
+         * device when submitUpdates is recorded.
+         */
+        class StorageBuffer {
+            public:
+                StorageBuffer(LogicalDevice* device, core::DataFormat* fmt, u32 elementCapacity);
+                ~StorageBuffer();
+
+                bool init();
+                void shutdown();
+
+                LogicalDevice* getDevice() const;
+                core::DataFormat* getFormat() const;
+                VkBuffer getBuffer() const;
+                VkDeviceMemory getMemory() const;
+                u32 getCapacity() const;
+                u32 getCurrentMaximumBlockSize() const;
+                u32 getUsedCount() const;
+
+                // Distance between elements in the buffer, the std430 size of the format
+                u32 getElementSize() const;
+
+                StorageArray* allocate(u32 count);
+                void free(StorageArray* arr);
+
+                bool hasUpdates() const;
+
+                // Records copies for modified elements, neighboring ranges with small gaps are merged into one copy
+                void submitUpdates(CommandBuffer* cb);
+
+            private:
+                friend class StorageArray;
+                friend class StorageBufferFactory;
+
+                // Dirty ranges that are closer than this are copied together, along with the elements between them
+                static constexpr u32 MaxCopyGapBytes = 512;
+
+                /*
+                 * Number of elements in each unit of the range allocator, chosen so that every allocation
+                 * starts at a multiple of minStorageBufferOffsetAlignment and can be bound on its own
+                 */
+                static u32 AllocationGranularity(LogicalDevice* device, core::DataFormat* fmt);
+
+                void freeAllArrays();
+                void markUpdated(u32 first, u32 count);
+                void recordUpdates(CommandBuffer* cb);
+
+                LogicalDevice* m_device;
+                core::DataFormat* m_fmt;
+                u32 m_elementSize;
+                u32 m_granularity;
+                u32 m_capacity;
+
+                Buffer m_buffer;
+                Buffer m_stagingBuffer;
+                u8* m_elements;
+
+                core::RangeAllocator m_allocator;
+                core::DirtyBitset m_updated;
+                u32 m_maxCopyGap;
+                Array<VkBufferCopy> m_copyRanges;
+
+                // factory that owns this buffer, notified when the free capacity changes
+                StorageBufferFactory* m_factory;
+                u32 m_heapIndex;
+                bool m_isQueuedForSubmit;
+        };
+
+        class StorageArray {
+            public:
+                // index of the first element in the buffer
+                u32 getOffset() const;
+                u32 getByteOffset() const;
+                u32 getSize() const;
+                u32 getCount() const;
+                StorageBuffer* getBuffer() const;
+                void free();
+
+                /*
+                 * If ElementTp declares a StorageLayout (see core::StructLayout) the element is packed with
+                 * it, otherwise the buffer's DataFormat is interpreted to copy each attribute
+                 */
+                template <typename ElementTp>
+                bool set(u32 idx, const ElementTp& data) {
+                    if (idx >= m_count) return false;
+
+                    packElement(data, m_buffer->m_elements + ((getOffset() + idx) * m_buffer->m_elementSize));
+                    m_buffer->markUpdated(getOffset() + idx, 1);
+                    return true;
+                }
+
+                template <typename ElementTp>
+                bool set(u32 first, const ElementTp* data, u32 count) {
+                    if (first + count > m_count) return false;
+
+                    u8* dst = m_buffer->m_elements + ((getOffset() + first) * m_buffer->m_elementSize);
+                    for (u32 i = 0;i < count;i++) packElement(data[i], dst + (i * m_buffer->m_elementSize));
+
+                    m_buffer->markUpdated(getOffset() + first, count);
+                    return true;
+                }
+
+                /*
+                 * Pointer to an element in the staging copy, already in std430 layout. markUpdated must be
+                 * called for anything written through it.
+                 */
+                void* getPointer(u32 idx = 0) const;
+                void markUpdated(u32 first, u32 count);
+
+            private:
+                friend class StorageBuffer;
+
+                StorageArray(StorageBuffer* buf, core::RangeAllocator::Range* range, u32 count);
+                ~StorageArray();
+
+                template <typename ElementTp>
+                void packElement(const ElementTp& data, u8* dst) {
+                    if constexpr (core::HasStorageLayout<ElementTp>) {
+                        static_assert(ElementTp::StorageLayout::Rule == BL_STD430, "Storage blocks must use the std430 layout");
+                        ElementTp::StorageLayout::Pack(data, dst);
+                    } else {
+                        m_buffer->m_fmt->packBlock(BL_STD430, &data, dst);
+                    }
+                }
+
+                StorageBuffer* m_buffer;
+                core::RangeAllocator::Range* m_range;
+                u32 m_count;
+        };
+
+        class StorageBufferFactory {
+            public:
+                StorageBufferFactory(LogicalDevice* device, u32 minBufferCapacity);
+                ~StorageBufferFactory();
+
+                void freeAll();
+
+                StorageArray* allocate(core::DataFormat* fmt, u32 count);
+
+                /*
+                 * Records the copies for every buffer from this factory that has modified elements, followed
+                 * by a single barrier that makes them visible to shader storage reads. Must be recorded
+                 * outside of a render pass.
+                 */
+                void submitUpdates(CommandBuffer* cb);
+
+            private:
+                friend class StorageBuffer;
+
+                typedef core::CapacityHeap<
+                    StorageBuffer,
+                    &StorageBuffer::getCurrentMaximumBlockSize,
+                    &StorageBuffer::m_heapIndex
+                > buffer_heap;
+
+                struct buffer_list {
+                    core::DataFormat* format;
+
+                    // the buffer with the largest free range is always on top
+                    buffer_heap buffers;
+                };
+
+                buffer_list* findList(const core::DataFormat* fmt) const;
+                void onCapacityChanged(StorageBuffer* buf);
+
+                LogicalDevice* m_device;
+                u32 m_minBufferCapacity;
+
+                // lists with colliding hashes share an entry
+                std::unordered_map<u64, Array<buffer_list*>> m_listMap;
+                Array<buffer_list*> m_buffers;
+
+                // buffers with updates that haven't been submitted yet
+                Array<StorageBuffer*> m_updatedBuffers;
+        };
+    };
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <render/types.h>
 #include <render/vulkan/Buffer.h>
+#include <render/vulkan/MemoryAllocator.h>
 
 #include <vulkan/vulkan.h>
 
@@ -8,6 +9,7 @@ namespace render {
     namespace vulkan {
         class LogicalDevice;
         class CommandBuffer;
+        class BindlessTable;
         struct VulkanFormatInfo;
 
         class Texture {
@@ -30,6 +32,9 @@ namespace render {
                 VkImageView getView() const;
                 VkSampler getSampler() const;
 
+                // Index of the texture in the BindlessTable it was added to, BindlessTable::InvalidIndex otherwise
+                u32 getBindlessIndex() const;
+
                 bool init(
                     u32 width,
                     u32 height,
@@ -50,7 +55,11 @@ namespace render {
                 void flushPixels(CommandBuffer* cb);
 
             protected:
+                friend class BindlessTable;
+
                 LogicalDevice* m_device;
+                BindlessTable* m_bindlessTable;
+                u32 m_bindlessIndex;
                 VkImageType m_type;
                 VkImageLayout m_layout;
                 VkFormat m_format;
@@ -62,7 +71,7 @@ namespace render {
 
                 Buffer m_stagingBuffer;
                 VkImage m_image;
-                VkDeviceMemory m_memory;
+                MemoryAllocation m_memory;
                 VkImageView m_view;
                 VkSampler m_sampler;
         };
@@ -0,0 +1,80 @@
+#pragma once
+#include <render/types.h>
+
+#include <vulkan/vulkan.h>
+
+namespace render {
+    namespace vulkan {
+        class LogicalDevice;
+        class Buffer;
+        class CommandBuffer;
+        class CommandPool;
+        class Queue;
+
+        /*
+         * Collects writes to device local buffers in host visible staging memory and records them
+         * as buffer copies. Staging memory for recorded copies must stay alive until the command
+         * buffer they were recorded to has finished executing, so it's tagged with the frame slot
+         * that recorded it and only released once that slot's fence has been waited on (see
+         * FrameContext::recordTransfers and FrameManager::addTransferBatch).
+         */
+        class TransferBatch {
+            public:
+                TransferBatch(LogicalDevice* device, u64 stagingBlockSize = 4 * 1024 * 1024);
+                ~TransferBatch();
+
+                LogicalDevice* getDevice() const;
+                bool hasPending() const;
+                u64 getPendingSize() const;
+
+                // Returns a pointer to size bytes of staging memory which will be copied to dst at dstOffset
+                void* stage(Buffer* dst, u64 dstOffset, u64 size);
+                bool write(Buffer* dst, u64 dstOffset, const void* data, u64 size);
+
+                /*
+                 * Records all pending copies followed by a barrier that makes them visible to shaders and
+                 * vertex input. Must be recorded outside of a render pass
+                 */
+                void record(CommandBuffer* cb, u32 frameIdx);
+
+                // Only call this after the GPU is done with everything recorded for the frame slot
+                void releaseSubmitted(u32 frameIdx);
+
+                // Records and submits pending copies to queue, then waits for them to complete
+                bool flush(Queue* queue);
+
+                void shutdown();
+            
+            protected:
+                // frame slot used for copies recorded by flush(), which are released immediately
+                static constexpr u32 FlushFrameIdx = 0xFFFFFFFF;
+
+                struct staging_block {
+                    Buffer* buffer;
+                    u8* data;
+                    u64 used;
+                    u32 frameIdx;
+                };
+
+                struct pending_copy {
+                    Buffer* src;
+                    Buffer* dst;
+                    VkBufferCopy region;
+                };
+
+                staging_block* getStagingBlock(u64 size);
+
+                LogicalDevice* m_device;
+                u64 m_stagingBlockSize;
+                u64 m_pendingSize;
+                CommandPool* m_cmdPool;
+                CommandBuffer* m_cmdBuffer;
+
+                Array<staging_block> m_pendingBlocks;
+                Array<staging_block> m_submittedBlocks;
+                Array<staging_block> m_freeBlocks;
+                Array<pending_copy> m_copies;
+                Array<VkBufferCopy> m_regions;
+        };
+    };
+};
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 #include <render/types.h>
 #include <render/vulkan/Buffer.h>
+#include <render/core/CapacityHeap.h>
+#include <render/core/BlockLayout.h>
+#include <render/core/DirtyBitset.h>
 
 #include <vulkan/vulkan.h>
+#include <unordered_map>
 
 namespace render {
     namespace core {
@@ -13,6 +17,7 @@ namespace render {
         class LogicalDevice;
         class UniformObject;
         class CommandBuffer;
+        class UniformBufferFactory;
 
         class UniformBuffer {
             public:
@@ -29,18 +34,33 @@ namespace render {
                 u32 getCapacity() const;
                 u32 getRemaining() const;
 
+                // Distance between objects in the buffer, already aligned to minUniformBufferOffsetAlignment
+                u32 getObjectSize() const;
+
                 UniformObject* allocate();
                 void free(UniformObject* data);
 
+                bool hasUpdates() const;
+
+                // Records copies for modified objects, neighboring ranges with small gaps are merged into one copy
                 void submitUpdates(CommandBuffer* cb);
             
             private:
                 friend class UniformObject;
+                friend class UniformBufferFactory;
 
                 void resetNodes();
                 void insertToFreeList(UniformObject* n);
+                // Dirty ranges that are closer than this are copied together, along with the objects between them
+                static constexpr u32 MaxCopyGapBytes = 512;
+
                 void updateObject(UniformObject* n, const void* data);
-                u8* copyData(const core::DataFormat* fmt, const u8* src, u8* dst);
+                void markUpdated(u32 idx);
+                void recordUpdates(CommandBuffer* cb);
+                bool validateLayoutSize(u32 size) const;
+
+                template <typename Layout>
+                void updateObject(UniformObject* n, const typename Layout::Class& data);
 
                 LogicalDevice* m_device;
                 core::DataFormat* m_fmt;
@@ -55,21 +75,38 @@ namespace render {
                 UniformObject* m_used;
                 UniformObject* m_nodes;
                 u8* m_objects;
-                u8* m_objUpdated;
-                bool m_hasUpdates;
-                u32 m_minUpdateIdx;
-                u32 m_maxUpdateIdx;
+                core::DirtyBitset m_updated;
+                u32 m_maxCopyGap;
+                bool m_isQueuedForSubmit;
                 Array<VkBufferCopy> m_copyRanges;
+
+                // factory that owns this buffer, notified when the free capacity changes
+                UniformBufferFactory* m_factory;
+                u32 m_heapIndex;
         };
 
         class UniformObject {
             public:
                 UniformBuffer* getBuffer() const;
                 void getRange(u32* offset, u32* size) const;
+
+                // Offset to pass to CommandBuffer::bindDescriptorSet when the buffer is bound as a dynamic uniform block
+                u32 getDynamicOffset() const;
                 void free();
 
+                /*
+                 * If ObjectTp declares a UniformLayout (see core::StructLayout) the object is packed with it,
+                 * otherwise the buffer's DataFormat is interpreted to copy each attribute
+                 */
                 template <typename ObjectTp>
-                void set(const ObjectTp& data) { m_buffer->updateObject(this, &data); }
+                void set(const ObjectTp& data) {
+                    if constexpr (core::HasUniformLayout<ObjectTp>) {
+                        static_assert(ObjectTp::UniformLayout::Rule == BL_STD140, "Uniform blocks must use the std140 layout");
+                        m_buffer->updateObject<typename ObjectTp::UniformLayout>(this, data);
+                    } else {
+                        m_buffer->updateObject(this, &data);
+                    }
+                }
 
             private:
                 friend class UniformBuffer;
@@ -83,6 +120,14 @@ namespace render {
                 UniformObject* m_next;
         };
 
+        template <typename Layout>
+        void UniformBuffer::updateObject(UniformObject* n, const typename Layout::Class& data) {
+            if (!validateLayoutSize(Layout::Size)) return;
+
+            Layout::Pack(data, m_objects + (n->m_index * m_paddedObjectSize));
+            markUpdated(n->m_index);
+        }
+
         class UniformBufferFactory {
             public:
                 UniformBufferFactory(LogicalDevice* device, u32 maxObjectsPerBuffer);
@@ -91,13 +136,42 @@ namespace render {
                 void freeAll();
 
                 UniformObject* allocate(core::DataFormat* fmt);
+
+                /*
+                 * Records the copies for every buffer from this factory that has modified objects, followed
+                 * by a single barrier that makes them visible to shader uniform reads. Must be recorded
+                 * outside of a render pass.
+                 */
+                void submitUpdates(CommandBuffer* cb);
             
             private:
+                friend class UniformBuffer;
+
+                typedef core::CapacityHeap<
+                    UniformBuffer,
+                    &UniformBuffer::getRemaining,
+                    &UniformBuffer::m_heapIndex
+                > buffer_heap;
+
+                struct buffer_list {
+                    core::DataFormat* format;
+
+                    // the buffer with the most free objects is always on top
+                    buffer_heap buffers;
+                };
+
+                buffer_list* findList(const core::DataFormat* fmt) const;
+                void onCapacityChanged(UniformBuffer* buf);
+
                 LogicalDevice* m_device;
                 u32 m_maxObjectsPerBuffer;
 
-                Array<core::DataFormat*> m_formats;
-                Array<Array<UniformBuffer*>> m_buffers;
+                // lists with colliding hashes share an entry
+                std::unordered_map<u64, Array<buffer_list*>> m_listMap;
+                Array<buffer_list*> m_buffers;
+
+                // buffers with updates that haven't been submitted yet
+                Array<UniformBuffer*> m_updatedBuffers;
         };
     };
 };
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 #include <render/types.h>
 #include <render/vulkan/Buffer.h>
+#include <render/core/RangeAllocator.h>
+#include <render/core/CapacityHeap.h>
 
 #include <utils/Array.h>
 #include <vulkan/vulkan.h>
+#include <unordered_map>
 
 namespace render {
     namespace core {
@@ -13,10 +16,20 @@ namespace render {
     namespace vulkan {
         class LogicalDevice;
         class Vertices;
+        class TransferBatch;
+        class CommandBuffer;
+        class VertexBufferFactory;
 
         class VertexBuffer {
             public:
-                VertexBuffer(LogicalDevice* device, core::DataFormat* fmt, u32 vertexCapacity);
+                // transfer is required for BP_DEVICE_LOCAL buffers, updates are staged through it
+                VertexBuffer(
+                    LogicalDevice* device,
+                    core::DataFormat* fmt,
+                    u32 vertexCapacity,
+                    BUFFER_PLACEMENT placement = BP_HOST_VISIBLE,
+                    TransferBatch* transfer = nullptr
+                );
                 ~VertexBuffer();
 
                 bool init();
@@ -24,43 +37,45 @@ namespace render {
 
                 LogicalDevice* getDevice() const;
                 core::DataFormat* getFormat() const;
+                BUFFER_PLACEMENT getPlacement() const;
                 VkBuffer getBuffer() const;
                 VkDeviceMemory getMemory() const;
                 u32 getCapacity() const;
                 u32 getCurrentMaximumBlockSize() const;
+                u32 getUsedCount() const;
+                u32 getAllocationCount() const;
+
+                // 0 when all free space is contiguous, approaching 1 as it is split into many small ranges
+                f32 getFragmentation() const;
 
                 Vertices* allocate(u32 count);
                 void free(Vertices* verts);
             
             private:
                 friend class Vertices;
+                friend class VertexBufferFactory;
 
-                struct node {
-                    Vertices* verts;
-                    u32 offset;
-                    u32 size;
-                    node* last;
-                    node* next;
-                };
+                void freeAllVertices();
 
-                void recalculateMaximumBlockSize();
-                void resetNodes();
-                node* getNode(u32 vcount);
-                void recycleNode(node* n);
-                void insertToFreeList(node* n);
+                // host visible buffers are only mapped while something is reading or writing them
+                bool mapMemory();
+                void unmapMemory();
 
                 LogicalDevice* m_device;
                 Buffer m_buffer;
+                BUFFER_PLACEMENT m_placement;
+                TransferBatch* m_transfer;
                 core::DataFormat* m_fmt;
+                core::RangeAllocator m_allocator;
                 u32 m_capacity;
-                u32 m_currentMaximumBlockSize;
-                u32 m_nodeCount;
                 u32 m_memoryMapRefCount;
 
-                node* m_freeBlocks;
-                node* m_usedBlocks;
-                node* m_unusedNodes;
-                node* m_nodes;
+                // set when the factory is moving this buffer's vertices elsewhere, nothing new is allocated from it
+                bool m_isDraining;
+
+                // factory that owns this buffer, notified when the free capacity changes
+                VertexBufferFactory* m_factory;
+                u32 m_heapIndex;
         };
 
         class Vertices {
@@ -72,42 +87,103 @@ namespace render {
                 VertexBuffer* getBuffer() const;
                 void free();
 
+                /*
+                 * For device local buffers the whole allocation is staged and uploaded when the
+                 * copies recorded by the buffer's TransferBatch execute, so every vertex must be
+                 * written between beginUpdate and commitUpdate
+                 */
                 bool beginUpdate();
-                bool write(void* data, u32 offset, u32 count);
+
+                // offset is relative to the start of this allocation
+                bool write(const void* data, u32 offset, u32 count);
                 
                 // will dereference null pointer if beginUpdate is not called or
                 // if a beginUpdate failure is ignored
                 template <typename VertexTp>
-                VertexTp& at(u32 idx) { return ((VertexTp*)m_buffer->m_buffer.getPointer())[idx]; }
+                VertexTp& at(u32 idx) { return ((VertexTp*)m_writePtr)[idx]; }
 
                 bool commitUpdate();
 
             private:
                 friend class VertexBuffer;
+                friend class VertexBufferFactory;
 
-                Vertices(VertexBuffer* buf, core::DataFormat* fmt, VertexBuffer::node* n);
+                Vertices(VertexBuffer* buf, core::DataFormat* fmt, core::RangeAllocator::Range* range, u32 count);
                 ~Vertices();
 
                 VertexBuffer* m_buffer;
                 core::DataFormat* m_fmt;
-                VertexBuffer::node* m_node;
+                core::RangeAllocator::Range* m_range;
+                u32 m_count;
+                u8* m_writePtr;
         };
 
         class VertexBufferFactory {
             public:
-                VertexBufferFactory(LogicalDevice* device, u32 minBufferCapacity);
+                /*
+                 * framesInFlight is how many frames may still be reading from a buffer after it has been
+                 * emptied by defragment, it's released once that many more calls to defragment were made
+                 */
+                VertexBufferFactory(LogicalDevice* device, u32 minBufferCapacity, u32 framesInFlight = 2);
                 ~VertexBufferFactory();
 
                 void freeAll();
 
-                Vertices* allocate(core::DataFormat* fmt, u32 count);
+                /*
+                 * Incrementally moves vertices out of the least occupied buffer of each format into the
+                 * other buffers of that format. Device local vertices are moved by copies recorded to cb,
+                 * host visible ones are copied between the mapped buffers immediately so that they can
+                 * be updated again right away. At most maxBytes are moved per call. Moved Vertices are
+                 * updated in place, so anything drawn with cb after this call uses the new location.
+                 * Should be called once per frame, before any draws are recorded. Returns the number of
+                 * bytes moved.
+                 */
+                u64 defragment(CommandBuffer* cb, u64 maxBytes, f32 maxOccupancy = 0.5f);
+
+                // Updates to BP_DEVICE_LOCAL vertices are staged here, record or flush it before drawing them
+                TransferBatch* getTransferBatch() const;
+
+                Vertices* allocate(core::DataFormat* fmt, u32 count, BUFFER_PLACEMENT placement = BP_HOST_VISIBLE);
             
             private:
+                friend class VertexBuffer;
+
+                typedef core::CapacityHeap<
+                    VertexBuffer,
+                    &VertexBuffer::getCurrentMaximumBlockSize,
+                    &VertexBuffer::m_heapIndex
+                > buffer_heap;
+
+                struct buffer_list {
+                    core::DataFormat* format;
+                    BUFFER_PLACEMENT placement;
+                    VertexBuffer* draining;
+
+                    // the buffer with the largest free range is always on top
+                    buffer_heap buffers;
+                };
+
+                struct retired_buffer {
+                    VertexBuffer* buffer;
+                    u32 framesRemaining;
+                };
+
+                static u64 ListKey(const core::DataFormat* fmt, BUFFER_PLACEMENT placement);
+                buffer_list* findList(const core::DataFormat* fmt, BUFFER_PLACEMENT placement) const;
+                void onCapacityChanged(VertexBuffer* buf);
+                u64 drainBuffer(buffer_list* list, VertexBuffer* src, u64 maxBytes, CommandBuffer* cb);
+                void releaseRetiredBuffers();
+
                 LogicalDevice* m_device;
                 u32 m_minBufferCapacity;
-
-                Array<core::DataFormat*> m_formats;
-                Array<Array<VertexBuffer*>> m_buffers;
+                u32 m_framesInFlight;
+                TransferBatch* m_transfer;
+
+                // lists with colliding keys share an entry
+                std::unordered_map<u64, Array<buffer_list*>> m_listMap;
+                Array<buffer_list*> m_buffers;
+                Array<retired_buffer> m_retired;
+                Array<VkBufferCopy> m_copyRegions;
         };
     };
 };
\ No newline at end of file
@@ -11,12 +11,18 @@
 #include <render/vulkan/SwapChainSupport.h>
 #include <render/vulkan/SwapChain.h>
 #include <render/vulkan/ShaderCompiler.h>
+#include <render/vulkan/PipelineCache.h>
+#include <render/vulkan/PipelineCompiler.h>
 #include <render/vulkan/GraphicsPipeline.h>
 #include <render/vulkan/RenderPass.h>
 #include <render/vulkan/CommandBuffer.h>
 #include <render/vulkan/Queue.h>
 #include <render/vulkan/VertexBuffer.h>
+#include <render/vulkan/IndexBuffer.h>
+#include <render/vulkan/TransferBatch.h>
 #include <render/vulkan/UniformBuffer.h>
+#include <render/vulkan/StorageBuffer.h>
+#include <render/vulkan/BindlessTable.h>
 #include <render/vulkan/DescriptorSet.h>
 #include <render/core/FrameManager.h>
 #include <render/core/FrameContext.h>
@@ -32,12 +38,17 @@ namespace render {
         m_surface = nullptr;
         m_swapChain = nullptr;
         m_shaderCompiler = nullptr;
+        m_pipelineCache = nullptr;
+        m_pipelineCompiler = nullptr;
         m_debugDraw = nullptr;
         m_imgui = nullptr;
         m_frames = nullptr;
         m_vboFactory = nullptr;
+        m_iboFactory = nullptr;
         m_uboFactory = nullptr;
+        m_sboFactory = nullptr;
         m_descriptorFactory = nullptr;
+        m_bindless = nullptr;
 
         m_initialized = false;
     }
@@ -101,6 +112,15 @@ namespace render {
             return false;
         }
 
+        m_pipelineCache = new vulkan::PipelineCache(m_logicalDevice);
+        if (!setupPipelineCache(m_pipelineCache)) {
+            fatal("Client setup for pipeline cache failed.");
+            shutdownRendering();
+            return false;
+        }
+
+        m_logicalDevice->setPipelineCache(m_pipelineCache);
+
         vulkan::SwapChainSupport scSupport;
         if (!m_physicalDevice->getSurfaceSwapChainSupport(m_surface, &scSupport)) {
             fatal("Failed to get swapchain support for '%s'.", m_physicalDevice->getProperties().deviceName);
@@ -145,10 +165,37 @@ namespace render {
             return false;
         }
 
-        m_vboFactory = new vulkan::VertexBufferFactory(m_logicalDevice, 8096);
+        if (!setupShaderCompiler(m_shaderCompiler)) {
+            fatal("Client setup for shader compiler failed.");
+            shutdownRendering();
+            return false;
+        }
+
+        m_pipelineCompiler = new vulkan::PipelineCompiler();
+        m_pipelineCompiler->subscribeLogger(this);
+
+        if (!m_pipelineCompiler->init()) {
+            fatal("Failed to initialize pipeline compiler.");
+            shutdownRendering();
+            return false;
+        }
+
+        m_vboFactory = new vulkan::VertexBufferFactory(m_logicalDevice, 8096, m_frames->getFrameCount());
+        m_frames->addTransferBatch(m_vboFactory->getTransferBatch());
+        m_iboFactory = new vulkan::IndexBufferFactory(m_logicalDevice, 16384);
         m_uboFactory = new vulkan::UniformBufferFactory(m_logicalDevice, 1024);
+        m_sboFactory = new vulkan::StorageBufferFactory(m_logicalDevice, 16384);
         m_descriptorFactory = new vulkan::DescriptorFactory(m_logicalDevice, 256);
 
+        if (m_logicalDevice->isBindlessEnabled()) {
+            m_bindless = new vulkan::BindlessTable(m_logicalDevice, 16384, 4096, m_frames->getFrameCount());
+            if (!m_bindless->init()) {
+                fatal("Failed to initialize bindless descriptor table");
+                shutdownRendering();
+                return false;
+            }
+        }
+
         m_window->subscribe(this);
 
         m_initialized = true;
@@ -194,21 +241,42 @@ namespace render {
             m_debugDraw = nullptr;
         }
 
+        if (m_bindless) {
+            delete m_bindless;
+            m_bindless = nullptr;
+        }
+
         if (m_descriptorFactory) {
             delete m_descriptorFactory;
             m_descriptorFactory = nullptr;
         }
 
+        if (m_sboFactory) {
+            delete m_sboFactory;
+            m_sboFactory = nullptr;
+        }
+
         if (m_uboFactory) {
             delete m_uboFactory;
             m_uboFactory = nullptr;
         }
 
+        if (m_iboFactory) {
+            delete m_iboFactory;
+            m_iboFactory = nullptr;
+        }
+
         if (m_vboFactory) {
+            if (m_frames) m_frames->removeTransferBatch(m_vboFactory->getTransferBatch());
             delete m_vboFactory;
             m_vboFactory = nullptr;
         }
 
+        if (m_pipelineCompiler) {
+            delete m_pipelineCompiler;
+            m_pipelineCompiler = nullptr;
+        }
+
         if (m_shaderCompiler) {
             delete m_shaderCompiler;
             m_shaderCompiler = nullptr;
@@ -229,6 +297,14 @@ namespace render {
             m_swapChain = nullptr;
         }
 
+        if (m_pipelineCache) {
+            m_pipelineCache->save();
+            m_logicalDevice->setPipelineCache(nullptr);
+
+            delete m_pipelineCache;
+            m_pipelineCache = nullptr;
+        }
+
         if (m_logicalDevice) {
             delete m_logicalDevice;
             m_logicalDevice = nullptr;
@@ -303,12 +379,20 @@ namespace render {
     }
 
     bool IWithRendering::setupShaderCompiler(vulkan::ShaderCompiler* shaderCompiler) {
+        shaderCompiler->setCacheDirectory("./shader_cache");
         return true;
     }
     
+    bool IWithRendering::setupPipelineCache(vulkan::PipelineCache* cache) {
+        return cache->init("./pipeline_cache.bin");
+    }
+    
     void IWithRendering::onWindowResize(::utils::Window* win, u32 width, u32 height) {
         if (!m_initialized || win != m_window) return;
         log("Window resized, recreating swapchain (%dx%d)", width, height);
+
+        // pipelines still being compiled can't be recreated from under the workers
+        m_pipelineCompiler->waitForIdle();
         m_logicalDevice->waitForIdle();
         if (!m_swapChain->recreate()) {
             fatal("Failed to recreate swapchain after window resized");
@@ -354,6 +438,18 @@ namespace render {
         return m_shaderCompiler;
     }
     
+    vulkan::PipelineCache* IWithRendering::getPipelineCache() const {
+        return m_pipelineCache;
+    }
+    
+    vulkan::BindlessTable* IWithRendering::getBindlessTable() const {
+        return m_bindless;
+    }
+
+    vulkan::PipelineCompiler* IWithRendering::getPipelineCompiler() const {
+        return m_pipelineCompiler;
+    }
+    
     utils::SimpleDebugDraw* IWithRendering::getDebugDraw() const {
         return m_debugDraw;
     }
@@ -366,14 +462,27 @@ namespace render {
         return m_frames;
     }
 
-    vulkan::Vertices* IWithRendering::allocateVertices(core::DataFormat* fmt, u32 count) {
-        return m_vboFactory->allocate(fmt, count);
+    vulkan::TransferBatch* IWithRendering::getTransferBatch() const {
+        if (!m_vboFactory) return nullptr;
+        return m_vboFactory->getTransferBatch();
+    }
+
+    vulkan::Vertices* IWithRendering::allocateVertices(core::DataFormat* fmt, u32 count, BUFFER_PLACEMENT placement) {
+        return m_vboFactory->allocate(fmt, count, placement);
+    }
+
+    vulkan::Indices* IWithRendering::allocateIndices(u32 count, bool use32BitIndices) {
+        return m_iboFactory->allocate(use32BitIndices ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16, count);
     }
     
     vulkan::UniformObject* IWithRendering::allocateUniformObject(core::DataFormat* fmt) {
         return m_uboFactory->allocate(fmt);
     }
     
+    vulkan::StorageArray* IWithRendering::allocateStorageArray(core::DataFormat* fmt, u32 count) {
+        return m_sboFactory->allocate(fmt, count);
+    }
+    
     vulkan::DescriptorSet* IWithRendering::allocateDescriptor(vulkan::Pipeline* pipeline) {
         return m_descriptorFactory->allocate(pipeline);
     }
@@ -381,7 +490,10 @@ namespace render {
     core::FrameContext* IWithRendering::getFrame() {
         if (!m_frames) return nullptr;
 
-        return m_frames->getFrame();
+        core::FrameContext* frame = m_frames->getFrame();
+        if (frame && m_bindless) m_bindless->advanceFrame();
+
+        return frame;
     }
 
     void IWithRendering::releaseFrame(core::FrameContext* frame) {
@@ -1,18 +1,28 @@
 #include <render/core/DataFormat.h>
+#include <render/core/BlockLayout.h>
+#include <render/core/Hash.h>
 
 #include <utils/Array.hpp>
 
+#include <string.h>
+
 namespace render {
     namespace core {
         DataFormat::DataFormat() {
             m_size = 0;
             m_uniformBlockSize = 0;
+            m_storageBlockSize = 0;
+            m_storageAlignment = 4;
+            m_attrHash = HashSeed;
         }
 
         DataFormat::DataFormat(const DataFormat& o) {
             m_attrs = o.m_attrs;
             m_size = o.m_size;
             m_uniformBlockSize = o.m_uniformBlockSize;
+            m_storageBlockSize = o.m_storageBlockSize;
+            m_storageAlignment = o.m_storageAlignment;
+            m_attrHash = o.m_attrHash;
         }
 
         DataFormat::~DataFormat() {
@@ -21,37 +31,66 @@ namespace render {
         void DataFormat::addAttr(DATA_TYPE type, u32 offset, u32 elementCount) {
             if (type == dt_struct || elementCount == 0) return;
 
+            bool isArray = elementCount > 1;
             u32 sz = DataFormat::AttributeSize(type) * elementCount;
-            u32 usz = DataFormat::AttributeSize(type, true) * elementCount;
+            u32 usz = isArray ? BlockArrayStride(type, BL_STD140) * elementCount : BlockElementSize(type, BL_STD140);
+            u32 uoffset = AlignUp(m_uniformBlockSize, BlockAlignment(type, BL_STD140, isArray));
+            u32 ssz = isArray ? BlockArrayStride(type, BL_STD430) * elementCount : BlockElementSize(type, BL_STD430);
+            u32 salign = BlockAlignment(type, BL_STD430, isArray);
+            u32 soffset = AlignUp(m_storageBlockSize, salign);
             m_attrs.push({
                 type,
                 nullptr,
                 elementCount,
                 offset,
                 sz,
-                usz
+                usz,
+                uoffset,
+                ssz,
+                soffset
             });
 
             m_size += sz;
-            m_uniformBlockSize += usz;
+            m_uniformBlockSize = uoffset + usz;
+            m_storageBlockSize = soffset + ssz;
+            if (salign > m_storageAlignment) m_storageAlignment = salign;
+
+            m_attrHash = HashCombine(m_attrHash, type);
+            m_attrHash = HashCombine(m_attrHash, elementCount);
+            m_attrHash = HashCombine(m_attrHash, offset);
         }
 
         void DataFormat::addAttr(const DataFormat* type, u32 offset, u32 elementCount) {
             if (!type || elementCount == 0) return;
 
+            // std140 structs are aligned to 16 bytes and padded to a multiple of that, std430 structs
+            // only to the largest alignment of their members
             u32 sz = type->m_size * elementCount;
-            u32 usz = type->m_uniformBlockSize * elementCount;
+            u32 usz = type->getUniformBlockSize() * elementCount;
+            u32 uoffset = AlignUp(m_uniformBlockSize, 16);
+            u32 ssz = type->getStorageBlockSize() * elementCount;
+            u32 soffset = AlignUp(m_storageBlockSize, type->m_storageAlignment);
             m_attrs.push({
                 dt_struct,
                 type,
                 elementCount,
                 offset,
                 sz,
-                usz
+                usz,
+                uoffset,
+                ssz,
+                soffset
             });
 
             m_size += sz;
-            m_uniformBlockSize += usz;
+            m_uniformBlockSize = uoffset + usz;
+            m_storageBlockSize = soffset + ssz;
+            if (type->m_storageAlignment > m_storageAlignment) m_storageAlignment = type->m_storageAlignment;
+
+            m_attrHash = HashCombine(m_attrHash, dt_struct);
+            m_attrHash = HashCombine(m_attrHash, type->getHash());
+            m_attrHash = HashCombine(m_attrHash, elementCount);
+            m_attrHash = HashCombine(m_attrHash, offset);
         }
 
         const Array<DataFormat::Attribute>& DataFormat::getAttributes() const {
@@ -67,7 +106,15 @@ namespace render {
         }
         
         u32 DataFormat::getUniformBlockSize() const {
-            return m_uniformBlockSize;
+            return AlignUp(m_uniformBlockSize, 16);
+        }
+
+        u32 DataFormat::getStorageBlockSize() const {
+            return AlignUp(m_storageBlockSize, m_storageAlignment);
+        }
+
+        u32 DataFormat::getStorageAlignment() const {
+            return m_storageAlignment;
         }
 
         bool DataFormat::isValid() const {
@@ -75,20 +122,94 @@ namespace render {
         }
 
         bool DataFormat::isEqualTo(const DataFormat* rhs) const {
+            if (rhs == this) return true;
             if (m_size != rhs->m_size) return false;
             if (m_attrs.size() != rhs->m_attrs.size()) return false;
+            if (m_attrHash != rhs->m_attrHash) return false;
 
             return !m_attrs.some([this, rhs](const DataFormat::Attribute& tp, u32 idx) {
                 auto& attr = rhs->m_attrs[idx];
                 if (attr.type != tp.type) return true;
                 if (attr.elementCount != tp.elementCount) return true;
-                if (attr.size != tp.elementCount) return true;
-                if (attr.formatRef != tp.formatRef) return true;
+                if (attr.offset != tp.offset) return true;
+                if (attr.size != tp.size) return true;
+                if (attr.formatRef != tp.formatRef && !attr.formatRef->isEqualTo(tp.formatRef)) return true;
 
                 return false;
             });
         }
 
+        u64 DataFormat::getHash() const {
+            return HashCombine(m_attrHash, m_size);
+        }
+
+        void DataFormat::packBlock(BLOCK_LAYOUT layout, const void* src, void* dst) const {
+            const u8* srcBytes = (const u8*)src;
+            u8* dstBytes = (u8*)dst;
+
+            for (u32 i = 0;i < m_attrs.size();i++) {
+                const Attribute& a = m_attrs[i];
+                const u8* aSrc = srcBytes + a.offset;
+                u8* aDst = dstBytes + (layout == BL_STD140 ? a.uniformOffset : a.storageOffset);
+
+                if (a.type == dt_struct) {
+                    u32 srcStride = a.formatRef->getSize();
+                    u32 dstStride = layout == BL_STD140 ? a.formatRef->getUniformBlockSize() : a.formatRef->getStorageBlockSize();
+                    for (u32 e = 0;e < a.elementCount;e++) {
+                        a.formatRef->packBlock(layout, aSrc + (e * srcStride), aDst + (e * dstStride));
+                    }
+
+                    continue;
+                }
+
+                // Matrices are copied one column at a time since their columns may be padded
+                u32 columnCount = TypeColumns(a.type);
+                u32 columnSize = TypeRows(a.type) * sizeof(u32);
+                u32 columnStride = BlockColumnStride(a.type, layout);
+                u32 srcStride = AttributeSize(a.type);
+                u32 dstStride = a.elementCount > 1 ? BlockArrayStride(a.type, layout) : 0;
+
+                if (columnStride == columnSize && (a.elementCount == 1 || dstStride == srcStride)) {
+                    memcpy(aDst, aSrc, a.size);
+                    continue;
+                }
+
+                for (u32 e = 0;e < a.elementCount;e++) {
+                    const u8* eSrc = aSrc + (e * srcStride);
+                    u8* eDst = aDst + (e * dstStride);
+                    for (u32 c = 0;c < columnCount;c++) {
+                        memcpy(eDst + (c * columnStride), eSrc + (c * columnSize), columnSize);
+                    }
+                }
+            }
+        }
+
+        void DataFormat::getVertexAttributes(Array<VertexAttribute>& out, u32 baseOffset) const {
+            for (u32 i = 0;i < m_attrs.size();i++) {
+                const Attribute& a = m_attrs[i];
+
+                if (a.type == dt_struct) {
+                    u32 stride = a.formatRef->getSize();
+                    for (u32 e = 0;e < a.elementCount;e++) {
+                        a.formatRef->getVertexAttributes(out, baseOffset + a.offset + (e * stride));
+                    }
+
+                    continue;
+                }
+
+                DATA_TYPE columnType = ColumnType(a.type);
+                u32 columnCount = TypeColumns(a.type);
+                u32 columnSize = TypeRows(a.type) * sizeof(u32);
+                u32 stride = AttributeSize(a.type);
+
+                for (u32 e = 0;e < a.elementCount;e++) {
+                    for (u32 c = 0;c < columnCount;c++) {
+                        out.push({ columnType, baseOffset + a.offset + (e * stride) + (c * columnSize) });
+                    }
+                }
+            }
+        }
+
         u32 DataFormat::AttributeSize(DATA_TYPE type, bool uniformAligned) {
             static u32 dtSizes[dt_enum_count] = {
                 sizeof(i32),       // dt_int
@@ -115,32 +236,8 @@ namespace render {
                 0                  // dt_struct
             };
 
-            static u32 dtUboSizes[dt_enum_count] = {
-                sizeof(i32),       // dt_int
-                sizeof(f32),       // dt_float
-                sizeof(u32),       // dt_uint
-                sizeof(i32) * 2,   // dt_vec2i
-                sizeof(f32) * 2,   // dt_vec2f
-                sizeof(u32) * 2,   // dt_vec2ui
-                sizeof(i32) * 4,   // dt_vec3i
-                sizeof(f32) * 4,   // dt_vec3f
-                sizeof(u32) * 4,   // dt_vec3ui
-                sizeof(i32) * 4,   // dt_vec4i
-                sizeof(f32) * 4,   // dt_vec4f
-                sizeof(u32) * 4,   // dt_vec4ui
-                sizeof(i32) * 4,   // dt_mat2i
-                sizeof(f32) * 4,   // dt_mat2f
-                sizeof(u32) * 4,   // dt_mat2ui
-                sizeof(i32) * 16,   // dt_mat3i
-                sizeof(f32) * 16,   // dt_mat3f
-                sizeof(u32) * 16,   // dt_mat3ui
-                sizeof(i32) * 16,  // dt_mat4i
-                sizeof(f32) * 16,  // dt_mat4f
-                sizeof(u32) * 16,  // dt_mat4ui
-                0                  // dt_struct
-            };
-
-            return uniformAligned ? dtUboSizes[type] : dtSizes[type];
+            if (uniformAligned) return BlockElementSize(type, BL_STD140);
+            return dtSizes[type];
         }
     };
 };
\ No newline at end of file
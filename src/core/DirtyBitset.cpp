@@ -0,0 +1,91 @@
+#include <render/core/DirtyBitset.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+#include <string.h>
+
+namespace render {
+    namespace core {
+        DirtyBitset::DirtyBitset(u32 count) {
+            m_count = count;
+            m_wordCount = (count + 63) / 64;
+            m_words = new u64[m_wordCount];
+            memset(m_words, 0, m_wordCount * sizeof(u64));
+            m_minWord = m_wordCount;
+            m_endWord = 0;
+        }
+
+        DirtyBitset::~DirtyBitset() {
+            delete [] m_words;
+            m_words = nullptr;
+        }
+
+        void DirtyBitset::set(u32 idx) {
+            if (idx >= m_count) return;
+
+            u32 w = idx >> 6;
+            m_words[w] |= u64(1) << (idx & 63);
+            if (w < m_minWord) m_minWord = w;
+            if (w >= m_endWord) m_endWord = w + 1;
+        }
+
+        void DirtyBitset::setRange(u32 first, u32 count) {
+            if (first >= m_count || count == 0) return;
+            if (count > m_count - first) count = m_count - first;
+
+            u32 last = first + count - 1;
+            u32 firstWord = first >> 6;
+            u32 lastWord = last >> 6;
+
+            u64 firstMask = ~u64(0) << (first & 63);
+            u64 lastMask = ~u64(0) >> (63 - (last & 63));
+
+            if (firstWord == lastWord) m_words[firstWord] |= firstMask & lastMask;
+            else {
+                m_words[firstWord] |= firstMask;
+                for (u32 w = firstWord + 1;w < lastWord;w++) m_words[w] = ~u64(0);
+                m_words[lastWord] |= lastMask;
+            }
+
+            if (firstWord < m_minWord) m_minWord = firstWord;
+            if (lastWord >= m_endWord) m_endWord = lastWord + 1;
+        }
+
+        bool DirtyBitset::any() const {
+            return m_minWord < m_endWord;
+        }
+
+        void DirtyBitset::clear() {
+            if (any()) memset(m_words + m_minWord, 0, (m_endWord - m_minWord) * sizeof(u64));
+            m_minWord = m_wordCount;
+            m_endWord = 0;
+        }
+
+        u32 DirtyBitset::getCount() const {
+            return m_count;
+        }
+
+        u32 DirtyBitset::findNonZeroWord(u32 begin, u32 end) const {
+            u32 i = begin;
+
+            #if defined(__AVX2__)
+                for (;i + 4 <= end;i += 4) {
+                    __m256i v = _mm256_loadu_si256((const __m256i*)(m_words + i));
+                    if (!_mm256_testz_si256(v, v)) break;
+                }
+            #elif defined(__ARM_NEON) && defined(__aarch64__)
+                for (;i + 4 <= end;i += 4) {
+                    uint64x2_t v = vorrq_u64(vld1q_u64(m_words + i), vld1q_u64(m_words + i + 2));
+                    if (vmaxvq_u32(vreinterpretq_u32_u64(v)) != 0) break;
+                }
+            #endif
+
+            while (i < end && m_words[i] == 0) i++;
+            return i;
+        }
+    };
+};
\ No newline at end of file
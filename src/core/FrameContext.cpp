@@ -1,5 +1,7 @@
 #include <render/core/FrameContext.h>
 #include <render/core/FrameManager.h>
+#include <render/core/TransientAllocator.h>
+#include <render/core/DataFormat.h>
 #include <render/vulkan/LogicalDevice.h>
 #include <render/vulkan/Instance.h>
 #include <render/vulkan/SwapChain.h>
@@ -7,6 +9,8 @@
 #include <render/vulkan/CommandBuffer.h>
 #include <render/vulkan/Framebuffer.h>
 #include <render/vulkan/Queue.h>
+#include <render/vulkan/DescriptorSet.h>
+#include <render/vulkan/TransferBatch.h>
 
 namespace render {
     namespace core {
@@ -15,10 +19,11 @@ namespace render {
             m_buffer = nullptr;
             m_framebuffer = nullptr;
             m_swapChainReady = VK_NULL_HANDLE;
-            m_renderComplete = VK_NULL_HANDLE;
             m_fence = VK_NULL_HANDLE;
             m_scImageIdx = 0;
+            m_frameIdx = 0;
             m_frameStarted = false;
+            m_isLive = false;
         }
 
         FrameContext::~FrameContext() {
@@ -41,6 +46,10 @@ namespace render {
             return m_scImageIdx;
         }
 
+        u32 FrameContext::getFrameIndex() const {
+            return m_frameIdx;
+        }
+
         void FrameContext::setClearColor(u32 attachmentIdx, const vec4f& clearColor) {
             if (!m_framebuffer) return;
             m_framebuffer->setClearColor(attachmentIdx, clearColor);
@@ -65,12 +74,30 @@ namespace render {
             if (m_frameStarted || !m_buffer) return false;
 
             if (vkWaitForFences(m_device->get(), 1, &m_fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) return false;
-            if (vkResetFences(m_device->get(), 1, &m_fence) != VK_SUCCESS) return false;
 
             if (vkAcquireNextImageKHR(m_device->get(), m_swapChain->get(), UINT64_MAX, m_swapChainReady, nullptr, &m_scImageIdx) != VK_SUCCESS) {
                 return false;
             }
 
+            // The acquired image may still be in use by a different frame if there are more
+            // swapchain images than frames in flight (or the presentation engine returned them
+            // out of order)
+            VkFence& imageFence = m_mgr->m_imageFences[m_scImageIdx];
+            if (imageFence != VK_NULL_HANDLE && imageFence != m_fence) {
+                if (vkWaitForFences(m_device->get(), 1, &imageFence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) return false;
+            }
+            imageFence = m_fence;
+
+            // Only reset after acquiring succeeds, otherwise the next wait on this fence would never return
+            if (vkResetFences(m_device->get(), 1, &m_fence) != VK_SUCCESS) return false;
+
+            // Everything that was allocated the last time this slot was used has been consumed by now
+            m_mgr->m_transient->reset(m_frameIdx);
+            m_mgr->m_transientDescriptors->reset(m_frameIdx);
+            m_mgr->m_transferBatches.each([this](vulkan::TransferBatch* batch) {
+                batch->releaseSubmitted(m_frameIdx);
+            });
+
             m_framebuffer = m_mgr->m_framebuffers[m_scImageIdx];
 
             if (!m_buffer->reset()) return false;
@@ -83,13 +110,15 @@ namespace render {
         bool FrameContext::end() {
             if (!m_frameStarted || !m_buffer->end()) return false;
 
+            VkSemaphore renderComplete = m_mgr->m_renderComplete[m_scImageIdx];
+
             bool submitResult = m_device->getGraphicsQueue()->submit(
                 m_buffer,
                 m_fence,
                 1,
                 &m_swapChainReady,
                 1,
-                &m_renderComplete,
+                &renderComplete,
                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
             );
 
@@ -104,7 +133,7 @@ namespace render {
             VkPresentInfoKHR pi = {};
             pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
             pi.waitSemaphoreCount = 1;
-            pi.pWaitSemaphores = &m_renderComplete;
+            pi.pWaitSemaphores = &renderComplete;
             pi.swapchainCount = 1;
             pi.pSwapchains = &swap;
             pi.pImageIndices = &m_scImageIdx;
@@ -117,6 +146,26 @@ namespace render {
             return true;
         }
 
+        bool FrameContext::allocTransient(u64 size, u64 alignment, TransientAllocation& out) {
+            if (!m_frameStarted) return false;
+            return m_mgr->m_transient->alloc(m_frameIdx, size, alignment, out);
+        }
+
+        bool FrameContext::allocInstances(const DataFormat* fmt, u32 count, TransientAllocation& out) {
+            if (!m_frameStarted || !fmt || !fmt->isValid() || count == 0) return false;
+            return m_mgr->m_transient->alloc(m_frameIdx, u64(fmt->getSize()) * count, 0, out);
+        }
+
+        vulkan::DescriptorSet* FrameContext::allocateDescriptor(vulkan::Pipeline* pipeline) {
+            if (!m_frameStarted) return nullptr;
+            return m_mgr->m_transientDescriptors->allocate(m_frameIdx, pipeline);
+        }
+
+        void FrameContext::recordTransfers(vulkan::TransferBatch* batch) {
+            if (!m_frameStarted || !batch) return;
+            batch->record(m_buffer, m_frameIdx);
+        }
+
         bool FrameContext::init(vulkan::SwapChain* swapChain, vulkan::CommandBuffer* cb) {
             m_swapChain = swapChain;
             m_buffer = cb;
@@ -130,12 +179,6 @@ namespace render {
                 return false;
             }
 
-            if (vkCreateSemaphore(m_device->get(), &si, m_device->getInstance()->getAllocator(), &m_renderComplete) != VK_SUCCESS) {
-                fatal("Failed to create render completion semaphore.");
-                shutdown();
-                return false;
-            }
-
             VkFenceCreateInfo fi = {};
             fi.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
             fi.flags = VK_FENCE_CREATE_SIGNALED_BIT;
@@ -155,11 +198,6 @@ namespace render {
                 m_fence = VK_NULL_HANDLE;
             }
 
-            if (m_renderComplete) {
-                vkDestroySemaphore(m_device->get(), m_renderComplete, m_device->getInstance()->getAllocator());
-                m_renderComplete = VK_NULL_HANDLE;
-            }
-
             if (m_swapChainReady) {
                 vkDestroySemaphore(m_device->get(), m_swapChainReady, m_device->getInstance()->getAllocator());
                 m_swapChainReady = VK_NULL_HANDLE;
@@ -169,7 +207,6 @@ namespace render {
             m_buffer = nullptr;
             m_framebuffer = nullptr;
             m_swapChainReady = VK_NULL_HANDLE;
-            m_renderComplete = VK_NULL_HANDLE;
             m_fence = VK_NULL_HANDLE;
             m_scImageIdx = 0;
             m_frameStarted = false;
@@ -1,6 +1,8 @@
 #include <render/core/FrameManager.h>
 #include <render/core/FrameContext.h>
+#include <render/core/TransientAllocator.h>
 #include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/Instance.h>
 #include <render/vulkan/CommandPool.h>
 #include <render/vulkan/CommandBuffer.h>
 #include <render/vulkan/RenderPass.h>
@@ -8,34 +10,37 @@
 #include <render/vulkan/Texture.h>
 #include <render/vulkan/Queue.h>
 #include <render/vulkan/Framebuffer.h>
+#include <render/vulkan/DescriptorSet.h>
+#include <render/vulkan/TransferBatch.h>
 
 #include <utils/Array.hpp>
 
 namespace render {
     namespace core {
-        FrameManager::FrameManager(vulkan::SwapChain* swapChain, vulkan::RenderPass* renderPass) : utils::IWithLogging("Frame Manager") {
+        FrameManager::FrameManager(
+            vulkan::SwapChain* swapChain,
+            vulkan::RenderPass* renderPass,
+            u32 framesInFlight,
+            u64 transientBytesPerFrame,
+            u32 transientSetsPerPool
+        ) : utils::IWithLogging("Frame Manager") {
             m_renderPass = renderPass;
             m_swapChain = swapChain;
             m_device = m_swapChain->getDevice();
             m_cmdPool = new vulkan::CommandPool(m_device, &m_device->getGraphicsQueue()->getFamily());
-            m_frameCount = m_swapChain->getImageCount();
+            m_frameCount = framesInFlight > 0 ? framesInFlight : 1;
+            m_nextFrameIdx = 0;
+            m_transient = new TransientAllocator(m_device, m_frameCount, transientBytesPerFrame);
+            m_transient->subscribeLogger(this);
+            m_transientDescriptors = new vulkan::TransientDescriptorAllocator(m_device, m_frameCount, transientSetsPerPool);
 
-            m_frames = new FrameNode[m_frameCount];
-            m_liveFrames = nullptr;
-            m_freeFrames = m_frames;
+            m_frames.reserve(m_frameCount);
             for (u32 i = 0;i < m_frameCount;i++) {
-                m_frames[i].frame = new FrameContext();
-                m_frames[i].frame->subscribeLogger(this);
-                m_frames[i].frame->m_mgr = this;
-
-                if (i > 0) {
-                    m_frames[i].last = &m_frames[i - 1];
-                    m_frames[i].next = nullptr;
-                    m_frames[i - 1].next = &m_frames[i];
-                } else {
-                    m_frames[i].last = nullptr;
-                    m_frames[i].next = nullptr;
-                }
+                FrameContext* frame = new FrameContext();
+                frame->subscribeLogger(this);
+                frame->m_mgr = this;
+                frame->m_frameIdx = i;
+                m_frames.push(frame);
             }
         }
 
@@ -44,13 +49,17 @@ namespace render {
             
             delete m_cmdPool;
             m_cmdPool = nullptr;
-            
-            for (u32 i = 0;i < m_frameCount;i++) {
-                delete m_frames[i].frame;
-            }
 
-            delete [] m_frames;
-            m_freeFrames = m_liveFrames = m_frames = nullptr;
+            delete m_transient;
+            m_transient = nullptr;
+
+            delete m_transientDescriptors;
+            m_transientDescriptors = nullptr;
+            
+            m_frames.each([](FrameContext* frame) {
+                delete frame;
+            });
+            m_frames.clear();
         }
 
         vulkan::CommandPool* FrameManager::getCommandPool() const {
@@ -61,10 +70,29 @@ namespace render {
             return m_frameCount;
         }
 
+        TransientAllocator* FrameManager::getTransientAllocator() const {
+            return m_transient;
+        }
+
+        vulkan::TransientDescriptorAllocator* FrameManager::getTransientDescriptors() const {
+            return m_transientDescriptors;
+        }
+
         bool FrameManager::init() {
             if (!m_cmdPool->init(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT)) return false;
 
-            m_framebuffers.reserve(m_frameCount);
+            if (!m_transient->init()) {
+                fatal("Failed to initialize transient allocator");
+                shutdown();
+                return false;
+            }
+
+            if (!m_transientDescriptors->init()) {
+                fatal("Failed to initialize transient descriptor allocator");
+                shutdown();
+                return false;
+            }
+
             for (u32 i = 0;i < m_frameCount;i++) {
                 vulkan::CommandBuffer* cb = m_cmdPool->createBuffer(true);
                 if (!cb) {
@@ -73,7 +101,31 @@ namespace render {
                     return false;
                 }
 
-                if (!m_frames[i].frame->init(m_swapChain, cb)) return false;
+                if (!m_frames[i]->init(m_swapChain, cb)) {
+                    shutdown();
+                    return false;
+                }
+            }
+
+            u32 imageCount = m_swapChain->getImageCount();
+            m_framebuffers.reserve(imageCount);
+            m_imageFences.reserve(imageCount);
+            m_renderComplete.reserve(imageCount);
+
+            VkSemaphoreCreateInfo si = {};
+            si.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+            for (u32 i = 0;i < imageCount;i++) {
+                m_imageFences.push(VK_NULL_HANDLE);
+
+                VkSemaphore renderComplete = VK_NULL_HANDLE;
+                if (vkCreateSemaphore(m_device->get(), &si, m_device->getInstance()->getAllocator(), &renderComplete) != VK_SUCCESS) {
+                    fatal("Failed to create render completion semaphore.");
+                    shutdown();
+                    return false;
+                }
+
+                m_renderComplete.push(renderComplete);
 
                 vulkan::Framebuffer* fb = new vulkan::Framebuffer(m_renderPass);
                 fb->attach(m_swapChain->getImageViews()[i], m_swapChain->getFormat());
@@ -94,46 +146,55 @@ namespace render {
 
         void FrameManager::shutdown() {
             for (u32 i = 0;i < m_frameCount;i++) {
-                m_frames[i].frame->shutdown();
-                m_framebuffers[i]->shutdown();
+                m_frames[i]->shutdown();
             }
 
+            m_framebuffers.each([](vulkan::Framebuffer* fb) {
+                delete fb;
+            });
+
             m_framebuffers.clear();
+            m_imageFences.clear();
+
+            m_renderComplete.each([this](VkSemaphore s) {
+                vkDestroySemaphore(m_device->get(), s, m_device->getInstance()->getAllocator());
+            });
+            m_renderComplete.clear();
+            m_transient->shutdown();
+            m_transientDescriptors->shutdown();
             m_cmdPool->shutdown();
+            m_nextFrameIdx = 0;
         }
 
-        FrameContext* FrameManager::getFrame() {
-            if (!m_freeFrames) return nullptr;
+        void FrameManager::addTransferBatch(vulkan::TransferBatch* batch) {
+            if (!batch || m_transferBatches.some([batch](vulkan::TransferBatch* b) { return b == batch; })) return;
+            m_transferBatches.push(batch);
+        }
 
-            FrameNode* n = m_freeFrames;
-            if (n->next) n->next->last = nullptr;
-            m_freeFrames = n->next;
+        void FrameManager::removeTransferBatch(vulkan::TransferBatch* batch) {
+            i64 idx = m_transferBatches.findIndex([batch](vulkan::TransferBatch* b) { return b == batch; });
+            if (idx == -1) return;
+            m_transferBatches.remove(u32(idx));
+        }
 
-            if (m_liveFrames) m_liveFrames->last = n;
-            n->next = m_liveFrames;
-            m_liveFrames = n;
+        FrameContext* FrameManager::getFrame() {
+            // Frames are handed out round-robin so that each one waits on the fence from
+            // m_frameCount frames ago rather than the one that was just submitted
+            FrameContext* frame = m_frames[m_nextFrameIdx];
+            if (frame->m_isLive) return nullptr;
 
-            n->frame->onAcquire();
+            m_nextFrameIdx = (m_nextFrameIdx + 1) % m_frameCount;
+            frame->m_isLive = true;
+            frame->onAcquire();
 
-            return n->frame;
+            return frame;
         }
 
         void FrameManager::releaseFrame(FrameContext* frame) {
-            FrameNode* n = m_liveFrames;
-            while (n) {
-                if (n->frame == frame) break;
-                n = n->next;
-            }
-
-            if (!n) return;
-            if (n->last) n->last->next = n->next;
-            if (n->next) n->next-> last = n->last;
-
-            if (m_freeFrames) m_freeFrames->last = n;
-            n->next = m_freeFrames;
-            m_freeFrames = n;
+            if (!frame || !frame->m_isLive || frame->m_mgr != this) return;
 
-            n->frame->onFree();
+            frame->m_isLive = false;
+            frame->onFree();
         }
     };
 };
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include <render/core/RangeAllocator.h>
+
+#include <bit>
+
+namespace render {
+    namespace core {
+        RangeAllocator::RangeAllocator(u32 capacity, u32 minSplitSize) {
+            m_capacity = capacity;
+            m_minSplitSize = minSplitSize > 0 ? minSplitSize : 1;
+            m_physHead = nullptr;
+            m_unusedNodes = nullptr;
+
+            reset();
+        }
+
+        RangeAllocator::~RangeAllocator() {
+            destroyNodes();
+
+            Range* r = m_unusedNodes;
+            while (r) {
+                Range* next = r->nextFree;
+                delete r;
+                r = next;
+            }
+
+            m_unusedNodes = nullptr;
+        }
+
+        RangeAllocator::Range* RangeAllocator::allocate(u32 size) {
+            if (size == 0 || size > m_capacity - m_usedSize) return nullptr;
+
+            Range* r = findFree(size);
+            if (!r) return nullptr;
+
+            removeFree(r);
+
+            if (r->size - size >= m_minSplitSize) {
+                Range* t = getNode();
+                t->offset = r->offset + size;
+                t->size = r->size - size;
+                t->prevPhys = r;
+                t->nextPhys = r->nextPhys;
+                if (r->nextPhys) r->nextPhys->prevPhys = t;
+                r->nextPhys = t;
+                r->size = size;
+                insertFree(t);
+            }
+
+            r->isFree = false;
+            r->userData = nullptr;
+            m_usedSize += r->size;
+            m_allocationCount++;
+
+            return r;
+        }
+
+        void RangeAllocator::free(Range* r) {
+            if (!r || r->isFree) return;
+
+            m_usedSize -= r->size;
+            m_allocationCount--;
+            r->userData = nullptr;
+
+            Range* next = r->nextPhys;
+            if (next && next->isFree) {
+                removeFree(next);
+                r->size += next->size;
+                r->nextPhys = next->nextPhys;
+                if (next->nextPhys) next->nextPhys->prevPhys = r;
+                releaseNode(next);
+            }
+
+            Range* prev = r->prevPhys;
+            if (prev && prev->isFree) {
+                removeFree(prev);
+                prev->size += r->size;
+                prev->nextPhys = r->nextPhys;
+                if (r->nextPhys) r->nextPhys->prevPhys = prev;
+                releaseNode(r);
+                r = prev;
+            }
+
+            insertFree(r);
+        }
+
+        void RangeAllocator::reset() {
+            destroyNodes();
+
+            m_usedSize = 0;
+            m_allocationCount = 0;
+            m_freeRangeCount = 0;
+            m_flBitmap = 0;
+
+            for (u32 fl = 0;fl < FL_COUNT;fl++) {
+                m_slBitmap[fl] = 0;
+                for (u32 sl = 0;sl < SL_COUNT;sl++) m_freeHeads[fl][sl] = nullptr;
+            }
+
+            if (m_capacity == 0) return;
+
+            Range* r = getNode();
+            r->offset = 0;
+            r->size = m_capacity;
+            m_physHead = r;
+            insertFree(r);
+        }
+
+        u32 RangeAllocator::getCapacity() const {
+            return m_capacity;
+        }
+
+        u32 RangeAllocator::getUsedSize() const {
+            return m_usedSize;
+        }
+
+        u32 RangeAllocator::getFreeSize() const {
+            return m_capacity - m_usedSize;
+        }
+
+        u32 RangeAllocator::getAllocationCount() const {
+            return m_allocationCount;
+        }
+
+        u32 RangeAllocator::getFreeRangeCount() const {
+            return m_freeRangeCount;
+        }
+
+        u32 RangeAllocator::getLargestFreeRange() const {
+            if (!m_flBitmap) return 0;
+
+            // every range in the highest non-empty list is at least as large as any range in the lower
+            // lists, and each list keeps its largest range at the head
+            u32 fl = 31 - u32(std::countl_zero(m_flBitmap));
+            u32 sl = 31 - u32(std::countl_zero(m_slBitmap[fl]));
+
+            return m_freeHeads[fl][sl]->size;
+        }
+
+        f32 RangeAllocator::getFragmentation() const {
+            u32 freeSize = getFreeSize();
+            if (freeSize == 0) return 0.0f;
+
+            return 1.0f - (f32(getLargestFreeRange()) / f32(freeSize));
+        }
+
+        void RangeAllocator::mapSize(u32 size, u32& fl, u32& sl) {
+            fl = 31 - u32(std::countl_zero(size));
+            if (fl < SL_BITS) sl = u32(size << (SL_BITS - fl)) ^ SL_COUNT;
+            else sl = u32(size >> (fl - SL_BITS)) ^ SL_COUNT;
+        }
+
+        RangeAllocator::Range* RangeAllocator::findFree(u32 size) {
+            // round up to the next list boundary so any range found is guaranteed to fit
+            u32 requested = size;
+            u32 fl = 31 - u32(std::countl_zero(size));
+            if (fl >= SL_BITS) {
+                u64 rounded = u64(size) + (u64(1) << (fl - SL_BITS)) - 1;
+                if (rounded > 0xFFFFFFFF) return nullptr;
+                size = u32(rounded);
+            }
+
+            u32 sl;
+            mapSize(size, fl, sl);
+
+            u32 slMap = m_slBitmap[fl] & (~u32(0) << sl);
+            if (!slMap) {
+                u32 flMap = (fl + 1 < FL_COUNT) ? (m_flBitmap & (~u32(0) << (fl + 1))) : 0;
+                if (!flMap) {
+                    // the only ranges that could fit share a list with the requested size, so that
+                    // getLargestFreeRange() >= size always means the allocation will succeed. If any
+                    // of them fits, the head does
+                    mapSize(requested, fl, sl);
+                    Range* r = m_freeHeads[fl][sl];
+                    if (r && r->size >= requested) return r;
+                    return nullptr;
+                }
+
+                fl = u32(std::countr_zero(flMap));
+                slMap = m_slBitmap[fl];
+            }
+
+            // every range in this list fits, prefer one that isn't the head so the list's largest
+            // range doesn't have to be found again when it's removed
+            sl = u32(std::countr_zero(slMap));
+            Range* r = m_freeHeads[fl][sl];
+            return r->nextFree ? r->nextFree : r;
+        }
+
+        void RangeAllocator::insertFree(Range* r) {
+            u32 fl, sl;
+            mapSize(r->size, fl, sl);
+
+            r->isFree = true;
+
+            Range* head = m_freeHeads[fl][sl];
+            if (!head || r->size >= head->size) {
+                r->prevFree = nullptr;
+                r->nextFree = head;
+                if (head) head->prevFree = r;
+                m_freeHeads[fl][sl] = r;
+            } else {
+                r->prevFree = head;
+                r->nextFree = head->nextFree;
+                if (head->nextFree) head->nextFree->prevFree = r;
+                head->nextFree = r;
+            }
+
+            m_flBitmap |= u32(1) << fl;
+            m_slBitmap[fl] |= u32(1) << sl;
+            m_freeRangeCount++;
+        }
+
+        void RangeAllocator::removeFree(Range* r) {
+            u32 fl, sl;
+            mapSize(r->size, fl, sl);
+
+            bool wasHead = !r->prevFree;
+            if (r->prevFree) r->prevFree->nextFree = r->nextFree;
+            else m_freeHeads[fl][sl] = r->nextFree;
+            if (r->nextFree) r->nextFree->prevFree = r->prevFree;
+
+            r->isFree = false;
+            r->prevFree = r->nextFree = nullptr;
+            m_freeRangeCount--;
+
+            Range* head = m_freeHeads[fl][sl];
+            if (wasHead && head && head->nextFree) {
+                // the largest range was removed, move the next largest to the head
+                Range* largest = head;
+                for (Range* n = head->nextFree;n;n = n->nextFree) {
+                    if (n->size > largest->size) largest = n;
+                }
+
+                if (largest != head) {
+                    largest->prevFree->nextFree = largest->nextFree;
+                    if (largest->nextFree) largest->nextFree->prevFree = largest->prevFree;
+
+                    largest->prevFree = nullptr;
+                    largest->nextFree = head;
+                    head->prevFree = largest;
+                    m_freeHeads[fl][sl] = largest;
+                }
+            }
+
+            if (!m_freeHeads[fl][sl]) {
+                m_slBitmap[fl] &= ~(u32(1) << sl);
+                if (!m_slBitmap[fl]) m_flBitmap &= ~(u32(1) << fl);
+            }
+        }
+
+        RangeAllocator::Range* RangeAllocator::getNode() {
+            Range* r = m_unusedNodes;
+            if (r) m_unusedNodes = r->nextFree;
+            else r = new Range();
+
+            r->offset = 0;
+            r->size = 0;
+            r->userData = nullptr;
+            r->isFree = false;
+            r->prevPhys = r->nextPhys = nullptr;
+            r->prevFree = r->nextFree = nullptr;
+            return r;
+        }
+
+        void RangeAllocator::releaseNode(Range* r) {
+            r->prevPhys = r->nextPhys = nullptr;
+            r->prevFree = nullptr;
+            r->nextFree = m_unusedNodes;
+            m_unusedNodes = r;
+        }
+
+        void RangeAllocator::destroyNodes() {
+            // nodes are recycled rather than deleted so that reset() doesn't have to reallocate them
+            Range* r = m_physHead;
+            while (r) {
+                Range* next = r->nextPhys;
+                releaseNode(r);
+                r = next;
+            }
+
+            m_physHead = nullptr;
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <render/core/TransientAllocator.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Buffer.h>
+
+#include <utils/Array.hpp>
+
+namespace render {
+    namespace core {
+        TransientAllocator::TransientAllocator(vulkan::LogicalDevice* device, u32 frameCount, u64 bytesPerFrame) : utils::IWithLogging("Transient Allocator") {
+            m_device = device;
+            m_buffer = nullptr;
+            m_mappedMemory = nullptr;
+            m_frameCount = frameCount;
+            m_bytesPerFrame = bytesPerFrame;
+            m_minAlignment = 16;
+        }
+
+        TransientAllocator::~TransientAllocator() {
+            shutdown();
+        }
+
+        bool TransientAllocator::init() {
+            if (m_buffer || m_frameCount == 0 || m_bytesPerFrame == 0) return false;
+
+            // Anything allocated from here may end up bound as a uniform, storage, vertex or index buffer
+            const VkPhysicalDeviceLimits& limits = m_device->getPhysicalDevice()->getProperties().limits;
+            if (limits.minUniformBufferOffsetAlignment > m_minAlignment) m_minAlignment = limits.minUniformBufferOffsetAlignment;
+            if (limits.minStorageBufferOffsetAlignment > m_minAlignment) m_minAlignment = limits.minStorageBufferOffsetAlignment;
+
+            u64 remainder = m_bytesPerFrame % m_minAlignment;
+            if (remainder > 0) m_bytesPerFrame += m_minAlignment - remainder;
+
+            m_buffer = new vulkan::Buffer(m_device);
+            if (!m_buffer->init(
+                m_bytesPerFrame * m_frameCount,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            )) {
+                error("Failed to create %llu byte transient buffer", m_bytesPerFrame * m_frameCount);
+                shutdown();
+                return false;
+            }
+
+            if (!m_buffer->map()) {
+                error("Failed to map transient buffer");
+                shutdown();
+                return false;
+            }
+
+            m_mappedMemory = (u8*)m_buffer->getPointer();
+            m_heads.reserve(m_frameCount);
+            for (u32 i = 0;i < m_frameCount;i++) m_heads.push(0);
+
+            return true;
+        }
+
+        void TransientAllocator::shutdown() {
+            if (m_buffer) {
+                delete m_buffer;
+                m_buffer = nullptr;
+            }
+
+            m_mappedMemory = nullptr;
+            m_heads.clear();
+        }
+
+        vulkan::Buffer* TransientAllocator::getBuffer() const {
+            return m_buffer;
+        }
+
+        u32 TransientAllocator::getFrameCount() const {
+            return m_frameCount;
+        }
+
+        u64 TransientAllocator::getBytesPerFrame() const {
+            return m_bytesPerFrame;
+        }
+
+        u64 TransientAllocator::getUsedSize(u32 frameIdx) const {
+            if (frameIdx >= m_heads.size()) return 0;
+            return m_heads[frameIdx];
+        }
+
+        void TransientAllocator::reset(u32 frameIdx) {
+            if (frameIdx >= m_heads.size()) return;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_heads[frameIdx] = 0;
+        }
+
+        bool TransientAllocator::alloc(u32 frameIdx, u64 size, u64 alignment, TransientAllocation& out) {
+            out = {};
+            if (!m_mappedMemory || frameIdx >= m_heads.size() || size == 0) return false;
+
+            if (alignment < m_minAlignment) alignment = m_minAlignment;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            u64 begin = (m_heads[frameIdx] + (alignment - 1)) & ~(alignment - 1);
+            if (begin + size > m_bytesPerFrame) {
+                warn("Frame %d is out of transient memory (%llu / %llu bytes used, %llu requested)", frameIdx, m_heads[frameIdx], m_bytesPerFrame, size);
+                return false;
+            }
+
+            m_heads[frameIdx] = begin + size;
+
+            out.offset = (u64(frameIdx) * m_bytesPerFrame) + begin;
+            out.size = size;
+            out.buffer = m_buffer;
+            out.data = m_mappedMemory + out.offset;
+
+            return true;
+        }
+    };
+};
\ No newline at end of file
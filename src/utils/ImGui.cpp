@@ -2,6 +2,7 @@
 #include <render/vulkan/LogicalDevice.h>
 #include <render/vulkan/PhysicalDevice.h>
 #include <render/vulkan/Instance.h>
+#include <render/vulkan/PipelineCache.h>
 #include <render/vulkan/Queue.h>
 #include <render/vulkan/QueueFamily.h>
 #include <render/vulkan/RenderPass.h>
@@ -195,6 +196,7 @@ namespace render {
             ii.Queue = m_gfxQueue->get();
             ii.QueueFamily = m_gfxQueue->getFamily().getIndex();
             ii.DescriptorPool = m_descriptorPool;
+            ii.PipelineCache = m_device->getPipelineCache() ? m_device->getPipelineCache()->get() : VK_NULL_HANDLE;
             ii.ImageCount = m_swapChain->getImageViews().size();
             ii.MinImageCount = ii.ImageCount;
             ii.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
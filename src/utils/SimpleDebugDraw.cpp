@@ -22,7 +22,7 @@ namespace render {
 
             m_vfmt.addAttr(&vertex::position);
             m_vfmt.addAttr(&vertex::color);
-            m_ufmt.addAttr(&uniforms::viewProj);
+            uniforms::UniformLayout::Describe(m_ufmt);
         }
 
         SimpleDebugDraw::~SimpleDebugDraw() {
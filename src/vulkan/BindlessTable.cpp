@@ -0,0 +1,313 @@
+#include <render/vulkan/BindlessTable.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Instance.h>
+#include <render/vulkan/Texture.h>
+#include <render/vulkan/Buffer.h>
+#include <render/vulkan/StorageBuffer.h>
+
+#include <utils/Array.hpp>
+
+namespace render {
+    namespace vulkan {
+        const char* BindlessTable::ShaderHeader =
+            "#extension GL_EXT_nonuniform_qualifier : require\n"
+            "layout (set = 0, binding = 0) uniform sampler2D _bindlessTextures[];\n"
+            "#define bindlessTexture(idx) _bindlessTextures[nonuniformEXT(idx)]\n"
+            "#define BINDLESS_BUFFER(Type, name) layout (std430, set = 0, binding = 1) buffer name##_block { Type data[]; } name[]\n";
+
+        BindlessTable::BindlessTable(LogicalDevice* device, u32 maxTextures, u32 maxBuffers, u32 framesInFlight) {
+            m_device = device;
+            m_maxTextures = maxTextures;
+            m_maxBuffers = maxBuffers;
+            m_framesInFlight = framesInFlight;
+            m_pool = VK_NULL_HANDLE;
+            m_layout = VK_NULL_HANDLE;
+            m_set = VK_NULL_HANDLE;
+            m_nextTexture = 0;
+            m_nextBuffer = 0;
+            m_textureCount = 0;
+            m_bufferCount = 0;
+        }
+
+        BindlessTable::~BindlessTable() {
+            shutdown();
+        }
+
+        bool BindlessTable::init() {
+            if (m_pool) return false;
+
+            if (!m_device->isBindlessEnabled()) {
+                m_device->getInstance()->error("BindlessTable requires LogicalDevice::enableBindless to be called before the device is initialized");
+                return false;
+            }
+
+            const VkPhysicalDeviceDescriptorIndexingProperties& limits = m_device->getPhysicalDevice()->getDescriptorIndexingProperties();
+            if (m_maxTextures > limits.maxDescriptorSetUpdateAfterBindSampledImages) m_maxTextures = limits.maxDescriptorSetUpdateAfterBindSampledImages;
+            if (m_maxBuffers > limits.maxDescriptorSetUpdateAfterBindStorageBuffers) m_maxBuffers = limits.maxDescriptorSetUpdateAfterBindStorageBuffers;
+            if (m_maxTextures == 0 || m_maxBuffers == 0) return false;
+
+            VkDescriptorPoolSize ps[] = {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_maxTextures },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_maxBuffers }
+            };
+
+            VkDescriptorPoolCreateInfo pi = {};
+            pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pi.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+            pi.poolSizeCount = sizeof(ps) / sizeof(VkDescriptorPoolSize);
+            pi.pPoolSizes = ps;
+            pi.maxSets = 1;
+
+            if (vkCreateDescriptorPool(m_device->get(), &pi, m_device->getInstance()->getAllocator(), &m_pool) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to create bindless descriptor pool");
+                shutdown();
+                return false;
+            }
+
+            VkDescriptorSetLayoutBinding bindings[2] = {};
+            bindings[0].binding = TextureBinding;
+            bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[0].descriptorCount = m_maxTextures;
+            bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+            bindings[1].binding = BufferBinding;
+            bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[1].descriptorCount = m_maxBuffers;
+            bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+            // Slots that were never written (or were removed) are fine as long as shaders don't read them,
+            // and slots can be written while frames that don't use them are still executing
+            VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                                           | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                                           | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+            VkDescriptorBindingFlags bindingFlags[2] = { flags, flags };
+
+            VkDescriptorSetLayoutBindingFlagsCreateInfo bfi = {};
+            bfi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bfi.bindingCount = 2;
+            bfi.pBindingFlags = bindingFlags;
+
+            VkDescriptorSetLayoutCreateInfo dsl = {};
+            dsl.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            dsl.pNext = &bfi;
+            dsl.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+            dsl.bindingCount = 2;
+            dsl.pBindings = bindings;
+
+            if (vkCreateDescriptorSetLayout(m_device->get(), &dsl, m_device->getInstance()->getAllocator(), &m_layout) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to create bindless descriptor set layout");
+                shutdown();
+                return false;
+            }
+
+            VkDescriptorSetAllocateInfo ai = {};
+            ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            ai.descriptorPool = m_pool;
+            ai.descriptorSetCount = 1;
+            ai.pSetLayouts = &m_layout;
+
+            if (vkAllocateDescriptorSets(m_device->get(), &ai, &m_set) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to allocate bindless descriptor set");
+                shutdown();
+                return false;
+            }
+
+            return true;
+        }
+
+        void BindlessTable::shutdown() {
+            if (m_pool) {
+                vkDestroyDescriptorPool(m_device->get(), m_pool, m_device->getInstance()->getAllocator());
+                m_pool = VK_NULL_HANDLE;
+            }
+
+            if (m_layout) {
+                vkDestroyDescriptorSetLayout(m_device->get(), m_layout, m_device->getInstance()->getAllocator());
+                m_layout = VK_NULL_HANDLE;
+            }
+
+            for (u32 i = 0;i < m_textures.size();i++) {
+                if (!m_textures[i]) continue;
+                m_textures[i]->m_bindlessTable = nullptr;
+                m_textures[i]->m_bindlessIndex = InvalidIndex;
+            }
+
+            m_set = VK_NULL_HANDLE;
+            m_textures.clear();
+            m_liveBuffers.clear();
+            m_freeTextures.clear();
+            m_freeBuffers.clear();
+            m_retired.clear();
+            m_nextTexture = 0;
+            m_nextBuffer = 0;
+            m_textureCount = 0;
+            m_bufferCount = 0;
+        }
+
+        LogicalDevice* BindlessTable::getDevice() const {
+            return m_device;
+        }
+
+        VkDescriptorSet BindlessTable::get() const {
+            return m_set;
+        }
+
+        VkDescriptorSetLayout BindlessTable::getLayout() const {
+            return m_layout;
+        }
+
+        u32 BindlessTable::getTextureCapacity() const {
+            return m_maxTextures;
+        }
+
+        u32 BindlessTable::getBufferCapacity() const {
+            return m_maxBuffers;
+        }
+
+        u32 BindlessTable::getTextureCount() const {
+            return m_textureCount;
+        }
+
+        u32 BindlessTable::getBufferCount() const {
+            return m_bufferCount;
+        }
+
+        u32 BindlessTable::add(Texture* tex) {
+            if (!m_set || !tex) return InvalidIndex;
+            if (tex->m_bindlessTable == this) return tex->m_bindlessIndex;
+
+            if (tex->m_bindlessTable) {
+                m_device->getInstance()->error("Texture already belongs to a different bindless table");
+                return InvalidIndex;
+            }
+
+            u32 idx = allocIndex(m_freeTextures, m_nextTexture, m_maxTextures);
+            if (idx == InvalidIndex) {
+                m_device->getInstance()->error("Bindless table is out of texture slots (%u)", m_maxTextures);
+                return InvalidIndex;
+            }
+
+            VkDescriptorImageInfo ii = {};
+            ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            ii.imageView = tex->getView();
+            ii.sampler = tex->getSampler();
+
+            VkWriteDescriptorSet wd = {};
+            wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            wd.dstSet = m_set;
+            wd.dstBinding = TextureBinding;
+            wd.dstArrayElement = idx;
+            wd.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            wd.descriptorCount = 1;
+            wd.pImageInfo = &ii;
+
+            vkUpdateDescriptorSets(m_device->get(), 1, &wd, 0, nullptr);
+
+            tex->m_bindlessTable = this;
+            tex->m_bindlessIndex = idx;
+            m_textureCount++;
+
+            if (idx == m_textures.size()) m_textures.push(tex);
+            else m_textures[idx] = tex;
+
+            return idx;
+        }
+
+        void BindlessTable::remove(Texture* tex) {
+            if (!tex || tex->m_bindlessTable != this) return;
+
+            retire(tex->m_bindlessIndex, true);
+            m_textures[tex->m_bindlessIndex] = nullptr;
+            tex->m_bindlessTable = nullptr;
+            tex->m_bindlessIndex = InvalidIndex;
+            m_textureCount--;
+        }
+
+        u32 BindlessTable::add(Buffer* buffer) {
+            if (!buffer) return InvalidIndex;
+            return addBuffer(buffer->get(), 0, VK_WHOLE_SIZE);
+        }
+
+        u32 BindlessTable::add(StorageArray* array) {
+            if (!array) return InvalidIndex;
+            return addBuffer(array->getBuffer()->getBuffer(), array->getByteOffset(), array->getSize());
+        }
+
+        void BindlessTable::removeBuffer(u32 index) {
+            if (index >= m_liveBuffers.size() || !m_liveBuffers[index]) {
+                m_device->getInstance()->error("Attempted to remove bindless buffer index %u which is not in use", index);
+                return;
+            }
+
+            m_liveBuffers[index] = false;
+            retire(index, false);
+            m_bufferCount--;
+        }
+
+        void BindlessTable::advanceFrame() {
+            for (u32 i = 0;i < m_retired.size();) {
+                retired_index& r = m_retired[i];
+                if (r.framesRemaining > 0) {
+                    r.framesRemaining--;
+                    i++;
+                    continue;
+                }
+
+                if (r.isTexture) m_freeTextures.push(r.index);
+                else m_freeBuffers.push(r.index);
+
+                m_retired.remove(i);
+            }
+        }
+
+        u32 BindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+            if (!m_set) return InvalidIndex;
+
+            u32 idx = allocIndex(m_freeBuffers, m_nextBuffer, m_maxBuffers);
+            if (idx == InvalidIndex) {
+                m_device->getInstance()->error("Bindless table is out of storage buffer slots (%u)", m_maxBuffers);
+                return InvalidIndex;
+            }
+
+            VkDescriptorBufferInfo bi = {};
+            bi.buffer = buffer;
+            bi.offset = offset;
+            bi.range = range;
+
+            VkWriteDescriptorSet wd = {};
+            wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            wd.dstSet = m_set;
+            wd.dstBinding = BufferBinding;
+            wd.dstArrayElement = idx;
+            wd.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            wd.descriptorCount = 1;
+            wd.pBufferInfo = &bi;
+
+            vkUpdateDescriptorSets(m_device->get(), 1, &wd, 0, nullptr);
+
+            m_bufferCount++;
+
+            if (idx == m_liveBuffers.size()) m_liveBuffers.push(true);
+            else m_liveBuffers[idx] = true;
+
+            return idx;
+        }
+
+        u32 BindlessTable::allocIndex(Array<u32>& freeList, u32& next, u32 capacity) {
+            if (freeList.size() > 0) {
+                u32 idx = freeList.last();
+                freeList.remove(freeList.size() - 1);
+                return idx;
+            }
+
+            if (next == capacity) return InvalidIndex;
+            return next++;
+        }
+
+        void BindlessTable::retire(u32 index, bool isTexture) {
+            // frames that were recorded before the removal may still read the slot
+            m_retired.push({ index, m_framesInFlight, isTexture });
+        }
+    };
+};
\ No newline at end of file
@@ -9,7 +9,7 @@ namespace render {
             m_device = device;
             m_size = 0;
             m_buffer = VK_NULL_HANDLE;
-            m_memory = VK_NULL_HANDLE;
+            m_memory = {};
             m_usage = VK_BUFFER_USAGE_FLAG_BITS_MAX_ENUM;
             m_sharingMode = VK_SHARING_MODE_MAX_ENUM;
             m_memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
@@ -29,7 +29,11 @@ namespace render {
         }
         
         VkDeviceMemory Buffer::getMemory() const {
-            return m_memory;
+            return m_memory.memory;
+        }
+
+        u64 Buffer::getMemoryOffset() const {
+            return m_memory.offset;
         }
         
         VkBufferUsageFlags Buffer::getUsage() const {
@@ -46,25 +50,32 @@ namespace render {
         
         bool Buffer::getRange(u64 offset, u64 size, VkMappedMemoryRange& range) const {
             range = {};
+            if (!m_memory.block) return false;
             if (size == VK_WHOLE_SIZE && offset != 0) return false;
             if (size != VK_WHOLE_SIZE && offset + size > m_size) return false;
 
-            if (size == VK_WHOLE_SIZE) offset = 0;
-            else {
-                u32 nonCoherentAtomSize = m_device->getPhysicalDevice()->getProperties().limits.nonCoherentAtomSize;
-                if (nonCoherentAtomSize > 0) {
-                    u64 remainder = (size % nonCoherentAtomSize);
-                    if (remainder > 0) size += (nonCoherentAtomSize - remainder);
-                }
+            // The buffer shares its memory with others, so ranges are relative to the allocation and
+            // never cover the whole memory object
+            u64 begin = m_memory.offset;
+            u64 end = m_memory.offset + m_size;
+            if (size != VK_WHOLE_SIZE) {
+                begin += offset;
+                end = begin + size;
+            }
 
-                if (offset + size > m_size) return false;
+            u64 nonCoherentAtomSize = m_device->getPhysicalDevice()->getProperties().limits.nonCoherentAtomSize;
+            if (nonCoherentAtomSize > 1) {
+                begin -= begin % nonCoherentAtomSize;
+                u64 remainder = end % nonCoherentAtomSize;
+                if (remainder > 0) end += (nonCoherentAtomSize - remainder);
+                if (end > m_memory.block->getSize()) end = m_memory.block->getSize();
             }
 
             range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
             range.pNext = VK_NULL_HANDLE;
-            range.memory = m_memory;
-            range.offset = offset;
-            range.size = size;
+            range.memory = m_memory.memory;
+            range.offset = begin;
+            range.size = end - begin;
 
             return true;
         }
@@ -74,12 +85,13 @@ namespace render {
         }
         
         bool Buffer::isValid() const {
-            return m_buffer != VK_NULL_HANDLE && m_memory != VK_NULL_HANDLE;
+            return m_buffer != VK_NULL_HANDLE && m_memory.memory != VK_NULL_HANDLE;
         }
         
         bool Buffer::map() {
             if (m_mappedMemory) return false;
-            return vkMapMemory(m_device->get(), m_memory, 0, VK_WHOLE_SIZE, 0, &m_mappedMemory) == VK_SUCCESS;
+            m_mappedMemory = m_device->getMemoryAllocator()->map(m_memory);
+            return m_mappedMemory != nullptr;
         }
         
         bool Buffer::flush(u64 offset, u64 size) {
@@ -132,8 +144,7 @@ namespace render {
         }
 
         void Buffer::unmap() {
-            if (!m_mappedMemory) return;
-            vkUnmapMemory(m_device->get(), m_memory);
+            // memory blocks stay mapped for their whole lifetime since they're shared between buffers
             m_mappedMemory = nullptr;
         }
 
@@ -158,23 +169,13 @@ namespace render {
             VkMemoryRequirements memReqs;
             vkGetBufferMemoryRequirements(m_device->get(), m_buffer, &memReqs);
 
-            VkMemoryAllocateInfo ai = {};
-            ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            ai.allocationSize = memReqs.size;
-
-            if (!m_device->getPhysicalDevice()->getMemoryTypeIndex(memReqs, m_memoryFlags, &ai.memoryTypeIndex)) {
-                m_device->getInstance()->error("Failed to find correct memory type for buffer");
+            if (!m_device->getMemoryAllocator()->allocate(memReqs, m_memoryFlags, true, m_memory)) {
+                m_device->getInstance()->error("Failed to allocate %llu bytes for buffer", memReqs.size);
                 shutdown();
                 return false;
             }
 
-            if (vkAllocateMemory(m_device->get(), &ai, m_device->getInstance()->getAllocator(), &m_memory) != VK_SUCCESS) {
-                m_device->getInstance()->error("Failed to allocate %llu bytes for buffer", ai.allocationSize);
-                shutdown();
-                return false;
-            }
-
-            if (vkBindBufferMemory(m_device->get(), m_buffer, m_memory, 0) != VK_SUCCESS) {
+            if (vkBindBufferMemory(m_device->get(), m_buffer, m_memory.memory, m_memory.offset) != VK_SUCCESS) {
                 m_device->getInstance()->error("Failed to bind allocated memory to buffer");
                 shutdown();
                 return false;
@@ -189,10 +190,7 @@ namespace render {
                 m_buffer = VK_NULL_HANDLE;
             }
 
-            if (m_memory) {
-                vkFreeMemory(m_device->get(), m_memory, m_device->getInstance()->getAllocator());
-                m_memory = VK_NULL_HANDLE;
-            }
+            if (m_memory.block) m_device->getMemoryAllocator()->free(m_memory);
             
             m_size = 0;
             m_usage = VK_BUFFER_USAGE_FLAG_BITS_MAX_ENUM;
@@ -1,6 +1,7 @@
 #include <render/vulkan/CommandBuffer.h>
 #include <render/vulkan/CommandPool.h>
 #include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
 #include <render/vulkan/Instance.h>
 #include <render/vulkan/QueueFamily.h>
 #include <render/vulkan/Pipeline.h>
@@ -8,18 +9,26 @@
 #include <render/vulkan/SwapChain.h>
 #include <render/vulkan/RenderPass.h>
 #include <render/vulkan/VertexBuffer.h>
+#include <render/vulkan/IndexBuffer.h>
 #include <render/vulkan/DescriptorSet.h>
+#include <render/vulkan/BindlessTable.h>
+#include <render/vulkan/UniformBuffer.h>
 #include <render/vulkan/Framebuffer.h>
 
 #include <utils/Array.hpp>
 
+#include <string.h>
+
 namespace render {
     namespace vulkan {
         CommandBuffer::CommandBuffer() {
             m_pool = nullptr;
             m_buffer = VK_NULL_HANDLE;
+            m_isPrimary = true;
             m_isRecording = false;
             m_boundPipeline = nullptr;
+            m_stats = {};
+            invalidateState();
         }
 
         CommandBuffer::~CommandBuffer() {
@@ -36,13 +45,43 @@ namespace render {
         bool CommandBuffer::begin(VkCommandBufferUsageFlagBits flags) {
             if (!m_buffer || m_isRecording) return false;
             m_boundPipeline = nullptr;
+            m_stats = {};
+            invalidateState();
+
+            // secondary buffers always need inheritance info, even outside of a render pass
+            VkCommandBufferInheritanceInfo ii = {};
+            ii.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
 
             VkCommandBufferBeginInfo bi = {};
             bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
             bi.flags = flags;
+            bi.pInheritanceInfo = m_isPrimary ? VK_NULL_HANDLE : &ii;
 
-            // todo
-            bi.pInheritanceInfo = VK_NULL_HANDLE;
+            VkResult result = vkBeginCommandBuffer(m_buffer, &bi);
+            if (result == VK_SUCCESS) {
+                m_isRecording = true;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool CommandBuffer::beginSecondary(RenderPass* pass, Framebuffer* target, u32 subpass, VkCommandBufferUsageFlags flags) {
+            if (!m_buffer || m_isRecording || m_isPrimary) return false;
+            m_boundPipeline = nullptr;
+            m_stats = {};
+            invalidateState();
+
+            VkCommandBufferInheritanceInfo ii = {};
+            ii.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            ii.renderPass = pass->get();
+            ii.subpass = subpass;
+            ii.framebuffer = target ? target->get() : VK_NULL_HANDLE;
+
+            VkCommandBufferBeginInfo bi = {};
+            bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            bi.flags = flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            bi.pInheritanceInfo = &ii;
 
             VkResult result = vkBeginCommandBuffer(m_buffer, &bi);
             if (result == VK_SUCCESS) {
@@ -75,7 +114,7 @@ namespace render {
             return vkResetCommandBuffer(m_buffer, 0) == VK_SUCCESS;
         }
         
-        void CommandBuffer::beginRenderPass(RenderPass* pass, SwapChain* swap, Framebuffer* target) {
+        void CommandBuffer::beginRenderPass(RenderPass* pass, SwapChain* swap, Framebuffer* target, VkSubpassContents contents) {
             if (!m_buffer || !m_isRecording) return;
 
             VkClearValue clearValues[16] = {};
@@ -94,16 +133,11 @@ namespace render {
             rpi.clearValueCount = attachments.size();
             rpi.pClearValues = clearValues;
 
-            vkCmdBeginRenderPass(
-                m_buffer,
-                &rpi,
-                // todo
-                VK_SUBPASS_CONTENTS_INLINE
-            );
+            vkCmdBeginRenderPass(m_buffer, &rpi, contents);
         }
 
-        void CommandBuffer::beginRenderPass(GraphicsPipeline* pipeline, Framebuffer* target) {
-            beginRenderPass(pipeline->getRenderPass(), pipeline->getSwapChain(), target);
+        void CommandBuffer::beginRenderPass(GraphicsPipeline* pipeline, Framebuffer* target, VkSubpassContents contents) {
+            beginRenderPass(pipeline->getRenderPass(), pipeline->getSwapChain(), target, contents);
         }
 
         void CommandBuffer::endRenderPass() {
@@ -111,32 +145,166 @@ namespace render {
 
             vkCmdEndRenderPass(m_buffer);
         }
+
+        void CommandBuffer::executeCommands(CommandBuffer* secondary) {
+            if (!secondary) return;
+
+            VkCommandBuffer cb = secondary->get();
+            executeCommands(1, &cb);
+        }
+
+        void CommandBuffer::executeCommands(u32 count, const VkCommandBuffer* secondaries) {
+            if (!m_buffer || !m_isRecording || !m_isPrimary || count == 0) return;
+
+            vkCmdExecuteCommands(m_buffer, count, secondaries);
+
+            // state is undefined after executing secondaries
+            invalidateState();
+        }
         
         void CommandBuffer::bindPipeline(Pipeline* pipeline, VkPipelineBindPoint bindPoint) {
             if (!m_buffer || !m_isRecording) return;
-
-            vkCmdBindPipeline(m_buffer, bindPoint, pipeline->get());
             m_boundPipeline = pipeline;
+
+            bind_point_state* state = getBindPointState(bindPoint);
+            VkPipeline handle = pipeline->get();
+            if (state && state->handle == handle) {
+                m_stats.pipelineBindsElided++;
+                return;
+            }
+
+            vkCmdBindPipeline(m_buffer, bindPoint, handle);
+            m_stats.pipelineBinds++;
+
+            if (!state) return;
+            state->pipeline = pipeline;
+            state->handle = handle;
+
+            // Pipelines don't share layouts, so any sets bound for another layout have to be bound again
+            if (state->layout != pipeline->getLayout()) {
+                for (u32 i = 0;i < MaxTrackedSets;i++) state->sets[i].set = VK_NULL_HANDLE;
+                state->layout = pipeline->getLayout();
+            }
+
+            if (bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+                // pipelines with static viewport or scissor overwrite them
+                GraphicsPipeline* gp = (GraphicsPipeline*)pipeline;
+                if (!gp->isStateDynamic(VK_DYNAMIC_STATE_VIEWPORT)) m_viewportValid = false;
+                if (!gp->isStateDynamic(VK_DYNAMIC_STATE_SCISSOR)) m_scissorValid = false;
+            }
         }
         
-        void CommandBuffer::bindDescriptorSet(DescriptorSet* set, VkPipelineBindPoint bindPoint) {
+        void CommandBuffer::bindDescriptorSet(DescriptorSet* set, VkPipelineBindPoint bindPoint, u32 dynamicOffsetCount, const u32* dynamicOffsets) {
             if (!m_buffer || !m_isRecording) return;
-            VkDescriptorSet s = set->get();
-            vkCmdBindDescriptorSets(m_buffer, bindPoint, m_boundPipeline->getLayout(), 0, 1, &s, 0, nullptr);
+            recordDescriptorSet(
+                bindPoint,
+                m_boundPipeline->getLayout(),
+                m_boundPipeline->getDescriptorSetIndex(),
+                set->get(),
+                dynamicOffsetCount,
+                dynamicOffsets
+            );
+        }
+
+        void CommandBuffer::bindDescriptorSet(DescriptorSet* set, VkPipelineBindPoint bindPoint, UniformObject* dynamicUniform) {
+            u32 offset = dynamicUniform->getDynamicOffset();
+            bindDescriptorSet(set, bindPoint, 1, &offset);
+        }
+
+        void CommandBuffer::bindBindlessTable(BindlessTable* table, VkPipelineBindPoint bindPoint) {
+            if (!m_buffer || !m_isRecording || !m_boundPipeline) return;
+            if (m_boundPipeline->getBindlessTable() != table) return;
+
+            recordDescriptorSet(bindPoint, m_boundPipeline->getLayout(), 0, table->get(), 0, nullptr);
         }
         
+        void CommandBuffer::pushConstants(u32 rangeIndex, const void* data, u32 size) {
+            if (!m_buffer || !m_isRecording || !m_boundPipeline) return;
+
+            const auto& ranges = m_boundPipeline->getPushConstantRanges();
+            if (rangeIndex >= ranges.size()) {
+                m_device->getInstance()->error("Push constant range %u does not exist on the bound pipeline", rangeIndex);
+                return;
+            }
+
+            const VkPushConstantRange& range = ranges[rangeIndex];
+            if (size == 0 || (size & 3) != 0 || size > range.size) {
+                m_device->getInstance()->error(
+                    "Push constant size %u is invalid for range %u, it must be a non-zero multiple of 4 no larger than %u",
+                    size,
+                    rangeIndex,
+                    range.size
+                );
+                return;
+            }
+
+            vkCmdPushConstants(m_buffer, m_boundPipeline->getLayout(), range.stageFlags, range.offset, size, data);
+        }
+
         void CommandBuffer::bindVertexBuffer(VertexBuffer* vbo) {
             if (!m_buffer || !m_isRecording) return;
-            VkDeviceSize offset = 0;
-            VkBuffer buf = vbo->getBuffer();
-            vkCmdBindVertexBuffers(m_buffer, 0, 1, &buf, &offset);
+            recordVertexBuffer(0, vbo->getBuffer(), 0);
         }
         
-        void CommandBuffer::bindVertexBuffer(Buffer* vbo) {
+        void CommandBuffer::bindVertexBuffer(Buffer* vbo, u64 offset) {
+            if (!m_buffer || !m_isRecording) return;
+            recordVertexBuffer(0, vbo->get(), offset);
+        }
+
+        void CommandBuffer::bindVertexBuffer(u32 binding, Buffer* vbo, u64 offset) {
+            if (!m_buffer || !m_isRecording) return;
+            recordVertexBuffer(binding, vbo->get(), offset);
+        }
+
+        void CommandBuffer::bindVertexBuffers(u32 firstBinding, u32 count, const VkBuffer* buffers, const VkDeviceSize* offsets) {
+            if (!m_buffer || !m_isRecording || count == 0) return;
+
+            if (!offsets) {
+                VkDeviceSize zeros[MaxVertexBindings] = {};
+                for (u32 i = 0;i < count;i += MaxVertexBindings) {
+                    u32 n = count - i < MaxVertexBindings ? count - i : MaxVertexBindings;
+                    bindVertexBuffers(firstBinding + i, n, buffers + i, zeros);
+                }
+                return;
+            }
+
+            // only the span of bindings that actually change is recorded
+            u32 first = count;
+            u32 last = 0;
+            for (u32 i = 0;i < count;i++) {
+                u32 b = firstBinding + i;
+                if (b < MaxVertexBindings && m_vertexBuffers[b] == buffers[i] && m_vertexOffsets[b] == offsets[i]) continue;
+
+                if (first == count) first = i;
+                last = i;
+            }
+
+            if (first == count) {
+                m_stats.vertexBufferBindsElided++;
+                return;
+            }
+
+            u32 spanCount = (last - first) + 1;
+            vkCmdBindVertexBuffers(m_buffer, firstBinding + first, spanCount, buffers + first, offsets + first);
+            m_stats.vertexBufferBinds++;
+
+            for (u32 i = first;i <= last;i++) {
+                u32 b = firstBinding + i;
+                if (b >= MaxVertexBindings) break;
+
+                m_vertexBuffers[b] = buffers[i];
+                m_vertexOffsets[b] = offsets[i];
+            }
+        }
+
+        void CommandBuffer::bindIndexBuffer(IndexBuffer* ibo) {
             if (!m_buffer || !m_isRecording) return;
-            VkDeviceSize offset = 0;
-            VkBuffer buf = vbo->get();
-            vkCmdBindVertexBuffers(m_buffer, 0, 1, &buf, &offset);
+            recordIndexBuffer(ibo->getBuffer(), 0, ibo->getType());
+        }
+
+        void CommandBuffer::bindIndexBuffer(Buffer* ibo, VkIndexType type, u64 offset) {
+            if (!m_buffer || !m_isRecording) return;
+            recordIndexBuffer(ibo->get(), offset, type);
         }
 
         void CommandBuffer::setViewport(f32 x, f32 y, f32 width, f32 height, f32 minZ, f32 maxZ) {
@@ -150,7 +318,15 @@ namespace render {
             vp.minDepth = minZ;
             vp.maxDepth = maxZ;
 
+            if (m_viewportValid && memcmp(&vp, &m_viewport, sizeof(VkViewport)) == 0) {
+                m_stats.dynamicStateSetsElided++;
+                return;
+            }
+
             vkCmdSetViewport(m_buffer, 0, 1, &vp);
+            m_stats.dynamicStateSets++;
+            m_viewport = vp;
+            m_viewportValid = true;
         }
 
         void CommandBuffer::setScissor(i32 x, i32 y, u32 width, u32 height) {
@@ -161,7 +337,15 @@ namespace render {
             s.extent.width = width;
             s.extent.height = height;
 
+            if (m_scissorValid && memcmp(&s, &m_scissor, sizeof(VkRect2D)) == 0) {
+                m_stats.dynamicStateSetsElided++;
+                return;
+            }
+
             vkCmdSetScissor(m_buffer, 0, 1, &s);
+            m_stats.dynamicStateSets++;
+            m_scissor = s;
+            m_scissorValid = true;
         }
         
         void CommandBuffer::draw(u32 vertexCount, u32 firstVertex, u32 instanceCount, u32 firstInstance) {
@@ -173,5 +357,155 @@ namespace render {
             if (!m_buffer || !m_isRecording) return;
             vkCmdDraw(m_buffer, vertices->getCount(), 1, vertices->getOffset(), 0);
         }
+
+        void CommandBuffer::drawIndexed(Indices* indices, Vertices* vertices, u32 instanceCount, u32 firstInstance) {
+            if (!m_buffer || !m_isRecording) return;
+            i32 vertexOffset = vertices ? i32(vertices->getOffset()) : 0;
+            vkCmdDrawIndexed(m_buffer, indices->getCount(), instanceCount, indices->getOffset(), vertexOffset, firstInstance);
+        }
+
+        void CommandBuffer::drawIndexed(u32 indexCount, u32 firstIndex, i32 vertexOffset, u32 instanceCount, u32 firstInstance) {
+            if (!m_buffer || !m_isRecording) return;
+            vkCmdDrawIndexed(m_buffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+        }
+
+        void CommandBuffer::drawIndirect(Buffer* args, u64 offset, u32 drawCount, u32 stride) {
+            if (!m_buffer || !m_isRecording || drawCount == 0) return;
+
+            if (drawCount == 1 || m_device->getPhysicalDevice()->getFeatures().multiDrawIndirect) {
+                vkCmdDrawIndirect(m_buffer, args->get(), offset, drawCount, stride);
+                return;
+            }
+
+            for (u32 i = 0;i < drawCount;i++) {
+                vkCmdDrawIndirect(m_buffer, args->get(), offset + u64(i) * stride, 1, stride);
+            }
+        }
+
+        void CommandBuffer::drawIndexedIndirect(Buffer* args, u64 offset, u32 drawCount, u32 stride) {
+            if (!m_buffer || !m_isRecording || drawCount == 0) return;
+
+            if (drawCount == 1 || m_device->getPhysicalDevice()->getFeatures().multiDrawIndirect) {
+                vkCmdDrawIndexedIndirect(m_buffer, args->get(), offset, drawCount, stride);
+                return;
+            }
+
+            for (u32 i = 0;i < drawCount;i++) {
+                vkCmdDrawIndexedIndirect(m_buffer, args->get(), offset + u64(i) * stride, 1, stride);
+            }
+        }
+
+        void CommandBuffer::drawIndirectCount(Buffer* args, u64 offset, Buffer* countBuffer, u64 countOffset, u32 maxDrawCount, u32 stride) {
+            if (!m_buffer || !m_isRecording || maxDrawCount == 0) return;
+
+            if (!m_device->isDrawIndirectCountEnabled()) {
+                m_device->getInstance()->error("CommandBuffer::drawIndirectCount called without LogicalDevice::enableDrawIndirectCount");
+                return;
+            }
+
+            vkCmdDrawIndirectCount(m_buffer, args->get(), offset, countBuffer->get(), countOffset, maxDrawCount, stride);
+        }
+
+        void CommandBuffer::drawIndexedIndirectCount(Buffer* args, u64 offset, Buffer* countBuffer, u64 countOffset, u32 maxDrawCount, u32 stride) {
+            if (!m_buffer || !m_isRecording || maxDrawCount == 0) return;
+
+            if (!m_device->isDrawIndirectCountEnabled()) {
+                m_device->getInstance()->error("CommandBuffer::drawIndexedIndirectCount called without LogicalDevice::enableDrawIndirectCount");
+                return;
+            }
+
+            vkCmdDrawIndexedIndirectCount(m_buffer, args->get(), offset, countBuffer->get(), countOffset, maxDrawCount, stride);
+        }
+
+        void CommandBuffer::invalidateState() {
+            m_graphicsState = {};
+            m_computeState = {};
+            for (u32 i = 0;i < MaxVertexBindings;i++) {
+                m_vertexBuffers[i] = VK_NULL_HANDLE;
+                m_vertexOffsets[i] = 0;
+            }
+
+            m_indexBuffer = VK_NULL_HANDLE;
+            m_indexOffset = 0;
+            m_indexType = VK_INDEX_TYPE_UINT32;
+            m_viewportValid = false;
+            m_scissorValid = false;
+        }
+
+        const CommandBufferStats& CommandBuffer::getStats() const {
+            return m_stats;
+        }
+
+        CommandBuffer::bind_point_state* CommandBuffer::getBindPointState(VkPipelineBindPoint bindPoint) {
+            switch (bindPoint) {
+                case VK_PIPELINE_BIND_POINT_GRAPHICS: return &m_graphicsState;
+                case VK_PIPELINE_BIND_POINT_COMPUTE: return &m_computeState;
+                default: return nullptr;
+            }
+        }
+
+        void CommandBuffer::recordDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, u32 setIdx, VkDescriptorSet set, u32 dynamicOffsetCount, const u32* dynamicOffsets) {
+            bind_point_state* state = getBindPointState(bindPoint);
+
+            if (state && state->layout != layout) {
+                // binding with a different layout can disturb any of the sets
+                for (u32 i = 0;i < MaxTrackedSets;i++) state->sets[i].set = VK_NULL_HANDLE;
+                state->layout = layout;
+            }
+
+            bool canTrack = state && setIdx < MaxTrackedSets && dynamicOffsetCount <= MaxTrackedDynamicOffsets;
+            if (canTrack) {
+                bound_set& b = state->sets[setIdx];
+                bool isSame = b.set == set && b.dynamicOffsetCount == dynamicOffsetCount;
+                if (isSame && dynamicOffsetCount > 0) {
+                    isSame = memcmp(b.dynamicOffsets, dynamicOffsets, dynamicOffsetCount * sizeof(u32)) == 0;
+                }
+
+                if (isSame) {
+                    m_stats.descriptorSetBindsElided++;
+                    return;
+                }
+            }
+
+            vkCmdBindDescriptorSets(m_buffer, bindPoint, layout, setIdx, 1, &set, dynamicOffsetCount, dynamicOffsets);
+            m_stats.descriptorSetBinds++;
+
+            if (canTrack) {
+                bound_set& b = state->sets[setIdx];
+                b.set = set;
+                b.dynamicOffsetCount = dynamicOffsetCount;
+                if (dynamicOffsetCount > 0) memcpy(b.dynamicOffsets, dynamicOffsets, dynamicOffsetCount * sizeof(u32));
+            } else if (state && setIdx < MaxTrackedSets) {
+                state->sets[setIdx].set = VK_NULL_HANDLE;
+            }
+        }
+
+        void CommandBuffer::recordVertexBuffer(u32 binding, VkBuffer buffer, VkDeviceSize offset) {
+            if (binding < MaxVertexBindings && m_vertexBuffers[binding] == buffer && m_vertexOffsets[binding] == offset) {
+                m_stats.vertexBufferBindsElided++;
+                return;
+            }
+
+            vkCmdBindVertexBuffers(m_buffer, binding, 1, &buffer, &offset);
+            m_stats.vertexBufferBinds++;
+
+            if (binding < MaxVertexBindings) {
+                m_vertexBuffers[binding] = buffer;
+                m_vertexOffsets[binding] = offset;
+            }
+        }
+
+        void CommandBuffer::recordIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type) {
+            if (m_indexBuffer == buffer && m_indexOffset == offset && m_indexType == type) {
+                m_stats.indexBufferBindsElided++;
+                return;
+            }
+
+            vkCmdBindIndexBuffer(m_buffer, buffer, offset, type);
+            m_stats.indexBufferBinds++;
+            m_indexBuffer = buffer;
+            m_indexOffset = offset;
+            m_indexType = type;
+        }
     };
 };
\ No newline at end of file
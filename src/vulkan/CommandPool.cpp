@@ -72,6 +72,7 @@ namespace render {
             buf->m_pool = this;
             buf->m_device = m_device;
             buf->m_buffer = cb;
+            buf->m_isPrimary = primary;
 
             m_buffers.push(buf);
             return buf;
@@ -90,5 +91,10 @@ namespace render {
             m_buffers.remove(u32(idx));
             delete buffer;
         }
+
+        bool CommandPool::reset() {
+            if (!m_pool) return false;
+            return vkResetCommandPool(m_device->get(), m_pool, 0) == VK_SUCCESS;
+        }
     };
 };
\ No newline at end of file
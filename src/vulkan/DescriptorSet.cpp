@@ -5,8 +5,10 @@
 #include <render/vulkan/Texture.h>
 #include <render/vulkan/Buffer.h>
 #include <render/vulkan/UniformBuffer.h>
+#include <render/vulkan/StorageBuffer.h>
 
 #include <utils/Array.hpp>
+#include <string.h>
 
 namespace render {
     namespace vulkan {
@@ -46,19 +48,22 @@ namespace render {
         bool DescriptorPool::init() {
             if (m_pool) return false;
 
-            VkDescriptorPoolSize ps = {};
-            ps.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            ps.descriptorCount = m_maxSets;
+            VkDescriptorPoolSize ps[] = {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_maxSets },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_maxSets },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_maxSets },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_maxSets }
+            };
 
             VkDescriptorPoolCreateInfo pi = {};
             pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
             pi.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-            pi.poolSizeCount = 1;
-            pi.pPoolSizes = &ps;
+            pi.poolSizeCount = sizeof(ps) / sizeof(VkDescriptorPoolSize);
+            pi.pPoolSizes = ps;
             pi.maxSets = m_maxSets;
 
             if (vkCreateDescriptorPool(m_device->get(), &pi, m_device->getInstance()->getAllocator(), &m_pool) != VK_SUCCESS) {
-                m_device->getInstance()->error("Failed to create descriptor pool for samplers");
+                m_device->getInstance()->error("Failed to create descriptor pool");
                 shutdown();
                 return false;
             }
@@ -78,8 +83,14 @@ namespace render {
         DescriptorSet* DescriptorPool::allocate(Pipeline* pipeline) {
             if (!m_freeList) return nullptr;
 
+            DescriptorSetLayout* setLayout = pipeline->getSetLayout();
+            if (!setLayout) {
+                m_device->getInstance()->error("Can't allocate a descriptor set for a pipeline that has not been initialized");
+                return nullptr;
+            }
+
             VkDescriptorSet set = VK_NULL_HANDLE;
-            VkDescriptorSetLayout layout = pipeline->getDescriptorSetLayout();
+            VkDescriptorSetLayout layout = setLayout->get();
 
             VkDescriptorSetAllocateInfo ai = {};
             ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -96,6 +107,14 @@ namespace render {
             if (!s) return nullptr;
 
             s->m_set = set;
+            s->m_layout = setLayout;
+            m_device->getDescriptorSetLayoutCache()->acquire(setLayout);
+
+            // one slot per binding, kept for the life of the set so updates don't allocate
+            for (u32 i = 0;i < setLayout->getBindingCount();i++) {
+                s->m_data.push({});
+                s->m_isSlotFilled.push(false);
+            }
 
             return s;
         }
@@ -105,14 +124,27 @@ namespace render {
 
             vkFreeDescriptorSets(m_device->get(), m_pool, 1, &s->m_set);
 
+            if (s->m_layout) {
+                m_device->getDescriptorSetLayoutCache()->release(s->m_layout);
+                s->m_layout = nullptr;
+            }
+
             freeNode(s);
         }
 
         void DescriptorPool::resetNodes() {
             for (u32 i = 0;i < m_maxSets;i++) {
+                m_sets[i].m_device = m_device;
                 m_sets[i].m_pool = this;
                 m_sets[i].m_set = VK_NULL_HANDLE;
                 m_sets[i].m_descriptors.clear();
+                m_sets[i].m_data.clear();
+                m_sets[i].m_isSlotFilled.clear();
+
+                if (m_sets[i].m_layout) {
+                    m_device->getDescriptorSetLayoutCache()->release(m_sets[i].m_layout);
+                    m_sets[i].m_layout = nullptr;
+                }
                 
                 if (i == 0) m_sets[i].m_last = nullptr;
                 else m_sets[i].m_last = &m_sets[i - 1];
@@ -139,6 +171,8 @@ namespace render {
             
             n->m_set = VK_NULL_HANDLE;
             n->m_descriptors.clear();
+            n->m_data.clear(false);
+            n->m_isSlotFilled.clear(false);
 
             m_usedSets++;
             return n;
@@ -167,7 +201,9 @@ namespace render {
         //
 
         DescriptorSet::DescriptorSet() {
+            m_device = nullptr;
             m_pool = nullptr;
+            m_layout = nullptr;
             m_next = nullptr;
             m_last = nullptr;
             m_set = VK_NULL_HANDLE;
@@ -177,6 +213,10 @@ namespace render {
             return m_pool;
         }
 
+        DescriptorSetLayout* DescriptorSet::getLayout() const {
+            return m_layout;
+        }
+
         VkDescriptorSet DescriptorSet::get() const {
             return m_set;
         }
@@ -186,6 +226,8 @@ namespace render {
                 nullptr,
                 tex,
                 nullptr,
+                nullptr,
+                nullptr,
                 bindingIndex
             });
         }
@@ -195,6 +237,8 @@ namespace render {
                 uo,
                 nullptr,
                 nullptr,
+                nullptr,
+                nullptr,
                 bindingIndex
             });
         }
@@ -204,6 +248,8 @@ namespace render {
                 nullptr,
                 nullptr,
                 storageBuffer,
+                nullptr,
+                nullptr,
                 bindingIndex
             });
         }
@@ -215,6 +261,8 @@ namespace render {
                         nullptr,
                         tex,
                         nullptr,
+                        nullptr,
+                        nullptr,
                         bindingIndex
                     };
                     break;
@@ -229,6 +277,8 @@ namespace render {
                         uo,
                         nullptr,
                         nullptr,
+                        nullptr,
+                        nullptr,
                         bindingIndex
                     };
                     break;
@@ -243,6 +293,8 @@ namespace render {
                         nullptr,
                         nullptr,
                         storageBuffer,
+                        nullptr,
+                        nullptr,
                         bindingIndex
                     };
                     break;
@@ -250,112 +302,330 @@ namespace render {
             }
         }
 
-        void DescriptorSet::update() {
-            u32 uboCount = 0;
-            u32 texCount = 0;
-            u32 sboCount = 0;
+        void DescriptorSet::add(UniformBuffer* dynamicUniforms, u32 bindingIndex) {
+            m_descriptors.push({
+                nullptr,
+                nullptr,
+                nullptr,
+                dynamicUniforms,
+                nullptr,
+                bindingIndex
+            });
+        }
 
+        void DescriptorSet::set(UniformBuffer* dynamicUniforms, u32 bindingIndex) {
             for (u32 i = 0;i < m_descriptors.size();i++) {
-                if (m_descriptors[i].uniform) {
-                    uboCount++;
-                    continue;
+                if (m_descriptors[i].bindingIdx == bindingIndex) {
+                    m_descriptors[i] = {
+                        nullptr,
+                        nullptr,
+                        nullptr,
+                        dynamicUniforms,
+                        nullptr,
+                        bindingIndex
+                    };
+                    break;
                 }
+            }
+        }
 
-                if (m_descriptors[i].tex) {
-                    texCount++;
-                    continue;
-                }
+        void DescriptorSet::add(StorageArray* storageArray, u32 bindingIndex) {
+            m_descriptors.push({
+                nullptr,
+                nullptr,
+                nullptr,
+                nullptr,
+                storageArray,
+                bindingIndex
+            });
+        }
 
-                if (m_descriptors[i].storageBuffer) {
-                    sboCount++;
-                    continue;
+        void DescriptorSet::set(StorageArray* storageArray, u32 bindingIndex) {
+            for (u32 i = 0;i < m_descriptors.size();i++) {
+                if (m_descriptors[i].bindingIdx == bindingIndex) {
+                    m_descriptors[i] = {
+                        nullptr,
+                        nullptr,
+                        nullptr,
+                        nullptr,
+                        storageArray,
+                        bindingIndex
+                    };
+                    break;
                 }
             }
+        }
+
+        void DescriptorSet::update() {
+            if (!m_layout) return;
+
+            u32 slotCount = m_layout->getBindingCount();
+            if (slotCount == 0) return;
+
+            memset(m_data.data(), 0, slotCount * sizeof(DescriptorSetLayout::slot));
+            for (u32 i = 0;i < slotCount;i++) m_isSlotFilled[i] = false;
 
-            Array<VkDescriptorBufferInfo> bi(uboCount + sboCount);
-            Array<VkDescriptorImageInfo> ii(texCount);
-            Array<VkWriteDescriptorSet> writes(m_descriptors.size());
+            // distinct slots, a binding that was added more than once only fills one
+            u32 filledCount = 0;
 
             for (u32 i = 0;i < m_descriptors.size();i++) {
-                if (m_descriptors[i].uniform) {
-                    auto u = m_descriptors[i].uniform;
+                const descriptor& d = m_descriptors[i];
+
+                i32 slotIdx = m_layout->getSlot(d.bindingIdx);
+                if (slotIdx == -1) {
+                    m_device->getInstance()->error("Descriptor set layout has no binding %u", d.bindingIdx);
+                    continue;
+                }
 
-                    bi.push({});
-                    auto& di = bi.last();
-                    di.buffer = u->getBuffer()->getBuffer();
+                DescriptorSetLayout::slot& s = m_data[slotIdx];
+                if (!m_isSlotFilled[slotIdx]) {
+                    m_isSlotFilled[slotIdx] = true;
+                    filledCount++;
+                }
 
+                if (d.uniform) {
                     u32 offset, size;
-                    u->getRange(&offset, &size);
-                    di.offset = offset;
-                    di.range = size;
-
-                    writes.push({});
-                    auto& wd = writes.last();
-                    wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    wd.dstSet = m_set;
-                    wd.dstBinding = m_descriptors[i].bindingIdx;
-                    wd.dstArrayElement = 0;
-                    wd.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                    wd.descriptorCount = 1;
-                    wd.pBufferInfo = &di;
+                    d.uniform->getRange(&offset, &size);
 
+                    s.buffer.buffer = d.uniform->getBuffer()->getBuffer();
+                    s.buffer.offset = offset;
+                    s.buffer.range = size;
                     continue;
                 }
 
-                if (m_descriptors[i].tex) {
-                    auto t = m_descriptors[i].tex;
-
-                    ii.push({});
-                    auto& di = ii.last();
-                    di.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    di.imageView = t->getView();
-                    di.sampler = t->getSampler();
-
-                    writes.push({});
-                    auto& wd = writes.last();
-                    wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    wd.dstSet = m_set;
-                    wd.dstBinding = m_descriptors[i].bindingIdx;
-                    wd.dstArrayElement = 0;
-                    wd.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                    wd.descriptorCount = 1;
-                    wd.pImageInfo = &di;
+                if (d.tex) {
+                    s.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    s.image.imageView = d.tex->getView();
+                    s.image.sampler = d.tex->getSampler();
+                    continue;
+                }
 
+                if (d.storageBuffer) {
+                    s.buffer.buffer = d.storageBuffer->get();
+                    s.buffer.offset = 0;
+                    s.buffer.range = VK_WHOLE_SIZE;
                     continue;
                 }
-            
-                if (m_descriptors[i].storageBuffer) {
-                    auto b = m_descriptors[i].storageBuffer;
-
-                    bi.push({});
-                    auto& di = bi.last();
-                    di.buffer = b->get();
-                    di.offset = 0;
-                    di.range = VK_WHOLE_SIZE;
-
-                    writes.push({});
-                    auto& wd = writes.last();
-                    wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    wd.dstSet = m_set;
-                    wd.dstBinding = m_descriptors[i].bindingIdx;
-                    wd.dstArrayElement = 0;
-                    wd.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                    wd.descriptorCount = 1;
-                    wd.pBufferInfo = &di;
 
+                if (d.dynamicUniforms) {
+                    // The range only covers one object, the dynamic offset moves it to the one being drawn
+                    s.buffer.buffer = d.dynamicUniforms->getBuffer();
+                    s.buffer.offset = 0;
+                    s.buffer.range = d.dynamicUniforms->getObjectSize();
+                    continue;
+                }
+
+                if (d.storageArray) {
+                    s.buffer.buffer = d.storageArray->getBuffer()->getBuffer();
+                    s.buffer.offset = d.storageArray->getByteOffset();
+                    s.buffer.range = d.storageArray->getSize();
                     continue;
                 }
             }
 
-            vkUpdateDescriptorSets(m_pool->getDevice()->get(), writes.size(), writes.data(), 0, nullptr);
+            VkDevice device = m_device->get();
+
+            if (filledCount == slotCount) {
+                vkUpdateDescriptorSetWithTemplate(device, m_set, m_layout->getUpdateTemplate(), m_data.data());
+                return;
+            }
+
+            // The template writes every binding, so partially filled sets have to be written one binding at a time
+            m_writes.clear(false);
+            for (u32 slotIdx = 0;slotIdx < slotCount;slotIdx++) {
+                if (!m_isSlotFilled[slotIdx]) continue;
+
+                const VkDescriptorSetLayoutBinding& b = m_layout->getBinding(slotIdx);
+
+                m_writes.push({});
+                auto& wd = m_writes.last();
+                wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                wd.dstSet = m_set;
+                wd.dstBinding = b.binding;
+                wd.dstArrayElement = 0;
+                wd.descriptorType = b.descriptorType;
+                wd.descriptorCount = 1;
+
+                if (b.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) wd.pImageInfo = &m_data[slotIdx].image;
+                else wd.pBufferInfo = &m_data[slotIdx].buffer;
+            }
+
+            vkUpdateDescriptorSets(device, m_writes.size(), m_writes.data(), 0, nullptr);
         }
 
         void DescriptorSet::free() {
-            m_pool->free(this);
+            if (m_pool) m_pool->free(this);
         }
     
 
 
+        //
+        // TransientDescriptorAllocator
+        //
+
+        TransientDescriptorAllocator::TransientDescriptorAllocator(LogicalDevice* device, u32 frameCount, u32 maxSetsPerPool) {
+            m_device = device;
+            m_frameCount = frameCount;
+            m_maxSetsPerPool = maxSetsPerPool;
+        }
+
+        TransientDescriptorAllocator::~TransientDescriptorAllocator() {
+            shutdown();
+        }
+
+        bool TransientDescriptorAllocator::init() {
+            if (m_frames.size() > 0 || m_frameCount == 0 || m_maxSetsPerPool == 0) return false;
+
+            m_frames.reserve(m_frameCount);
+            for (u32 i = 0;i < m_frameCount;i++) {
+                m_frames.push({});
+                auto& f = m_frames.last();
+                f.currentPool = 0;
+                f.usedSets = 0;
+
+                VkDescriptorPool pool = createPool();
+                if (!pool) {
+                    shutdown();
+                    return false;
+                }
+
+                f.pools.push(pool);
+            }
+
+            return true;
+        }
+
+        void TransientDescriptorAllocator::shutdown() {
+            for (u32 i = 0;i < m_frames.size();i++) {
+                auto& f = m_frames[i];
+
+                f.pools.each([this](VkDescriptorPool pool) {
+                    vkDestroyDescriptorPool(m_device->get(), pool, m_device->getInstance()->getAllocator());
+                });
+
+                f.sets.each([](DescriptorSet* s) {
+                    delete s;
+                });
+            }
+
+            m_frames.clear();
+        }
+
+        u32 TransientDescriptorAllocator::getFrameCount() const {
+            return m_frameCount;
+        }
+
+        u32 TransientDescriptorAllocator::getUsedSetCount(u32 frameIdx) const {
+            if (frameIdx >= m_frames.size()) return 0;
+            return m_frames[frameIdx].usedSets;
+        }
+
+        void TransientDescriptorAllocator::reset(u32 frameIdx) {
+            if (frameIdx >= m_frames.size()) return;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            auto& f = m_frames[frameIdx];
+
+            // pools past currentPool were never allocated from since the last reset
+            for (u32 i = 0;i <= f.currentPool && i < f.pools.size();i++) {
+                vkResetDescriptorPool(m_device->get(), f.pools[i], 0);
+            }
+
+            f.currentPool = 0;
+            f.usedSets = 0;
+        }
+
+        DescriptorSet* TransientDescriptorAllocator::allocate(u32 frameIdx, Pipeline* pipeline) {
+            if (frameIdx >= m_frames.size()) return nullptr;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            auto& f = m_frames[frameIdx];
+
+            DescriptorSetLayout* setLayout = pipeline->getSetLayout();
+            if (!setLayout) {
+                m_device->getInstance()->error("Can't allocate a descriptor set for a pipeline that has not been initialized");
+                return nullptr;
+            }
+
+            VkDescriptorSetLayout layout = setLayout->get();
+
+            VkDescriptorSetAllocateInfo ai = {};
+            ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            ai.descriptorPool = f.pools[f.currentPool];
+            ai.descriptorSetCount = 1;
+            ai.pSetLayouts = &layout;
+
+            VkDescriptorSet set = VK_NULL_HANDLE;
+            VkResult result = vkAllocateDescriptorSets(m_device->get(), &ai, &set);
+
+            if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+                // move on to the next pool, pools are kept across resets so this only creates one
+                // when the frame uses more sets than it ever has before
+                f.currentPool++;
+                if (f.currentPool == f.pools.size()) {
+                    VkDescriptorPool pool = createPool();
+                    if (!pool) {
+                        f.currentPool--;
+                        return nullptr;
+                    }
+
+                    f.pools.push(pool);
+                }
+
+                ai.descriptorPool = f.pools[f.currentPool];
+                result = vkAllocateDescriptorSets(m_device->get(), &ai, &set);
+            }
+
+            if (result != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to allocate transient descriptor set");
+                return nullptr;
+            }
+
+            if (f.usedSets == f.sets.size()) f.sets.push(new DescriptorSet());
+
+            DescriptorSet* s = f.sets[f.usedSets++];
+            s->m_device = m_device;
+            s->m_pool = nullptr;
+            s->m_layout = setLayout;
+            s->m_set = set;
+            s->m_descriptors.clear(false);
+            s->m_data.clear(false);
+            s->m_isSlotFilled.clear(false);
+
+            for (u32 i = 0;i < setLayout->getBindingCount();i++) {
+                s->m_data.push({});
+                s->m_isSlotFilled.push(false);
+            }
+
+            return s;
+        }
+
+        VkDescriptorPool TransientDescriptorAllocator::createPool() {
+            VkDescriptorPoolSize ps[] = {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_maxSetsPerPool },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_maxSetsPerPool },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_maxSetsPerPool },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_maxSetsPerPool }
+            };
+
+            // no FREE_DESCRIPTOR_SET_BIT, sets are only ever released by resetting the whole pool
+            VkDescriptorPoolCreateInfo pi = {};
+            pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pi.poolSizeCount = sizeof(ps) / sizeof(VkDescriptorPoolSize);
+            pi.pPoolSizes = ps;
+            pi.maxSets = m_maxSetsPerPool;
+
+            VkDescriptorPool pool = VK_NULL_HANDLE;
+            if (vkCreateDescriptorPool(m_device->get(), &pi, m_device->getInstance()->getAllocator(), &pool) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to create transient descriptor pool");
+                return VK_NULL_HANDLE;
+            }
+
+            return pool;
+        }
+
+
+
         //
         // DescriptorFactory
         //
@@ -363,6 +633,7 @@ namespace render {
         DescriptorFactory::DescriptorFactory(LogicalDevice* device, u32 maxSetsPerPool) {
             m_device = device;
             m_maxSetsPerPool = maxSetsPerPool;
+            m_current = nullptr;
         }
 
         DescriptorFactory::~DescriptorFactory() {
@@ -370,16 +641,25 @@ namespace render {
         }
 
         DescriptorSet* DescriptorFactory::allocate(Pipeline* pipeline) {
+            if (m_current && m_current->getRemaining() > 0) return m_current->allocate(pipeline);
+
             DescriptorPool* found = m_pools.find([](DescriptorPool* p) {
                 return p->getRemaining() > 0;
             });
 
-            if (found) return found->allocate(pipeline);
+            if (found) {
+                m_current = found;
+                return found->allocate(pipeline);
+            }
 
             DescriptorPool* p = new DescriptorPool(m_device, m_maxSetsPerPool);
-            if (!p->init()) return nullptr;
+            if (!p->init()) {
+                delete p;
+                return nullptr;
+            }
 
             m_pools.push(p);
+            m_current = p;
             return p->allocate(pipeline);
         }
     };
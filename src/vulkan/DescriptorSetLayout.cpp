@@ -0,0 +1,245 @@
+#include <render/vulkan/DescriptorSetLayout.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/Instance.h>
+#include <render/core/Hash.h>
+
+#include <utils/Array.hpp>
+#include <algorithm>
+
+namespace render {
+    namespace vulkan {
+        //
+        // DescriptorSetLayout
+        //
+
+        DescriptorSetLayout::DescriptorSetLayout(LogicalDevice* device, u64 hash) {
+            m_device = device;
+            m_layout = VK_NULL_HANDLE;
+            m_template = VK_NULL_HANDLE;
+            m_hash = hash;
+            m_refCount = 0;
+        }
+
+        DescriptorSetLayout::~DescriptorSetLayout() {
+            shutdown();
+        }
+
+        VkDescriptorSetLayout DescriptorSetLayout::get() const {
+            return m_layout;
+        }
+
+        VkDescriptorUpdateTemplate DescriptorSetLayout::getUpdateTemplate() const {
+            return m_template;
+        }
+
+        u64 DescriptorSetLayout::getHash() const {
+            return m_hash;
+        }
+
+        u32 DescriptorSetLayout::getBindingCount() const {
+            return m_bindings.size();
+        }
+
+        const VkDescriptorSetLayoutBinding& DescriptorSetLayout::getBinding(u32 slotIdx) const {
+            return m_bindings[slotIdx];
+        }
+
+        i32 DescriptorSetLayout::getSlot(u32 bindingIndex) const {
+            // bindings are sorted and usually dense, so the binding index is almost always the slot
+            if (bindingIndex < m_bindings.size() && m_bindings[bindingIndex].binding == bindingIndex) return bindingIndex;
+
+            for (u32 i = 0;i < m_bindings.size();i++) {
+                if (m_bindings[i].binding == bindingIndex) return i;
+            }
+
+            return -1;
+        }
+
+        bool DescriptorSetLayout::init() {
+            if (m_layout) return false;
+
+            VkDescriptorSetLayoutCreateInfo dsl = {};
+            dsl.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            dsl.bindingCount = m_bindings.size();
+            dsl.pBindings = m_bindings.data();
+
+            if (vkCreateDescriptorSetLayout(m_device->get(), &dsl, m_device->getInstance()->getAllocator(), &m_layout) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to create descriptor set layout");
+                shutdown();
+                return false;
+            }
+
+            // Sets without bindings have nothing to update
+            if (m_bindings.size() == 0) return true;
+
+            Array<VkDescriptorUpdateTemplateEntry> entries(m_bindings.size());
+            for (u32 i = 0;i < m_bindings.size();i++) {
+                entries.push({});
+                auto& e = entries.last();
+                e.dstBinding = m_bindings[i].binding;
+                e.dstArrayElement = 0;
+                e.descriptorCount = 1;
+                e.descriptorType = m_bindings[i].descriptorType;
+                e.offset = i * sizeof(slot);
+                e.stride = sizeof(slot);
+            }
+
+            VkDescriptorUpdateTemplateCreateInfo ti = {};
+            ti.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+            ti.descriptorUpdateEntryCount = entries.size();
+            ti.pDescriptorUpdateEntries = entries.data();
+            ti.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+            ti.descriptorSetLayout = m_layout;
+
+            if (vkCreateDescriptorUpdateTemplate(m_device->get(), &ti, m_device->getInstance()->getAllocator(), &m_template) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to create descriptor update template");
+                shutdown();
+                return false;
+            }
+
+            return true;
+        }
+
+        void DescriptorSetLayout::shutdown() {
+            if (m_template) {
+                vkDestroyDescriptorUpdateTemplate(m_device->get(), m_template, m_device->getInstance()->getAllocator());
+                m_template = VK_NULL_HANDLE;
+            }
+
+            if (m_layout) {
+                vkDestroyDescriptorSetLayout(m_device->get(), m_layout, m_device->getInstance()->getAllocator());
+                m_layout = VK_NULL_HANDLE;
+            }
+        }
+
+        bool DescriptorSetLayout::isEqualTo(const Array<VkDescriptorSetLayoutBinding>& bindings) const {
+            if (bindings.size() != m_bindings.size()) return false;
+
+            for (u32 i = 0;i < m_bindings.size();i++) {
+                const auto& a = m_bindings[i];
+                const auto& b = bindings[i];
+
+                if (a.binding != b.binding) return false;
+                if (a.descriptorType != b.descriptorType) return false;
+                if (a.descriptorCount != b.descriptorCount) return false;
+                if (a.stageFlags != b.stageFlags) return false;
+                if (a.pImmutableSamplers != b.pImmutableSamplers) return false;
+            }
+
+            return true;
+        }
+
+
+
+        //
+        // DescriptorSetLayoutCache
+        //
+
+        DescriptorSetLayoutCache::DescriptorSetLayoutCache(LogicalDevice* device) {
+            m_device = device;
+            m_layoutCount = 0;
+        }
+
+        DescriptorSetLayoutCache::~DescriptorSetLayoutCache() {
+            shutdown();
+        }
+
+        DescriptorSetLayout* DescriptorSetLayoutCache::get(const Array<VkDescriptorSetLayoutBinding>& bindings) {
+            // layouts hold one update slot per binding, arrays of descriptors would need one per element
+            for (u32 i = 0;i < bindings.size();i++) {
+                if (bindings[i].descriptorCount != 1) {
+                    m_device->getInstance()->error("Descriptor set layout binding %u has %u descriptors, only single descriptor bindings are supported", bindings[i].binding, bindings[i].descriptorCount);
+                    return nullptr;
+                }
+            }
+
+            Array<VkDescriptorSetLayoutBinding> sorted = bindings;
+            std::sort(sorted.data(), sorted.data() + sorted.size(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+                return a.binding < b.binding;
+            });
+
+            u64 hash = HashBindings(sorted);
+
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            Array<DescriptorSetLayout*>& candidates = m_layouts[hash];
+            for (u32 i = 0;i < candidates.size();i++) {
+                if (candidates[i]->isEqualTo(sorted)) {
+                    candidates[i]->m_refCount++;
+                    return candidates[i];
+                }
+            }
+
+            DescriptorSetLayout* layout = new DescriptorSetLayout(m_device, hash);
+            layout->m_bindings = sorted;
+
+            if (!layout->init()) {
+                delete layout;
+                return nullptr;
+            }
+
+            layout->m_refCount = 1;
+            candidates.push(layout);
+            m_layoutCount++;
+
+            return layout;
+        }
+
+        void DescriptorSetLayoutCache::acquire(DescriptorSetLayout* layout) {
+            if (!layout) return;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            layout->m_refCount++;
+        }
+
+        void DescriptorSetLayoutCache::release(DescriptorSetLayout* layout) {
+            if (!layout) return;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            if (layout->m_refCount > 1) {
+                layout->m_refCount--;
+                return;
+            }
+
+            auto it = m_layouts.find(layout->m_hash);
+            if (it == m_layouts.end()) return;
+
+            i64 idx = it->second.findIndex([layout](DescriptorSetLayout* l) { return l == layout; });
+            if (idx == -1) return;
+
+            it->second.remove(u32(idx));
+            if (it->second.size() == 0) m_layouts.erase(it);
+
+            delete layout;
+            m_layoutCount--;
+        }
+
+        u32 DescriptorSetLayoutCache::getLayoutCount() const {
+            return m_layoutCount;
+        }
+
+        void DescriptorSetLayoutCache::shutdown() {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            for (auto& it : m_layouts) {
+                it.second.each([](DescriptorSetLayout* l) { delete l; });
+            }
+
+            m_layouts.clear();
+            m_layoutCount = 0;
+        }
+
+        u64 DescriptorSetLayoutCache::HashBindings(const Array<VkDescriptorSetLayoutBinding>& sortedBindings) {
+            u64 h = core::HashSeed;
+
+            for (u32 i = 0;i < sortedBindings.size();i++) {
+                const auto& b = sortedBindings[i];
+                h = core::HashCombine(h, u64(b.binding) | (u64(b.descriptorType) << 32));
+                h = core::HashCombine(h, u64(b.descriptorCount) | (u64(b.stageFlags) << 32));
+            }
+
+            return h;
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include <render/vulkan/DrawQueue.h>
+#include <render/vulkan/CommandBuffer.h>
+#include <render/vulkan/VertexBuffer.h>
+#include <render/vulkan/IndexBuffer.h>
+
+#include <utils/Array.hpp>
+
+#include <string.h>
+
+namespace render {
+    namespace vulkan {
+        constexpr u32 PipelineIdBits = 12;
+        constexpr u32 SetIdBits = 20;
+        constexpr u32 DepthBits = 31;
+        constexpr u32 PipelineIdMask = (1u << PipelineIdBits) - 1;
+        constexpr u32 SetIdMask = (1u << SetIdBits) - 1;
+        constexpr u32 DepthMask = (1u << DepthBits) - 1;
+
+        DrawQueue::DrawQueue() {
+        }
+
+        DrawQueue::~DrawQueue() {
+        }
+
+        u32 DrawQueue::add(const DrawPacket& draw) {
+            m_packets.push({ draw, 0, 0, 0 });
+
+            packet& p = m_packets.last();
+            if (p.draw.instanceCount == 0) p.draw.instanceCount = 1;
+
+            return m_packets.size() - 1;
+        }
+
+        void DrawQueue::setPushConstants(u32 drawIdx, u32 rangeIndex, const void* data, u32 size) {
+            if (drawIdx >= m_packets.size() || size == 0) return;
+
+            packet& p = m_packets[drawIdx];
+            p.pushConstantOffset = u32(m_pushConstantData.size());
+            p.pushConstantSize = size;
+            p.pushConstantRange = rangeIndex;
+
+            m_pushConstantData.resize(m_pushConstantData.size() + size);
+            memcpy(m_pushConstantData.data() + p.pushConstantOffset, data, size);
+        }
+
+        u32 DrawQueue::getCount() const {
+            return m_packets.size();
+        }
+
+        void DrawQueue::submit(CommandBuffer* cb) {
+            if (m_packets.size() == 0) return;
+
+            sort();
+
+            for (u32 i = 0;i < m_entries.size();i++) {
+                const packet& p = m_packets[m_entries[i].index];
+                const DrawPacket& d = p.draw;
+                if (!d.pipeline || !d.vertices) continue;
+
+                // the command buffer drops these when they match what's already bound
+                cb->bindPipeline(d.pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+                if (d.descriptorSet) {
+                    if (d.dynamicUniform) cb->bindDescriptorSet(d.descriptorSet, VK_PIPELINE_BIND_POINT_GRAPHICS, d.dynamicUniform);
+                    else cb->bindDescriptorSet(d.descriptorSet, VK_PIPELINE_BIND_POINT_GRAPHICS);
+                }
+
+                if (p.pushConstantSize > 0) {
+                    cb->pushConstants(p.pushConstantRange, m_pushConstantData.data() + p.pushConstantOffset, p.pushConstantSize);
+                }
+
+                cb->bindVertexBuffer(d.vertices->getBuffer());
+
+                if (d.indices) {
+                    cb->bindIndexBuffer(d.indices->getBuffer());
+                    cb->drawIndexed(d.indices, d.vertices, d.instanceCount, d.firstInstance);
+                } else {
+                    cb->draw(d.vertices->getCount(), d.vertices->getOffset(), d.instanceCount, d.firstInstance);
+                }
+            }
+
+            clear();
+        }
+
+        void DrawQueue::clear() {
+            m_packets.clear(false);
+            m_pushConstantData.clear();
+            m_entries.clear();
+            m_pipelineIds.clear();
+            m_setIds.clear();
+        }
+
+        u64 DrawQueue::EncodeKey(u32 pipelineId, u32 setId, f32 depth, bool isTransparent) {
+            // the bits of a non-negative float sort the same way as its value
+            u32 depthBits = 0;
+            if (depth > 0.0f) memcpy(&depthBits, &depth, sizeof(u32));
+            depthBits &= DepthMask;
+
+            u64 pipeline = pipelineId < PipelineIdMask ? pipelineId : PipelineIdMask;
+            u64 set = setId < SetIdMask ? setId : SetIdMask;
+
+            if (isTransparent) {
+                // | 1 | depth, far to near (31) | pipeline (12) | set (20) |
+                return (u64(1) << 63) | (u64(DepthMask - depthBits) << (SetIdBits + PipelineIdBits)) | (pipeline << SetIdBits) | set;
+            }
+
+            // | 0 | pipeline (12) | set (20) | depth, near to far (31) |
+            return (pipeline << (SetIdBits + DepthBits)) | (set << DepthBits) | u64(depthBits);
+        }
+
+        u32 DrawQueue::getPipelineId(Pipeline* pipeline) {
+            auto it = m_pipelineIds.find(pipeline);
+            if (it != m_pipelineIds.end()) return it->second;
+
+            u32 id = u32(m_pipelineIds.size());
+            m_pipelineIds[pipeline] = id;
+            return id;
+        }
+
+        u32 DrawQueue::getSetId(DescriptorSet* set) {
+            auto it = m_setIds.find(set);
+            if (it != m_setIds.end()) return it->second;
+
+            u32 id = u32(m_setIds.size());
+            m_setIds[set] = id;
+            return id;
+        }
+
+        void DrawQueue::sort() {
+            u32 count = m_packets.size();
+            m_entries.resize(count);
+            m_scratch.resize(count);
+
+            for (u32 i = 0;i < count;i++) {
+                const DrawPacket& d = m_packets[i].draw;
+                m_entries[i].key = EncodeKey(getPipelineId(d.pipeline), getSetId(d.descriptorSet), d.depth, d.isTransparent);
+                m_entries[i].index = i;
+            }
+
+            // LSD radix sort, one byte per pass. All histograms are built up front so passes where
+            // every key has the same byte can be skipped
+            u32 histograms[8][256] = {};
+            for (u32 i = 0;i < count;i++) {
+                u64 key = m_entries[i].key;
+                for (u32 b = 0;b < 8;b++) histograms[b][(key >> (b * 8)) & 0xFF]++;
+            }
+
+            sort_entry* src = m_entries.data();
+            sort_entry* dst = m_scratch.data();
+
+            for (u32 b = 0;b < 8;b++) {
+                u32* hist = histograms[b];
+                if (hist[(src[0].key >> (b * 8)) & 0xFF] == count) continue;
+
+                u32 offset = 0;
+                for (u32 i = 0;i < 256;i++) {
+                    u32 c = hist[i];
+                    hist[i] = offset;
+                    offset += c;
+                }
+
+                for (u32 i = 0;i < count;i++) {
+                    dst[hist[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+                }
+
+                sort_entry* tmp = src;
+                src = dst;
+                dst = tmp;
+            }
+
+            if (src != m_entries.data()) m_entries.swap(m_scratch);
+        }
+    };
+};
\ No newline at end of file
@@ -2,15 +2,13 @@
 #include <render/vulkan/ShaderCompiler.h>
 #include <render/vulkan/LogicalDevice.h>
 #include <render/vulkan/Instance.h>
+#include <render/vulkan/PipelineCache.h>
+#include <render/vulkan/DescriptorSetLayout.h>
 #include <render/vulkan/SwapChain.h>
 #include <render/vulkan/RenderPass.h>
 #include <render/vulkan/Texture.h>
 
 #include <utils/Array.hpp>
-#include <glslang/Public/ShaderLang.h>
-#include <glslang/Public/ResourceLimits.h>
-#include <SPIRV/GlslangToSpv.h>
-#include <SPIRV/Logger.h>
 
 namespace render {
     namespace vulkan {
@@ -75,11 +73,9 @@ namespace render {
             m_swapChain = swapChain;
             m_renderPass = render;
             m_layout = VK_NULL_HANDLE;
-            m_descriptorSetLayout = VK_NULL_HANDLE;
+            m_descriptorSetLayout = nullptr;
             m_pipeline = VK_NULL_HANDLE;
-            m_vertexShader = m_fragShader = m_geomShader = nullptr;
             m_isInitialized = false;
-            m_vertexFormat = nullptr;
 
             reset();
             swapChain->onPipelineCreated(this);
@@ -93,7 +89,7 @@ namespace render {
         void GraphicsPipeline::reset() {
             shutdown();
 
-            m_vertexFormat = nullptr;
+            m_vertexBindings.clear();
             m_scissorIsSet = false;
             setViewport(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f);
             m_viewportDynamic = false;
@@ -120,12 +116,13 @@ namespace render {
             m_depthWriteEnabled      = false;               m_depthWriteEnabledDynamic      = false;
             m_colorBlendEnabled      = false;               m_colorBlendEnabledDynamic      = false;
 
-            m_vertexShader = nullptr;
-            m_fragShader = nullptr;
-            m_geomShader = nullptr;
+            m_vertexShader.clear();
+            m_fragShader.clear();
+            m_geomShader.clear();
             m_vertexShaderSrc = "";
             m_fragShaderSrc = "";
             m_geomShaderSrc = "";
+            m_needsLinkCheck = false;
         }
 
         void GraphicsPipeline::addSampler(u32 bindIndex, VkShaderStageFlagBits stages) {
@@ -135,43 +132,62 @@ namespace render {
             });
         }
 
-        void GraphicsPipeline::addUniformBlock(u32 bindIndex, const core::DataFormat* fmt, VkShaderStageFlagBits stages) {
+        void GraphicsPipeline::addUniformBlock(u32 bindIndex, const core::DataFormat* fmt, VkShaderStageFlagBits stages, bool isDynamic) {
             m_uniformBlocks.push({
                 bindIndex,
                 stages,
-                fmt
+                fmt,
+                isDynamic
             });
         }
         
         void GraphicsPipeline::setVertexFormat(const core::DataFormat* fmt) {
             if (m_isInitialized) return;
-            m_vertexFormat = fmt;
+
+            if (m_vertexBindings.size() == 0) m_vertexBindings.push({ fmt, VK_VERTEX_INPUT_RATE_VERTEX });
+            else m_vertexBindings[0] = { fmt, VK_VERTEX_INPUT_RATE_VERTEX };
+        }
+
+        u32 GraphicsPipeline::addVertexBinding(const core::DataFormat* fmt, VkVertexInputRate inputRate) {
+            if (m_isInitialized) return InvalidBinding;
+
+            // binding 0 belongs to setVertexFormat, reserve it so that a later call doesn't replace this one
+            if (m_vertexBindings.size() == 0) m_vertexBindings.push({ nullptr, VK_VERTEX_INPUT_RATE_VERTEX });
+
+            m_vertexBindings.push({ fmt, inputRate });
+            return m_vertexBindings.size() - 1;
         }
         
         bool GraphicsPipeline::setVertexShader(const String& source) {
-            if (m_vertexShader) return false;
-            m_vertexShader = m_compiler->compileShader(source, EShLangVertex);
+            if (m_vertexShader.size() > 0) return false;
+
+            bool wasCached = false;
+            if (!m_compiler->compileSpirv(source, EShLangVertex, m_vertexShader, &wasCached)) return false;
 
-            if (m_vertexShader == nullptr) return false;
             m_vertexShaderSrc = source;
+            if (!wasCached) m_needsLinkCheck = true;
             return true;
         }
 
         bool GraphicsPipeline::setFragmentShader(const String& source) {
-            if (m_fragShader) return false;
-            m_fragShader = m_compiler->compileShader(source, EShLangFragment);
+            if (m_fragShader.size() > 0) return false;
+
+            bool wasCached = false;
+            if (!m_compiler->compileSpirv(source, EShLangFragment, m_fragShader, &wasCached)) return false;
 
-            if (m_fragShader == nullptr) return false;
             m_fragShaderSrc = source;
+            if (!wasCached) m_needsLinkCheck = true;
             return true;
         }
 
         bool GraphicsPipeline::setGeometryShader(const String& source) {
-            if (m_geomShader) return false;
-            m_geomShader = m_compiler->compileShader(source, EShLangGeometry);
+            if (m_geomShader.size() > 0) return false;
+
+            bool wasCached = false;
+            if (!m_compiler->compileSpirv(source, EShLangGeometry, m_geomShader, &wasCached)) return false;
 
-            if (m_geomShader == nullptr) return false;
             m_geomShaderSrc = source;
+            if (!wasCached) m_needsLinkCheck = true;
             return true;
         }
 
@@ -238,6 +254,10 @@ namespace render {
             }
         }
         
+        bool GraphicsPipeline::isStateDynamic(VkDynamicState state) const {
+            return m_dynamicState.some([state](VkDynamicState s) { return s == state; });
+        }
+
         void GraphicsPipeline::setPrimitiveType(PRIMITIVE_TYPE ptype) {
             if (m_isInitialized && !m_primTypeDynamic) return;
             m_primType = ptype;
@@ -335,24 +355,32 @@ namespace render {
         }
 
         bool GraphicsPipeline::init() {
-            if (m_isInitialized || !m_device || !m_swapChain || !m_compiler) return false;
+            if (m_isInitialized || m_pipeline || !m_device || !m_swapChain || !m_compiler) return false;
 
-            EShMessages messageFlags = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
+            // Skipped when every stage came from the cache, they were checked when first compiled
+            if (m_needsLinkCheck) {
+                String sources[3];
+                EShLanguage types[3];
+                u32 stageCount = 0;
 
-            glslang::TProgram prog;
-            if (m_vertexShader) prog.addShader(m_vertexShader);
-            if (m_fragShader) prog.addShader(m_fragShader);
-            if (m_geomShader) prog.addShader(m_geomShader);
+                if (m_vertexShaderSrc.size() > 0) { sources[stageCount] = m_vertexShaderSrc; types[stageCount++] = EShLangVertex; }
+                if (m_geomShaderSrc.size() > 0) { sources[stageCount] = m_geomShaderSrc; types[stageCount++] = EShLangGeometry; }
+                if (m_fragShaderSrc.size() > 0) { sources[stageCount] = m_fragShaderSrc; types[stageCount++] = EShLangFragment; }
 
-            if (!prog.link(messageFlags)) {
-                error(String(prog.getInfoLog()));
-                return false;
+                if (stageCount > 1 && !m_compiler->validateLinkage(sources, types, stageCount)) {
+                    error("Pipeline shader stages failed to link");
+                    return false;
+                }
+
+                m_needsLinkCheck = false;
             }
 
-            Array<VkPipelineShaderStageCreateInfo> stages;
-            if (m_vertexShader && !processShader(prog, EShLangVertex, stages)) { shutdown(); return false; }
-            if (m_fragShader && !processShader(prog, EShLangFragment, stages)) { shutdown(); return false; }
-            if (m_geomShader && !processShader(prog, EShLangGeometry, stages)) { shutdown(); return false; }
+            // Shader modules and layouts survive recreate(), only the pipeline object itself is rebuilt
+            if (m_shaderStages.size() == 0) {
+                if (m_vertexShader.size() > 0 && !processShader(m_vertexShader, VK_SHADER_STAGE_VERTEX_BIT, m_shaderStages)) { shutdown(); return false; }
+                if (m_fragShader.size() > 0 && !processShader(m_fragShader, VK_SHADER_STAGE_FRAGMENT_BIT, m_shaderStages)) { shutdown(); return false; }
+                if (m_geomShader.size() > 0 && !processShader(m_geomShader, VK_SHADER_STAGE_GEOMETRY_BIT, m_shaderStages)) { shutdown(); return false; }
+            }
 
             VkPipelineDynamicStateCreateInfo di = {};
             di.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -362,52 +390,30 @@ namespace render {
             Array<VkVertexInputBindingDescription> vertexBindings;
             Array<VkVertexInputAttributeDescription> vertexAttribs;
 
-            if (m_vertexFormat && m_vertexFormat->isValid()) {
+            u32 location = 0;
+            Array<core::DataFormat::VertexAttribute> flattened;
+            for (u32 b = 0;b < m_vertexBindings.size();b++) {
+                const vertex_binding& binding = m_vertexBindings[b];
+                if (!binding.format || !binding.format->isValid()) continue;
+
                 vertexBindings.emplace();
                 auto& vbd = vertexBindings.last();
-                vbd.binding = vertexBindings.size() - 1;
-                vbd.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-                vbd.stride = m_vertexFormat->getSize();
-
-                auto va = m_vertexFormat->getAttributes();
-                u32 location = 0;
-                for (u32 i = 0;i < va.size();i++) {
-                    core::DataFormat::Attribute& attr = va[i];
-
-                    if (attr.type == dt_struct) {
-                        error("Structures as vertex attributes are not supported");
-                        shutdown();
-                        return false;
-                    }
-
-                    if (attr.elementCount > 1) {
-                        error("Arrays as vertex attributes are not supported");
-                        shutdown();
-                        return false;
-                    }
-
-                    u32 count = 1;
-                    if (attr.type == dt_mat2i || attr.type == dt_mat2f || attr.type == dt_mat2ui) {
-                        // 2x vec2
-                        count = 2;
-                    } else if (attr.type == dt_mat3i || attr.type == dt_mat3f || attr.type == dt_mat3ui) {
-                        // 3x vec3
-                        count = 3;
-                    } else if (attr.type == dt_mat4i || attr.type == dt_mat4f || attr.type == dt_mat4ui) {
-                        // 4x vec4
-                        count = 4;
-                    }
-
-                    for (u32 c = 0;c < count;c++) {
-                        vertexAttribs.emplace();
-                        auto& a = vertexAttribs.last();
-                        a.binding = vbd.binding;
-                        a.offset = attr.offset;
-                        a.location = location;
-                        a.format = dt_compTypes[attr.type];
-
-                        location++;
-                    }
+                vbd.binding = b;
+                vbd.inputRate = binding.inputRate;
+                vbd.stride = binding.format->getSize();
+
+                flattened.clear(false);
+                binding.format->getVertexAttributes(flattened);
+
+                for (u32 i = 0;i < flattened.size();i++) {
+                    vertexAttribs.emplace();
+                    auto& a = vertexAttribs.last();
+                    a.binding = b;
+                    a.offset = flattened[i].offset;
+                    a.location = location;
+                    a.format = dt_compTypes[flattened[i].type];
+
+                    location++;
                 }
             }
 
@@ -553,57 +559,62 @@ namespace render {
             cbsi.blendConstants[2] = 0.0f;
             cbsi.blendConstants[3] = 0.0f;
 
-            Array<VkDescriptorSetLayoutBinding> descriptorSetBindings;
-            for (u32 i = 0;i < m_uniformBlocks.size();i++) {
-                descriptorSetBindings.push({});
-                auto& b = descriptorSetBindings.last();
-                auto& u = m_uniformBlocks[i];
-                b.binding = u.binding;
-                b.stageFlags = u.stages;
-                b.descriptorCount = 1;
-                b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                b.pImmutableSamplers = VK_NULL_HANDLE;
-            }
+            if (!m_layout) {
+                if (!validatePushConstants()) {
+                    shutdown();
+                    return false;
+                }
 
-            for (u32 i = 0;i < m_samplers.size();i++) {
-                descriptorSetBindings.push({});
-                auto& b = descriptorSetBindings.last();
-                auto& s = m_samplers[i];
-                b.binding = s.binding;
-                b.descriptorCount = 1;
-                b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                b.pImmutableSamplers = VK_NULL_HANDLE;
-                b.stageFlags = s.stages;
-            }
+                Array<VkDescriptorSetLayoutBinding> descriptorSetBindings;
+                for (u32 i = 0;i < m_uniformBlocks.size();i++) {
+                    descriptorSetBindings.push({});
+                    auto& b = descriptorSetBindings.last();
+                    auto& u = m_uniformBlocks[i];
+                    b.binding = u.binding;
+                    b.stageFlags = u.stages;
+                    b.descriptorCount = 1;
+                    b.descriptorType = u.isDynamic ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    b.pImmutableSamplers = VK_NULL_HANDLE;
+                }
 
-            VkDescriptorSetLayoutCreateInfo dsl = {};
-            dsl.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            dsl.bindingCount = descriptorSetBindings.size();
-            dsl.pBindings = descriptorSetBindings.data();
+                for (u32 i = 0;i < m_samplers.size();i++) {
+                    descriptorSetBindings.push({});
+                    auto& b = descriptorSetBindings.last();
+                    auto& s = m_samplers[i];
+                    b.binding = s.binding;
+                    b.descriptorCount = 1;
+                    b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    b.pImmutableSamplers = VK_NULL_HANDLE;
+                    b.stageFlags = s.stages;
+                }
 
-            if (vkCreateDescriptorSetLayout(m_device->get(), &dsl, m_device->getInstance()->getAllocator(), &m_descriptorSetLayout) != VK_SUCCESS) {
-                error("Failed to create descriptor set layout");
-                shutdown();
-                return false;
-            }
+                m_descriptorSetLayout = m_device->getDescriptorSetLayoutCache()->get(descriptorSetBindings);
+                if (!m_descriptorSetLayout) {
+                    error("Failed to create descriptor set layout");
+                    shutdown();
+                    return false;
+                }
 
-            VkPipelineLayoutCreateInfo li = {};
-            li.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            li.setLayoutCount = 1;
-            li.pSetLayouts = &m_descriptorSetLayout;
-            li.pushConstantRangeCount = 0;
-            li.pPushConstantRanges = nullptr;
+                VkDescriptorSetLayout setLayouts[2];
 
-            if (vkCreatePipelineLayout(m_device->get(), &li, m_device->getInstance()->getAllocator(), &m_layout) != VK_SUCCESS) {
-                error("Failed to create pipeline layout");
-                shutdown();
-                return false;
+                VkPipelineLayoutCreateInfo li = {};
+                li.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                li.setLayoutCount = getSetLayouts(setLayouts);
+                li.pSetLayouts = setLayouts;
+                li.pushConstantRangeCount = m_pushConstantRanges.size();
+                li.pPushConstantRanges = m_pushConstantRanges.data();
+
+                if (vkCreatePipelineLayout(m_device->get(), &li, m_device->getInstance()->getAllocator(), &m_layout) != VK_SUCCESS) {
+                    error("Failed to create pipeline layout");
+                    shutdown();
+                    return false;
+                }
             }
 
             VkGraphicsPipelineCreateInfo pci = {};
             pci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-            pci.stageCount = stages.size();
-            pci.pStages = stages.data();
+            pci.stageCount = m_shaderStages.size();
+            pci.pStages = m_shaderStages.data();
             pci.pVertexInputState = &vi;
             pci.pInputAssemblyState = &ai;
             pci.pViewportState = &vpi;
@@ -618,12 +629,14 @@ namespace render {
             pci.basePipelineHandle = VK_NULL_HANDLE;
             pci.basePipelineIndex = -1;
 
-            if (vkCreateGraphicsPipelines(m_device->get(), nullptr, 1, &pci, m_device->getInstance()->getAllocator(), &m_pipeline) != VK_SUCCESS) {
+            VkPipelineCache cache = m_device->getPipelineCache() ? m_device->getPipelineCache()->get() : VK_NULL_HANDLE;
+            if (vkCreateGraphicsPipelines(m_device->get(), cache, 1, &pci, m_device->getInstance()->getAllocator(), &m_pipeline) != VK_SUCCESS) {
                 error("Failed to create graphics pipeline");
                 shutdown();
                 return false;
             }
 
+            m_isInitialized = true;
             return true;
         }
 
@@ -632,32 +645,28 @@ namespace render {
                 vkDestroyShaderModule(m_device->get(), mod, m_device->getInstance()->getAllocator());
             });
             m_shaderModules.clear();
+            m_shaderStages.clear();
 
             if (m_layout) vkDestroyPipelineLayout(m_device->get(), m_layout, m_device->getInstance()->getAllocator());
-            if (m_descriptorSetLayout) vkDestroyDescriptorSetLayout(m_device->get(), m_descriptorSetLayout, m_device->getInstance()->getAllocator());
+            if (m_descriptorSetLayout) m_device->getDescriptorSetLayoutCache()->release(m_descriptorSetLayout);
             if (m_pipeline) vkDestroyPipeline(m_device->get(), m_pipeline, m_device->getInstance()->getAllocator());
 
-            if (m_vertexShader) delete m_vertexShader;
-            m_vertexShader = nullptr;
-            if (m_fragShader) delete m_fragShader;
-            m_fragShader = nullptr;
-            if (m_geomShader) delete m_geomShader;
-            m_geomShader = nullptr;
-
             m_layout = VK_NULL_HANDLE;
-            m_descriptorSetLayout = VK_NULL_HANDLE;
+            m_descriptorSetLayout = nullptr;
             m_pipeline = VK_NULL_HANDLE;
             m_isInitialized = false;
         }
         
         bool GraphicsPipeline::recreate() {
-            shutdown();
+            // Nothing the pipeline depends on changes with the swapchain when viewport and scissor are dynamic
+            if (m_pipeline && m_viewportDynamic && m_scissorDynamic) return true;
 
-            // glslang::TShader can't be reused...
-            if (m_vertexShaderSrc.size() > 0 && !setVertexShader(m_vertexShaderSrc)) return false;
-            if (m_fragShaderSrc.size() > 0 && !setFragmentShader(m_fragShaderSrc)) return false;
-            if (m_geomShaderSrc.size() > 0 && !setGeometryShader(m_geomShaderSrc)) return false;
+            if (m_pipeline) {
+                vkDestroyPipeline(m_device->get(), m_pipeline, m_device->getInstance()->getAllocator());
+                m_pipeline = VK_NULL_HANDLE;
+            }
 
+            m_isInitialized = false;
             return init();
         }
 
@@ -670,53 +679,10 @@ namespace render {
         }
         
         bool GraphicsPipeline::processShader(
-            glslang::TProgram& prog,
-            EShLanguage lang,
+            const std::vector<u32>& code,
+            VkShaderStageFlagBits stage,
             Array<VkPipelineShaderStageCreateInfo>& stages
         ) {
-            glslang::TIntermediate& IR = *(prog.getIntermediate(lang));
-            std::vector<u32> code;
-            
-            glslang::SpvOptions options = {};
-            options.validate = true;
-
-            spv::SpvBuildLogger logger;
-            glslang::GlslangToSpv(IR, code, &logger, &options);
-
-            String allLogs = logger.getAllMessages();
-            auto msgs = allLogs.split("\n");
-            for (u32 i = 0;i < msgs.size();i++) {
-                String& ln = msgs[i];
-
-                i64 idx = -1;
-                
-                idx = ln.firstIndexOf("TBD functionality: ");
-                if (idx > 0) {
-                    log(ln);
-                    continue;
-                }
-                
-                idx = ln.firstIndexOf("Missing functionality: ");
-                if (idx > 0) {
-                    log(ln);
-                    continue;
-                }
-        
-                idx = ln.firstIndexOf("warning: ");
-                if (idx > 0) {
-                    constexpr size_t len = sizeof("warning: ");
-                    warn(String(&ln[len], ln.size() - len));
-                    continue;
-                }
-
-                idx = ln.firstIndexOf("error: ");
-                if (idx > 0) {
-                    constexpr size_t len = sizeof("error: ");
-                    error(String(&ln[len], ln.size() - len));
-                    continue;
-                }
-            }
-        
             if (code.size() == 0) return false;
 
             VkShaderModuleCreateInfo ci = {};
@@ -738,23 +704,7 @@ namespace render {
             si.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
             si.module = mod;
             si.pName = "main";
-
-            switch (lang) {
-                case EShLangVertex: { si.stage = VK_SHADER_STAGE_VERTEX_BIT; break; }
-                case EShLangTessControl: { si.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break; }
-                case EShLangTessEvaluation: { si.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break; }
-                case EShLangGeometry: { si.stage = VK_SHADER_STAGE_GEOMETRY_BIT; break; }
-                case EShLangFragment: { si.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break; }
-                case EShLangCompute: { si.stage = VK_SHADER_STAGE_COMPUTE_BIT; break; }
-                case EShLangRayGen: { si.stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR; break; }
-                case EShLangIntersect: { si.stage = VK_SHADER_STAGE_INTERSECTION_BIT_KHR; break; }
-                case EShLangAnyHit: { si.stage = VK_SHADER_STAGE_ANY_HIT_BIT_KHR; break; }
-                case EShLangClosestHit: { si.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR; break; }
-                case EShLangMiss: { si.stage = VK_SHADER_STAGE_MISS_BIT_KHR; break; }
-                case EShLangCallable: { si.stage = VK_SHADER_STAGE_CALLABLE_BIT_KHR; break; }
-                case EShLangTask: { si.stage = VK_SHADER_STAGE_TASK_BIT_EXT; break; }
-                case EShLangMesh: { si.stage = VK_SHADER_STAGE_MESH_BIT_EXT; break; }
-            }
+            si.stage = stage;
 
             m_shaderModules.push(mod);
             stages.push(si);
@@ -0,0 +1,264 @@
+#include <render/vulkan/IndexBuffer.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Instance.h>
+
+#include <utils/Array.hpp>
+#include <utils/Math.hpp>
+
+namespace render {
+    namespace vulkan {
+        //
+        // IndexBuffer
+        //
+
+        IndexBuffer::IndexBuffer(LogicalDevice* device, VkIndexType type, u32 indexCapacity) : m_buffer(device), m_allocator(indexCapacity) {
+            m_device = device;
+            m_type = type;
+            m_indexSize = IndexSize(type);
+            m_capacity = indexCapacity;
+            m_memoryMapRefCount = 0;
+            m_factory = nullptr;
+            m_heapIndex = 0xFFFFFFFF;
+        }
+
+        IndexBuffer::~IndexBuffer() {
+            shutdown();
+        }
+
+        bool IndexBuffer::init() {
+            if (m_buffer.isValid()) return false;
+
+            if (m_indexSize == 0) {
+                m_device->getInstance()->error("Index buffers only support VK_INDEX_TYPE_UINT16 and VK_INDEX_TYPE_UINT32");
+                return false;
+            }
+
+            return m_buffer.init(
+                m_indexSize * m_capacity,
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            );
+        }
+
+        void IndexBuffer::shutdown() {
+            m_buffer.shutdown();
+            freeAllIndices();
+        }
+
+        LogicalDevice* IndexBuffer::getDevice() const {
+            return m_device;
+        }
+
+        VkIndexType IndexBuffer::getType() const {
+            return m_type;
+        }
+
+        u32 IndexBuffer::getIndexSize() const {
+            return m_indexSize;
+        }
+
+        VkBuffer IndexBuffer::getBuffer() const {
+            return m_buffer.get();
+        }
+
+        VkDeviceMemory IndexBuffer::getMemory() const {
+            return m_buffer.getMemory();
+        }
+
+        u32 IndexBuffer::getCapacity() const {
+            if (!m_buffer.isValid()) return 0;
+            return m_capacity;
+        }
+
+        u32 IndexBuffer::getCurrentMaximumBlockSize() const {
+            if (!m_buffer.isValid()) return 0;
+            return m_allocator.getLargestFreeRange();
+        }
+
+        u32 IndexBuffer::getUsedCount() const {
+            return m_allocator.getUsedSize();
+        }
+
+        u32 IndexBuffer::getAllocationCount() const {
+            return m_allocator.getAllocationCount();
+        }
+
+        f32 IndexBuffer::getFragmentation() const {
+            return m_allocator.getFragmentation();
+        }
+
+        Indices* IndexBuffer::allocate(u32 count) {
+            if (!m_buffer.isValid()) return nullptr;
+
+            core::RangeAllocator::Range* r = m_allocator.allocate(count);
+            if (!r) return nullptr;
+
+            Indices* i = new Indices(this, r, count);
+            r->userData = i;
+
+            if (m_factory) m_factory->onCapacityChanged(this);
+            return i;
+        }
+
+        void IndexBuffer::free(Indices* indices) {
+            if (!m_buffer.isValid() || !indices || indices->m_buffer != this) return;
+
+            core::RangeAllocator::Range* r = indices->m_range;
+            delete indices;
+
+            m_allocator.free(r);
+            if (m_factory) m_factory->onCapacityChanged(this);
+        }
+
+        u32 IndexBuffer::IndexSize(VkIndexType type) {
+            switch (type) {
+                case VK_INDEX_TYPE_UINT16: return sizeof(u16);
+                case VK_INDEX_TYPE_UINT32: return sizeof(u32);
+                default: return 0;
+            }
+        }
+
+        void IndexBuffer::freeAllIndices() {
+            m_allocator.eachAllocated([](core::RangeAllocator::Range* r) {
+                delete (Indices*)r->userData;
+            });
+
+            m_allocator.reset();
+        }
+
+
+
+        //
+        // Indices
+        //
+
+        Indices::Indices(IndexBuffer* buf, core::RangeAllocator::Range* range, u32 count) {
+            m_buffer = buf;
+            m_range = range;
+            m_count = count;
+        }
+
+        Indices::~Indices() {
+        }
+
+        u32 Indices::getOffset() const {
+            return m_range->offset;
+        }
+
+        u32 Indices::getByteOffset() const {
+            return m_range->offset * m_buffer->m_indexSize;
+        }
+
+        u32 Indices::getSize() const {
+            return m_count * m_buffer->m_indexSize;
+        }
+
+        u32 Indices::getCount() const {
+            return m_count;
+        }
+
+        VkIndexType Indices::getType() const {
+            return m_buffer->m_type;
+        }
+
+        IndexBuffer* Indices::getBuffer() const {
+            return m_buffer;
+        }
+
+        void Indices::free() {
+            m_buffer->free(this);
+        }
+
+        bool Indices::beginUpdate() {
+            if (m_buffer->m_memoryMapRefCount == 0) {
+                if (!m_buffer->m_buffer.map()) return false;
+            }
+            
+            m_buffer->m_memoryMapRefCount++;
+            return true;
+        }
+        
+        bool Indices::write(const void* data, u32 offset, u32 count) {
+            if (offset + count > m_count) return false;
+
+            return m_buffer->m_buffer.write(
+                data,
+                (m_range->offset + offset) * m_buffer->m_indexSize,
+                count * m_buffer->m_indexSize
+            );
+        }
+
+        bool Indices::commitUpdate() {
+            if (m_buffer->m_memoryMapRefCount == 0) {
+                m_buffer->m_device->getInstance()->warn("Indices::commitUpdate called more times than Indices::beginUpdate");
+                return false;
+            }
+
+            bool r = m_buffer->m_buffer.flush(getByteOffset(), getSize());
+            
+            m_buffer->m_memoryMapRefCount--;
+            if (m_buffer->m_memoryMapRefCount == 0) m_buffer->m_buffer.unmap();
+
+            return r;
+        }
+
+
+
+        //
+        // IndexBufferFactory
+        //
+
+        IndexBufferFactory::IndexBufferFactory(LogicalDevice* device, u32 minBufferCapacity) {
+            m_device = device;
+            m_minBufferCapacity = minBufferCapacity;
+        }
+
+        IndexBufferFactory::~IndexBufferFactory() {
+            freeAll();
+        }
+
+        void IndexBufferFactory::freeAll() {
+            m_u16Buffers.each([](IndexBuffer* buf) {
+                delete buf;
+            });
+            m_u16Buffers.clear();
+
+            m_u32Buffers.each([](IndexBuffer* buf) {
+                delete buf;
+            });
+            m_u32Buffers.clear();
+        }
+
+        Indices* IndexBufferFactory::allocate(VkIndexType type, u32 count) {
+            buffer_heap* buffers = getBuffers(type);
+            if (!buffers) return nullptr;
+
+            // if the buffer with the largest free range can't fit it then none of them can
+            IndexBuffer* buf = buffers->top();
+            if (buf && buf->getCurrentMaximumBlockSize() >= count) return buf->allocate(count);
+            
+            buf = new IndexBuffer(m_device, type, utils::max(m_minBufferCapacity, count));
+            if (!buf->init()) {
+                delete buf;
+                return nullptr;
+            }
+
+            buf->m_factory = this;
+            buffers->insert(buf);
+            return buf->allocate(count);
+        }
+
+        IndexBufferFactory::buffer_heap* IndexBufferFactory::getBuffers(VkIndexType type) {
+            if (type == VK_INDEX_TYPE_UINT16) return &m_u16Buffers;
+            if (type == VK_INDEX_TYPE_UINT32) return &m_u32Buffers;
+            return nullptr;
+        }
+
+        void IndexBufferFactory::onCapacityChanged(IndexBuffer* buf) {
+            buffer_heap* buffers = getBuffers(buf->m_type);
+            if (buffers) buffers->update(buf);
+        }
+    };
+};
\ No newline at end of file
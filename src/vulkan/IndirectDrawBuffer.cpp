@@ -0,0 +1,192 @@
+#include <render/vulkan/IndirectDrawBuffer.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Buffer.h>
+#include <render/vulkan/CommandBuffer.h>
+#include <render/vulkan/VertexBuffer.h>
+#include <render/vulkan/IndexBuffer.h>
+
+#include <utils/Array.hpp>
+
+namespace render {
+    namespace vulkan {
+        IndirectDrawBuffer::IndirectDrawBuffer(LogicalDevice* device, u32 frameCount, u32 maxDrawsPerFrame) : ::utils::IWithLogging("Indirect Draw Buffer") {
+            m_device = device;
+            m_buffer = nullptr;
+            m_mappedMemory = nullptr;
+            m_frameCount = frameCount;
+            m_maxDraws = maxDrawsPerFrame;
+            m_bytesPerFrame = 0;
+            m_drawRegionOffset = 0;
+            m_frameIdx = 0;
+            m_drawCount = 0;
+            m_indexedDrawCount = 0;
+            m_vertexBuffer = nullptr;
+            m_indexBuffer = nullptr;
+        }
+
+        IndirectDrawBuffer::~IndirectDrawBuffer() {
+            shutdown();
+        }
+
+        bool IndirectDrawBuffer::init() {
+            if (m_buffer || m_frameCount == 0 || m_maxDraws == 0) return false;
+
+            // | indexed commands | commands | per frame, both regions start at a multiple of the storage
+            // buffer offset alignment so either can be bound as a storage buffer
+            u64 alignment = m_device->getPhysicalDevice()->getProperties().limits.minStorageBufferOffsetAlignment;
+            if (alignment < 16) alignment = 16;
+
+            u64 indexedSize = u64(m_maxDraws) * sizeof(VkDrawIndexedIndirectCommand);
+            u64 drawSize = u64(m_maxDraws) * sizeof(VkDrawIndirectCommand);
+            m_drawRegionOffset = (indexedSize + (alignment - 1)) & ~(alignment - 1);
+            m_bytesPerFrame = (m_drawRegionOffset + drawSize + (alignment - 1)) & ~(alignment - 1);
+
+            m_buffer = new Buffer(m_device);
+            if (!m_buffer->init(
+                m_bytesPerFrame * m_frameCount,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            )) {
+                error("Failed to create %llu byte indirect draw buffer", m_bytesPerFrame * m_frameCount);
+                shutdown();
+                return false;
+            }
+
+            if (!m_buffer->map()) {
+                error("Failed to map indirect draw buffer");
+                shutdown();
+                return false;
+            }
+
+            m_mappedMemory = (u8*)m_buffer->getPointer();
+            return true;
+        }
+
+        void IndirectDrawBuffer::shutdown() {
+            if (m_buffer) {
+                delete m_buffer;
+                m_buffer = nullptr;
+            }
+
+            m_mappedMemory = nullptr;
+            m_drawCount = 0;
+            m_indexedDrawCount = 0;
+            m_vertexBuffer = nullptr;
+            m_indexBuffer = nullptr;
+        }
+
+        Buffer* IndirectDrawBuffer::getBuffer() const {
+            return m_buffer;
+        }
+
+        u32 IndirectDrawBuffer::getMaxDrawsPerFrame() const {
+            return m_maxDraws;
+        }
+
+        u32 IndirectDrawBuffer::getDrawCount() const {
+            return m_drawCount;
+        }
+
+        u32 IndirectDrawBuffer::getIndexedDrawCount() const {
+            return m_indexedDrawCount;
+        }
+
+        u64 IndirectDrawBuffer::getDrawOffset() const {
+            return u64(m_frameIdx) * m_bytesPerFrame + m_drawRegionOffset;
+        }
+
+        u64 IndirectDrawBuffer::getIndexedDrawOffset() const {
+            return u64(m_frameIdx) * m_bytesPerFrame;
+        }
+
+        void IndirectDrawBuffer::begin(u32 frameIdx) {
+            if (frameIdx >= m_frameCount) return;
+
+            m_frameIdx = frameIdx;
+            m_drawCount = 0;
+            m_indexedDrawCount = 0;
+            m_vertexBuffer = nullptr;
+            m_indexBuffer = nullptr;
+        }
+
+        bool IndirectDrawBuffer::add(Vertices* vertices, u32 instanceCount, u32 firstInstance) {
+            if (!m_mappedMemory || !vertices) return false;
+
+            if (m_drawCount == m_maxDraws) {
+                warn("Frame %d is out of indirect draw commands (%u max)", m_frameIdx, m_maxDraws);
+                return false;
+            }
+
+            if (!useBuffers(vertices->getBuffer(), nullptr, firstInstance)) return false;
+
+            VkDrawIndirectCommand* cmds = (VkDrawIndirectCommand*)(m_mappedMemory + getDrawOffset());
+            VkDrawIndirectCommand& cmd = cmds[m_drawCount++];
+            cmd.vertexCount = vertices->getCount();
+            cmd.instanceCount = instanceCount;
+            cmd.firstVertex = vertices->getOffset();
+            cmd.firstInstance = firstInstance;
+
+            return true;
+        }
+
+        bool IndirectDrawBuffer::add(Indices* indices, Vertices* vertices, u32 instanceCount, u32 firstInstance) {
+            if (!m_mappedMemory || !indices || !vertices) return false;
+
+            if (m_indexedDrawCount == m_maxDraws) {
+                warn("Frame %d is out of indexed indirect draw commands (%u max)", m_frameIdx, m_maxDraws);
+                return false;
+            }
+
+            if (!useBuffers(vertices->getBuffer(), indices->getBuffer(), firstInstance)) return false;
+
+            VkDrawIndexedIndirectCommand* cmds = (VkDrawIndexedIndirectCommand*)(m_mappedMemory + getIndexedDrawOffset());
+            VkDrawIndexedIndirectCommand& cmd = cmds[m_indexedDrawCount++];
+            cmd.indexCount = indices->getCount();
+            cmd.instanceCount = instanceCount;
+            cmd.firstIndex = indices->getOffset();
+            cmd.vertexOffset = i32(vertices->getOffset());
+            cmd.firstInstance = firstInstance;
+
+            return true;
+        }
+
+        void IndirectDrawBuffer::draw(CommandBuffer* cb) {
+            if (!m_buffer || !m_vertexBuffer) return;
+
+            cb->bindVertexBuffer(m_vertexBuffer);
+
+            if (m_drawCount > 0) {
+                cb->drawIndirect(m_buffer, getDrawOffset(), m_drawCount);
+            }
+
+            if (m_indexedDrawCount > 0) {
+                cb->bindIndexBuffer(m_indexBuffer);
+                cb->drawIndexedIndirect(m_buffer, getIndexedDrawOffset(), m_indexedDrawCount);
+            }
+        }
+
+        bool IndirectDrawBuffer::useBuffers(VertexBuffer* vbo, IndexBuffer* ibo, u32 firstInstance) {
+            if (firstInstance != 0 && !m_device->getPhysicalDevice()->getFeatures().drawIndirectFirstInstance) {
+                error("firstInstance must be 0, the device doesn't support drawIndirectFirstInstance");
+                return false;
+            }
+
+            if (m_vertexBuffer && m_vertexBuffer != vbo) {
+                error("Every range drawn from one IndirectDrawBuffer must be in the same vertex buffer");
+                return false;
+            }
+
+            if (ibo && m_indexBuffer && m_indexBuffer != ibo) {
+                error("Every indexed range drawn from one IndirectDrawBuffer must be in the same index buffer");
+                return false;
+            }
+
+            m_vertexBuffer = vbo;
+            if (ibo) m_indexBuffer = ibo;
+
+            return true;
+        }
+    };
+};
\ No newline at end of file
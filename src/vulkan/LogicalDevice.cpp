@@ -3,6 +3,8 @@
 #include <render/vulkan/PhysicalDevice.h>
 #include <render/vulkan/QueueFamily.h>
 #include <render/vulkan/Queue.h>
+#include <render/vulkan/MemoryAllocator.h>
+#include <render/vulkan/DescriptorSetLayout.h>
 
 #include <utils/Array.hpp>
 
@@ -12,9 +14,14 @@ namespace render {
             m_device = VK_NULL_HANDLE;
             m_physicalDevice = device;
             m_isInitialized = false;
+            m_bindlessEnabled = false;
+            m_drawIndirectCountEnabled = false;
             m_presentQueue = nullptr;
             m_computeQueue = nullptr;
             m_gfxQueue = nullptr;
+            m_memoryAllocator = nullptr;
+            m_layoutCache = nullptr;
+            m_pipelineCache = nullptr;
         }
 
         LogicalDevice::~LogicalDevice() {
@@ -65,6 +72,35 @@ namespace render {
             return false;
         }
 
+        bool LogicalDevice::enableBindless() {
+            if (m_isInitialized || !m_physicalDevice) return false;
+            if (m_bindlessEnabled) return true;
+            if (!m_physicalDevice->isBindlessSupported()) return false;
+
+            if (m_physicalDevice->getProperties().apiVersion < VK_API_VERSION_1_2) {
+                if (!enableExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) return false;
+            }
+
+            m_bindlessEnabled = true;
+            return true;
+        }
+
+        bool LogicalDevice::isBindlessEnabled() const {
+            return m_bindlessEnabled;
+        }
+
+        bool LogicalDevice::enableDrawIndirectCount() {
+            if (m_isInitialized || !m_physicalDevice) return false;
+            if (!m_physicalDevice->isDrawIndirectCountSupported()) return false;
+
+            m_drawIndirectCountEnabled = true;
+            return true;
+        }
+
+        bool LogicalDevice::isDrawIndirectCountEnabled() const {
+            return m_drawIndirectCountEnabled;
+        }
+
         bool LogicalDevice::waitForIdle() const {
             if (!m_isInitialized) return true;
             return vkDeviceWaitIdle(m_device) == VK_SUCCESS;
@@ -91,6 +127,10 @@ namespace render {
             VkPhysicalDeviceFeatures df = {};
             df.samplerAnisotropy = VK_TRUE;
 
+            // without these CommandBuffer falls back to one indirect draw per command
+            df.multiDrawIndirect = m_physicalDevice->getFeatures().multiDrawIndirect;
+            df.drawIndirectFirstInstance = m_physicalDevice->getFeatures().drawIndirectFirstInstance;
+
             VkDeviceCreateInfo di = {};
             di.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
             di.pQueueCreateInfos = queueInfo;
@@ -101,6 +141,38 @@ namespace render {
             di.enabledLayerCount = m_enabledLayers.size();
             di.ppEnabledLayerNames = m_enabledLayers.data();
 
+            VkPhysicalDeviceDescriptorIndexingFeatures dif = {};
+            VkPhysicalDeviceVulkan12Features v12 = {};
+
+            if (m_drawIndirectCountEnabled) {
+                // the 1.2 feature struct can't be chained alongside the descriptor indexing one, so
+                // when it's needed the bindless features go in it as well
+                v12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+                v12.drawIndirectCount = VK_TRUE;
+
+                if (m_bindlessEnabled) {
+                    v12.runtimeDescriptorArray = VK_TRUE;
+                    v12.descriptorBindingPartiallyBound = VK_TRUE;
+                    v12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+                    v12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                    v12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                    v12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+                    v12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+                }
+
+                di.pNext = &v12;
+            } else if (m_bindlessEnabled) {
+                dif.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+                dif.runtimeDescriptorArray = VK_TRUE;
+                dif.descriptorBindingPartiallyBound = VK_TRUE;
+                dif.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+                dif.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                dif.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                dif.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+                dif.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+                di.pNext = &dif;
+            }
+
             if (vkCreateDevice(m_physicalDevice->get(), &di, getInstance()->getAllocator(), &m_device) != VK_SUCCESS) {
                 return false;
             }
@@ -128,6 +200,9 @@ namespace render {
                 }
             }
 
+            m_memoryAllocator = new MemoryAllocator(this);
+            m_layoutCache = new DescriptorSetLayoutCache(this);
+
             m_isInitialized = true;
             return true;
         }
@@ -140,6 +215,16 @@ namespace render {
             m_presentQueue = nullptr;
             m_gfxQueue = nullptr;
 
+            if (m_layoutCache) {
+                delete m_layoutCache;
+                m_layoutCache = nullptr;
+            }
+
+            if (m_memoryAllocator) {
+                delete m_memoryAllocator;
+                m_memoryAllocator = nullptr;
+            }
+
             vkDestroyDevice(m_device, getInstance()->getAllocator());
             m_isInitialized = false;
         }
@@ -158,6 +243,22 @@ namespace render {
             return m_physicalDevice->getInstance();
         }
         
+        MemoryAllocator* LogicalDevice::getMemoryAllocator() const {
+            return m_memoryAllocator;
+        }
+
+        DescriptorSetLayoutCache* LogicalDevice::getDescriptorSetLayoutCache() const {
+            return m_layoutCache;
+        }
+
+        PipelineCache* LogicalDevice::getPipelineCache() const {
+            return m_pipelineCache;
+        }
+
+        void LogicalDevice::setPipelineCache(PipelineCache* cache) {
+            m_pipelineCache = cache;
+        }
+
         const Array<Queue*>& LogicalDevice::getQueues() const {
             return m_queues;
         }
@@ -0,0 +1,512 @@
+#include <render/vulkan/MemoryAllocator.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Instance.h>
+
+#include <utils/Array.hpp>
+
+#include <bit>
+
+namespace render {
+    namespace vulkan {
+        constexpr u64 MIN_SPLIT_SIZE = 64;
+        constexpr u64 LARGE_HEAP_BLOCK_SIZE = 64 * 1024 * 1024;
+        constexpr u64 SMALL_HEAP_MAX_SIZE = 1024 * 1024 * 1024;
+
+        static u64 alignUp(u64 value, u64 alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        //
+        // MemoryBlock
+        //
+
+        MemoryBlock::MemoryBlock(MemoryAllocator* allocator, u32 memoryTypeIndex, u64 size, bool isDedicated) {
+            m_allocator = allocator;
+            m_memory = VK_NULL_HANDLE;
+            m_memoryTypeIndex = memoryTypeIndex;
+            m_size = size;
+            m_usedSize = 0;
+            m_allocationCount = 0;
+            m_isDedicated = isDedicated;
+            m_mappedMemory = nullptr;
+            m_flBitmap = 0;
+            m_physHead = nullptr;
+            m_unusedNodes = nullptr;
+
+            for (u32 fl = 0;fl < FL_COUNT;fl++) {
+                m_slBitmap[fl] = 0;
+                for (u32 sl = 0;sl < SL_COUNT;sl++) m_freeHeads[fl][sl] = nullptr;
+            }
+        }
+
+        MemoryBlock::~MemoryBlock() {
+            shutdown();
+        }
+
+        bool MemoryBlock::init() {
+            if (m_memory) return false;
+
+            LogicalDevice* device = m_allocator->getDevice();
+
+            VkMemoryAllocateInfo ai = {};
+            ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            ai.allocationSize = m_size;
+            ai.memoryTypeIndex = m_memoryTypeIndex;
+
+            if (vkAllocateMemory(device->get(), &ai, device->getInstance()->getAllocator(), &m_memory) != VK_SUCCESS) {
+                device->getInstance()->error("Failed to allocate %llu byte memory block (memory type %d)", m_size, m_memoryTypeIndex);
+                m_memory = VK_NULL_HANDLE;
+                return false;
+            }
+
+            node* n = getNode();
+            n->offset = 0;
+            n->size = m_size;
+            n->prevPhys = nullptr;
+            n->nextPhys = nullptr;
+            m_physHead = n;
+            insertFree(n);
+
+            return true;
+        }
+
+        void MemoryBlock::shutdown() {
+            if (m_memory) {
+                LogicalDevice* device = m_allocator->getDevice();
+                if (m_mappedMemory) vkUnmapMemory(device->get(), m_memory);
+                vkFreeMemory(device->get(), m_memory, device->getInstance()->getAllocator());
+                m_memory = VK_NULL_HANDLE;
+            }
+
+            node* n = m_physHead;
+            while (n) {
+                node* next = n->nextPhys;
+                delete n;
+                n = next;
+            }
+
+            n = m_unusedNodes;
+            while (n) {
+                node* next = n->nextFree;
+                delete n;
+                n = next;
+            }
+
+            m_physHead = nullptr;
+            m_unusedNodes = nullptr;
+            m_mappedMemory = nullptr;
+            m_usedSize = 0;
+            m_allocationCount = 0;
+            m_flBitmap = 0;
+
+            for (u32 fl = 0;fl < FL_COUNT;fl++) {
+                m_slBitmap[fl] = 0;
+                for (u32 sl = 0;sl < SL_COUNT;sl++) m_freeHeads[fl][sl] = nullptr;
+            }
+        }
+
+        VkDeviceMemory MemoryBlock::get() const {
+            return m_memory;
+        }
+
+        u32 MemoryBlock::getMemoryTypeIndex() const {
+            return m_memoryTypeIndex;
+        }
+
+        u64 MemoryBlock::getSize() const {
+            return m_size;
+        }
+
+        u64 MemoryBlock::getUsedSize() const {
+            return m_usedSize;
+        }
+
+        u32 MemoryBlock::getAllocationCount() const {
+            return m_allocationCount;
+        }
+
+        bool MemoryBlock::isDedicated() const {
+            return m_isDedicated;
+        }
+
+        bool MemoryBlock::isEmpty() const {
+            return m_allocationCount == 0;
+        }
+
+        bool MemoryBlock::allocate(u64 size, u64 alignment, MemoryAllocation& out) {
+            if (!m_memory || size == 0 || size > m_size - m_usedSize) return false;
+
+            node* n = findFree(size);
+            if (n && alignUp(n->offset, alignment) + size > n->offset + n->size) n = nullptr;
+            if (!n && alignment > 1) n = findFree(size + alignment - 1);
+            if (!n) return false;
+
+            removeFree(n);
+
+            u64 alignedOffset = alignUp(n->offset, alignment);
+            u64 padding = alignedOffset - n->offset;
+            if (padding > 0) {
+                // previous physical node can't be free, free nodes are always coalesced
+                node* p = getNode();
+                p->offset = n->offset;
+                p->size = padding;
+                p->prevPhys = n->prevPhys;
+                p->nextPhys = n;
+                if (n->prevPhys) n->prevPhys->nextPhys = p;
+                else m_physHead = p;
+                n->prevPhys = p;
+                n->offset += padding;
+                n->size -= padding;
+                insertFree(p);
+            }
+
+            if (n->size - size >= MIN_SPLIT_SIZE) {
+                node* t = getNode();
+                t->offset = n->offset + size;
+                t->size = n->size - size;
+                t->prevPhys = n;
+                t->nextPhys = n->nextPhys;
+                if (n->nextPhys) n->nextPhys->prevPhys = t;
+                n->nextPhys = t;
+                n->size = size;
+                insertFree(t);
+            }
+
+            n->isFree = false;
+            m_usedSize += n->size;
+            m_allocationCount++;
+
+            out.memory = m_memory;
+            out.offset = n->offset;
+            out.size = size;
+            out.memoryTypeIndex = m_memoryTypeIndex;
+            out.block = this;
+            out.node = n;
+
+            return true;
+        }
+
+        void MemoryBlock::free(const MemoryAllocation& allocation) {
+            node* n = (node*)allocation.node;
+            if (!n || n->isFree) return;
+
+            m_usedSize -= n->size;
+            m_allocationCount--;
+
+            node* next = n->nextPhys;
+            if (next && next->isFree) {
+                removeFree(next);
+                n->size += next->size;
+                n->nextPhys = next->nextPhys;
+                if (next->nextPhys) next->nextPhys->prevPhys = n;
+                releaseNode(next);
+            }
+
+            node* prev = n->prevPhys;
+            if (prev && prev->isFree) {
+                removeFree(prev);
+                prev->size += n->size;
+                prev->nextPhys = n->nextPhys;
+                if (n->nextPhys) n->nextPhys->prevPhys = prev;
+                releaseNode(n);
+                n = prev;
+            }
+
+            insertFree(n);
+        }
+
+        void* MemoryBlock::map() {
+            if (m_mappedMemory) return m_mappedMemory;
+            if (!m_memory) return nullptr;
+
+            LogicalDevice* device = m_allocator->getDevice();
+            if (vkMapMemory(device->get(), m_memory, 0, VK_WHOLE_SIZE, 0, &m_mappedMemory) != VK_SUCCESS) {
+                m_mappedMemory = nullptr;
+                return nullptr;
+            }
+
+            return m_mappedMemory;
+        }
+
+        void MemoryBlock::getStats(MemoryHeapStats& stats) const {
+            stats.blockCount++;
+            stats.allocationCount += m_allocationCount;
+            stats.bytesReserved += m_size;
+            stats.bytesUsed += m_usedSize;
+
+            node* n = m_physHead;
+            while (n) {
+                if (n->isFree) {
+                    stats.freeRangeCount++;
+                    stats.bytesFree += n->size;
+                    if (n->size > stats.largestFreeRange) stats.largestFreeRange = n->size;
+                }
+
+                n = n->nextPhys;
+            }
+        }
+
+        void MemoryBlock::mapSize(u64 size, u32& fl, u32& sl) {
+            fl = 63 - u32(std::countl_zero(size));
+            if (fl < SL_BITS) sl = u32(size << (SL_BITS - fl)) ^ SL_COUNT;
+            else sl = u32(size >> (fl - SL_BITS)) ^ SL_COUNT;
+        }
+
+        MemoryBlock::node* MemoryBlock::findFree(u64 size) {
+            // round up to the next list boundary so any node found is guaranteed to fit
+            u32 fl = 63 - u32(std::countl_zero(size));
+            if (fl >= SL_BITS) size += (u64(1) << (fl - SL_BITS)) - 1;
+
+            u32 sl;
+            mapSize(size, fl, sl);
+
+            u32 slMap = m_slBitmap[fl] & (~u32(0) << sl);
+            if (!slMap) {
+                u64 flMap = (fl + 1 < FL_COUNT) ? (m_flBitmap & (~u64(0) << (fl + 1))) : 0;
+                if (!flMap) return nullptr;
+
+                fl = u32(std::countr_zero(flMap));
+                slMap = m_slBitmap[fl];
+            }
+
+            sl = u32(std::countr_zero(slMap));
+            return m_freeHeads[fl][sl];
+        }
+
+        void MemoryBlock::insertFree(node* n) {
+            u32 fl, sl;
+            mapSize(n->size, fl, sl);
+
+            n->isFree = true;
+            n->prevFree = nullptr;
+            n->nextFree = m_freeHeads[fl][sl];
+            if (n->nextFree) n->nextFree->prevFree = n;
+            m_freeHeads[fl][sl] = n;
+
+            m_flBitmap |= u64(1) << fl;
+            m_slBitmap[fl] |= u32(1) << sl;
+        }
+
+        void MemoryBlock::removeFree(node* n) {
+            u32 fl, sl;
+            mapSize(n->size, fl, sl);
+
+            if (n->prevFree) n->prevFree->nextFree = n->nextFree;
+            else m_freeHeads[fl][sl] = n->nextFree;
+            if (n->nextFree) n->nextFree->prevFree = n->prevFree;
+
+            n->isFree = false;
+            n->prevFree = n->nextFree = nullptr;
+
+            if (!m_freeHeads[fl][sl]) {
+                m_slBitmap[fl] &= ~(u32(1) << sl);
+                if (!m_slBitmap[fl]) m_flBitmap &= ~(u64(1) << fl);
+            }
+        }
+
+        MemoryBlock::node* MemoryBlock::getNode() {
+            node* n = m_unusedNodes;
+            if (n) m_unusedNodes = n->nextFree;
+            else n = new node();
+
+            n->offset = 0;
+            n->size = 0;
+            n->isFree = false;
+            n->prevPhys = n->nextPhys = nullptr;
+            n->prevFree = n->nextFree = nullptr;
+            return n;
+        }
+
+        void MemoryBlock::releaseNode(node* n) {
+            n->prevPhys = n->nextPhys = nullptr;
+            n->prevFree = nullptr;
+            n->nextFree = m_unusedNodes;
+            m_unusedNodes = n;
+        }
+
+
+
+
+        //
+        // MemoryAllocator
+        //
+
+        MemoryAllocator::MemoryAllocator(LogicalDevice* device) {
+            m_device = device;
+        }
+
+        MemoryAllocator::~MemoryAllocator() {
+            shutdown();
+        }
+
+        LogicalDevice* MemoryAllocator::getDevice() const {
+            return m_device;
+        }
+
+        u64 MemoryAllocator::getPreferredBlockSize(u32 memoryTypeIndex) const {
+            const VkPhysicalDeviceMemoryProperties& props = m_device->getPhysicalDevice()->getMemoryProperties();
+            u64 heapSize = props.memoryHeaps[props.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+            if (heapSize <= SMALL_HEAP_MAX_SIZE) return alignUp(heapSize / 8, 32);
+            return LARGE_HEAP_BLOCK_SIZE;
+        }
+
+        bool MemoryAllocator::allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags flags, bool isLinear, MemoryAllocation& out) {
+            out = {};
+
+            PhysicalDevice* physicalDevice = m_device->getPhysicalDevice();
+
+            u32 typeIdx = 0;
+            if (!physicalDevice->getMemoryTypeIndex(reqs, flags, &typeIdx)) {
+                m_device->getInstance()->error("Failed to find memory type for allocation (flags: 0x%X)", flags);
+                return false;
+            }
+
+            u64 size = reqs.size;
+            u64 alignment = utils::max(reqs.alignment, VkDeviceSize(1));
+
+            // Non-coherent memory is flushed/invalidated in nonCoherentAtomSize units, keep those units
+            // from straddling neighboring allocations
+            VkMemoryPropertyFlags typeFlags = physicalDevice->getMemoryProperties().memoryTypes[typeIdx].propertyFlags;
+            if ((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+                u64 atomSize = physicalDevice->getProperties().limits.nonCoherentAtomSize;
+                if (atomSize > 1) {
+                    alignment = utils::max(alignment, atomSize);
+                    size = alignUp(size, atomSize);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            Array<MemoryBlock*>& blocks = m_blocks[typeIdx][isLinear ? 0 : 1];
+            u64 blockSize = getPreferredBlockSize(typeIdx);
+
+            if (size > blockSize / 2) {
+                MemoryBlock* b = new MemoryBlock(this, typeIdx, size, true);
+                if (!b->init()) {
+                    delete b;
+                    return false;
+                }
+
+                if (!b->allocate(size, 1, out)) {
+                    delete b;
+                    return false;
+                }
+
+                out.size = reqs.size;
+                out.isLinear = isLinear;
+                blocks.push(b);
+                return true;
+            }
+
+            for (u32 i = 0;i < blocks.size();i++) {
+                if (blocks[i]->isDedicated()) continue;
+                if (blocks[i]->allocate(size, alignment, out)) {
+                    out.size = reqs.size;
+                    out.isLinear = isLinear;
+                    return true;
+                }
+            }
+
+            MemoryBlock* b = new MemoryBlock(this, typeIdx, blockSize, false);
+            if (!b->init()) {
+                delete b;
+                return false;
+            }
+
+            blocks.push(b);
+
+            if (!b->allocate(size, alignment, out)) return false;
+
+            out.size = reqs.size;
+            out.isLinear = isLinear;
+            return true;
+        }
+
+        void MemoryAllocator::free(MemoryAllocation& allocation) {
+            if (!allocation.block) return;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            MemoryBlock* block = allocation.block;
+            bool isLinear = allocation.isLinear;
+            block->free(allocation);
+            allocation = {};
+
+            if (!block->isEmpty()) return;
+
+            // Keep a single empty block around per list to avoid thrashing vkAllocateMemory
+            Array<MemoryBlock*>& blocks = m_blocks[block->getMemoryTypeIndex()][isLinear ? 0 : 1];
+            i64 idx = blocks.findIndex([block](MemoryBlock* b) { return b == block; });
+            if (idx == -1) return;
+
+            bool release = block->isDedicated() || blocks.some([block](MemoryBlock* b) {
+                return b != block && !b->isDedicated() && b->isEmpty();
+            });
+
+            if (!release) return;
+
+            blocks.remove(u32(idx));
+            delete block;
+        }
+
+        void* MemoryAllocator::map(const MemoryAllocation& allocation) {
+            if (!allocation.block) return nullptr;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            u8* ptr = (u8*)allocation.block->map();
+            if (!ptr) return nullptr;
+
+            return ptr + allocation.offset;
+        }
+
+        bool MemoryAllocator::getHeapStats(u32 heapIndex, MemoryHeapStats& out) {
+            out = {};
+
+            const VkPhysicalDeviceMemoryProperties& props = m_device->getPhysicalDevice()->getMemoryProperties();
+            if (heapIndex >= props.memoryHeapCount) return false;
+
+            out.heapSize = props.memoryHeaps[heapIndex].size;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (u32 t = 0;t < props.memoryTypeCount;t++) {
+                if (props.memoryTypes[t].heapIndex != heapIndex) continue;
+
+                for (u32 l = 0;l < 2;l++) {
+                    m_blocks[t][l].each([&out](MemoryBlock* b) {
+                        b->getStats(out);
+                    });
+                }
+            }
+
+            if (out.bytesFree > 0) out.fragmentation = 1.0f - (f32(out.largestFreeRange) / f32(out.bytesFree));
+
+            return true;
+        }
+
+        u32 MemoryAllocator::getHeapCount() const {
+            return m_device->getPhysicalDevice()->getMemoryProperties().memoryHeapCount;
+        }
+
+        void MemoryAllocator::shutdown() {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            for (u32 t = 0;t < VK_MAX_MEMORY_TYPES;t++) {
+                for (u32 l = 0;l < 2;l++) {
+                    m_blocks[t][l].each([this](MemoryBlock* b) {
+                        if (!b->isEmpty()) {
+                            m_device->getInstance()->warn(
+                                "Releasing memory block with %d live allocation(s) (memory type %d)",
+                                b->getAllocationCount(),
+                                b->getMemoryTypeIndex()
+                            );
+                        }
+
+                        delete b;
+                    });
+
+                    m_blocks[t][l].clear();
+                }
+            }
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <render/vulkan/ParallelRecorder.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/CommandPool.h>
+#include <render/vulkan/CommandBuffer.h>
+#include <render/vulkan/Queue.h>
+
+#include <utils/Array.hpp>
+
+namespace render {
+    namespace vulkan {
+        ParallelRecorder::ParallelRecorder(LogicalDevice* device, u32 frameCount, u32 workerCount) : ::utils::IWithLogging("Parallel Recorder") {
+            m_device = device;
+            m_frameCount = frameCount > 0 ? frameCount : 1;
+            m_workerCount = workerCount;
+            if (m_workerCount == 0) {
+                u32 hwThreads = std::thread::hardware_concurrency();
+                m_workerCount = hwThreads > 1 ? hwThreads - 1 : 1;
+            }
+
+            m_renderPass = nullptr;
+            m_framebuffer = nullptr;
+            m_subpass = 0;
+            m_frameIdx = 0;
+            m_isRecording = false;
+            m_isStopping = false;
+            m_nextTask = 0;
+            m_pendingTasks = 0;
+        }
+
+        ParallelRecorder::~ParallelRecorder() {
+            shutdown();
+        }
+
+        bool ParallelRecorder::init() {
+            if (m_workers.size() > 0) return false;
+
+            u32 threadCount = m_workerCount + 1;
+            m_pools.reserve(m_frameCount * threadCount);
+
+            for (u32 i = 0;i < m_frameCount * threadCount;i++) {
+                CommandPool* pool = new CommandPool(m_device, &m_device->getGraphicsQueue()->getFamily());
+                if (!pool->init(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)) {
+                    delete pool;
+                    error("Failed to create command pool for recording thread");
+                    shutdown();
+                    return false;
+                }
+
+                m_pools.push({});
+                auto& p = m_pools.last();
+                p.pool = pool;
+                p.usedBuffers = 0;
+            }
+
+            m_isStopping = false;
+            for (u32 i = 0;i < m_workerCount;i++) {
+                m_workers.emplace_back(&ParallelRecorder::workerMain, this, i);
+            }
+
+            return true;
+        }
+
+        void ParallelRecorder::shutdown() {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_isStopping = true;
+            }
+
+            m_workAvailable.notify_all();
+
+            for (u32 i = 0;i < m_workers.size();i++) m_workers[i].join();
+            m_workers.clear();
+
+            // buffers are owned by their pools
+            for (u32 i = 0;i < m_pools.size();i++) delete m_pools[i].pool;
+            m_pools.clear();
+
+            m_tasks.clear();
+            m_executeList.clear();
+            m_isRecording = false;
+            m_nextTask = 0;
+            m_pendingTasks = 0;
+        }
+
+        u32 ParallelRecorder::getWorkerCount() const {
+            return m_workerCount;
+        }
+
+        bool ParallelRecorder::begin(u32 frameIdx, RenderPass* pass, Framebuffer* target, u32 subpass) {
+            if (m_isRecording || m_pools.size() == 0 || frameIdx >= m_frameCount) return false;
+
+            u32 threadCount = m_workerCount + 1;
+            for (u32 i = 0;i < threadCount;i++) {
+                thread_pool& p = m_pools[frameIdx * threadCount + i];
+                if (p.usedBuffers == 0) continue;
+
+                if (!p.pool->reset()) {
+                    error("Failed to reset command pool for frame %u", frameIdx);
+                    return false;
+                }
+
+                p.usedBuffers = 0;
+            }
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_renderPass = pass;
+            m_framebuffer = target;
+            m_subpass = subpass;
+            m_frameIdx = frameIdx;
+            m_tasks.clear();
+            m_nextTask = 0;
+            m_pendingTasks = 0;
+            m_isRecording = true;
+
+            return true;
+        }
+
+        void ParallelRecorder::submit(RecordFunc task) {
+            if (!m_isRecording) return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_tasks.push_back({ task, nullptr });
+                m_pendingTasks++;
+            }
+
+            m_workAvailable.notify_one();
+        }
+
+        bool ParallelRecorder::end(CommandBuffer* primary) {
+            if (!m_isRecording) return false;
+
+            {
+                std::unique_lock<std::mutex> lock(m_lock);
+
+                // the calling thread records too instead of just waiting
+                while (runNextTask(m_workerCount, lock));
+                m_taskFinished.wait(lock, [this]() { return m_pendingTasks == 0; });
+
+                m_executeList.clear(false);
+                for (u32 i = 0;i < m_tasks.size();i++) {
+                    if (m_tasks[i].buffer) m_executeList.push(m_tasks[i].buffer->get());
+                }
+
+                m_tasks.clear();
+                m_nextTask = 0;
+                m_isRecording = false;
+            }
+
+            primary->executeCommands(m_executeList.size(), m_executeList.data());
+
+            return true;
+        }
+
+        void ParallelRecorder::workerMain(u32 threadIdx) {
+            std::unique_lock<std::mutex> lock(m_lock);
+
+            while (true) {
+                m_workAvailable.wait(lock, [this]() { return m_isStopping || m_nextTask < m_tasks.size(); });
+                if (m_isStopping) break;
+
+                runNextTask(threadIdx, lock);
+            }
+        }
+
+        bool ParallelRecorder::runNextTask(u32 threadIdx, std::unique_lock<std::mutex>& lock) {
+            if (m_nextTask >= m_tasks.size()) return false;
+
+            u32 taskIdx = m_nextTask++;
+            RecordFunc func = m_tasks[taskIdx].func;
+
+            lock.unlock();
+
+            CommandBuffer* cb = acquireBuffer(threadIdx);
+            if (cb && cb->beginSecondary(m_renderPass, m_framebuffer, m_subpass)) {
+                func(cb);
+                if (!cb->end()) cb = nullptr;
+            } else {
+                error("Failed to begin secondary command buffer");
+                cb = nullptr;
+            }
+
+            lock.lock();
+
+            m_tasks[taskIdx].buffer = cb;
+            m_pendingTasks--;
+            if (m_pendingTasks == 0) m_taskFinished.notify_all();
+
+            return true;
+        }
+
+        CommandBuffer* ParallelRecorder::acquireBuffer(u32 threadIdx) {
+            // only ever touched by the thread that owns it
+            thread_pool& p = m_pools[m_frameIdx * (m_workerCount + 1) + threadIdx];
+
+            if (p.usedBuffers == p.buffers.size()) {
+                CommandBuffer* cb = p.pool->createBuffer(false);
+                if (!cb) return nullptr;
+                p.buffers.push(cb);
+            }
+
+            return p.buffers[p.usedBuffers++];
+        }
+    };
+};
\ No newline at end of file
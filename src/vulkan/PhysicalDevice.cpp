@@ -13,6 +13,9 @@ namespace render {
             m_handle = VK_NULL_HANDLE;
             m_props = {};
             m_features = {};
+            m_indexingFeatures = {};
+            m_indexingProps = {};
+            m_drawIndirectCountSupported = false;
         }
 
         PhysicalDevice::PhysicalDevice(const PhysicalDevice& dev) {
@@ -21,6 +24,9 @@ namespace render {
             m_props = dev.m_props;
             m_memoryProps = dev.m_memoryProps;
             m_features = dev.m_features;
+            m_indexingFeatures = dev.m_indexingFeatures;
+            m_indexingProps = dev.m_indexingProps;
+            m_drawIndirectCountSupported = dev.m_drawIndirectCountSupported;
             m_availableExtensions = dev.m_availableExtensions;
             m_availableLayers = dev.m_availableLayers;
         }
@@ -126,7 +132,7 @@ namespace render {
 
             i32 memTypeIdx = -1;
             for (u32 i = 0;i < m_memoryProps.memoryTypeCount;i++) {
-                if ((reqs.memoryTypeBits * (1 << i)) && (m_memoryProps.memoryTypes[i].propertyFlags & flags) == flags) {
+                if ((reqs.memoryTypeBits & (1 << i)) && (m_memoryProps.memoryTypes[i].propertyFlags & flags) == flags) {
                     memTypeIdx = i;
                     break;
                 }
@@ -153,7 +159,30 @@ namespace render {
         const VkPhysicalDeviceFeatures& PhysicalDevice::getFeatures() const {
             return m_features;
         }
+
+        const VkPhysicalDeviceDescriptorIndexingFeatures& PhysicalDevice::getDescriptorIndexingFeatures() const {
+            return m_indexingFeatures;
+        }
+
+        const VkPhysicalDeviceDescriptorIndexingProperties& PhysicalDevice::getDescriptorIndexingProperties() const {
+            return m_indexingProps;
+        }
+
+        bool PhysicalDevice::isBindlessSupported() const {
+            const auto& f = m_indexingFeatures;
+            return f.runtimeDescriptorArray
+                && f.descriptorBindingPartiallyBound
+                && f.descriptorBindingUpdateUnusedWhilePending
+                && f.descriptorBindingSampledImageUpdateAfterBind
+                && f.descriptorBindingStorageBufferUpdateAfterBind
+                && f.shaderSampledImageArrayNonUniformIndexing
+                && f.shaderStorageBufferArrayNonUniformIndexing;
+        }
         
+        bool PhysicalDevice::isDrawIndirectCountSupported() const {
+            return m_drawIndirectCountSupported;
+        }
+
         Instance* PhysicalDevice::getInstance() const {
             return m_instance;
         }
@@ -210,6 +239,33 @@ namespace render {
                     delete [] devices;
                     return {};
                 }
+
+                // descriptor indexing is core in 1.2, older devices may still expose it as an extension
+                if (dev.m_props.apiVersion >= VK_API_VERSION_1_2 || dev.isExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+                    dev.m_indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+                    VkPhysicalDeviceFeatures2 f2 = {};
+                    f2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                    f2.pNext = &dev.m_indexingFeatures;
+                    vkGetPhysicalDeviceFeatures2(devices[i], &f2);
+                    dev.m_indexingFeatures.pNext = nullptr;
+
+                    dev.m_indexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+                    VkPhysicalDeviceProperties2 p2 = {};
+                    p2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+                    p2.pNext = &dev.m_indexingProps;
+                    vkGetPhysicalDeviceProperties2(devices[i], &p2);
+                    dev.m_indexingProps.pNext = nullptr;
+                }
+
+                if (dev.m_props.apiVersion >= VK_API_VERSION_1_2) {
+                    VkPhysicalDeviceVulkan12Features v12 = {};
+                    v12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+                    VkPhysicalDeviceFeatures2 f2 = {};
+                    f2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                    f2.pNext = &v12;
+                    vkGetPhysicalDeviceFeatures2(devices[i], &f2);
+                    dev.m_drawIndirectCountSupported = v12.drawIndirectCount == VK_TRUE;
+                }
             }
 
             delete [] devices;
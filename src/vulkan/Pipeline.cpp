@@ -1,4 +1,12 @@
 #include <render/vulkan/Pipeline.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Instance.h>
+#include <render/vulkan/DescriptorSetLayout.h>
+#include <render/vulkan/BindlessTable.h>
+#include <render/core/DataFormat.h>
+
+#include <utils/Array.hpp>
 
 namespace render {
     namespace vulkan {
@@ -6,7 +14,9 @@ namespace render {
             m_device = device;
             m_layout = VK_NULL_HANDLE;
             m_pipeline = VK_NULL_HANDLE;
-            m_descriptorSetLayout = VK_NULL_HANDLE;
+            m_descriptorSetLayout = nullptr;
+            m_bindless = nullptr;
+            m_pushConstantSize = 0;
         }
 
         Pipeline::~Pipeline() {
@@ -21,7 +31,77 @@ namespace render {
         }
 
         VkDescriptorSetLayout Pipeline::getDescriptorSetLayout() const {
+            if (!m_descriptorSetLayout) return VK_NULL_HANDLE;
+            return m_descriptorSetLayout->get();
+        }
+
+        DescriptorSetLayout* Pipeline::getSetLayout() const {
             return m_descriptorSetLayout;
         }
+
+        void Pipeline::setBindlessTable(BindlessTable* table) {
+            if (m_layout) return;
+            m_bindless = table;
+        }
+
+        BindlessTable* Pipeline::getBindlessTable() const {
+            return m_bindless;
+        }
+
+        u32 Pipeline::getDescriptorSetIndex() const {
+            return m_bindless ? 1 : 0;
+        }
+
+        u32 Pipeline::addPushConstantRange(VkShaderStageFlags stages, const core::DataFormat* fmt) {
+            if (m_layout) return InvalidPushConstantRange;
+
+            // push_constant blocks use the std430 layout
+            return addPushConstantRange(stages, fmt->getStorageBlockSize());
+        }
+
+        u32 Pipeline::addPushConstantRange(VkShaderStageFlags stages, u32 size) {
+            // the pipeline layout was already created with the existing ranges
+            if (m_layout) return InvalidPushConstantRange;
+
+            // offsets and sizes of push constant ranges must be multiples of 4
+            size = (size + 3) & ~3u;
+
+            m_pushConstantRanges.push({
+                stages,
+                m_pushConstantSize,
+                size
+            });
+
+            m_pushConstantSize += size;
+            return m_pushConstantRanges.size() - 1;
+        }
+
+        const Array<VkPushConstantRange>& Pipeline::getPushConstantRanges() const {
+            return m_pushConstantRanges;
+        }
+
+        u32 Pipeline::getPushConstantSize() const {
+            return m_pushConstantSize;
+        }
+
+        u32 Pipeline::getSetLayouts(VkDescriptorSetLayout* out) const {
+            u32 count = 0;
+            if (m_bindless) out[count++] = m_bindless->getLayout();
+            if (m_descriptorSetLayout) out[count++] = m_descriptorSetLayout->get();
+            return count;
+        }
+
+        bool Pipeline::validatePushConstants() const {
+            u32 maxSize = m_device->getPhysicalDevice()->getProperties().limits.maxPushConstantsSize;
+            if (m_pushConstantSize <= maxSize) return true;
+
+            m_device->getInstance()->error(
+                "Pipeline push constant ranges use %d bytes, but the device only supports %d",
+                m_pushConstantSize,
+                maxSize
+            );
+
+            return false;
+        }
     };
 };
\ No newline at end of file
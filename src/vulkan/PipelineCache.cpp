@@ -0,0 +1,156 @@
+#include <render/vulkan/PipelineCache.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Instance.h>
+
+#include <utils/Array.hpp>
+
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+namespace render {
+    namespace vulkan {
+        PipelineCache::PipelineCache(LogicalDevice* device) {
+            m_device = device;
+            m_cache = VK_NULL_HANDLE;
+        }
+
+        PipelineCache::~PipelineCache() {
+            shutdown();
+        }
+
+        LogicalDevice* PipelineCache::getDevice() const {
+            return m_device;
+        }
+
+        VkPipelineCache PipelineCache::get() const {
+            return m_cache;
+        }
+
+        const String& PipelineCache::getPath() const {
+            return m_path;
+        }
+
+        bool PipelineCache::init(const String& path) {
+            if (m_cache) return false;
+
+            m_path = path;
+
+            Array<u8> data;
+            if (m_path.size() > 0 && loadData(data) && !isCompatible(data.data(), data.size())) {
+                m_device->getInstance()->log("Pipeline cache '%s' is stale or from another device, discarding it", m_path.c_str());
+                data.clear();
+            }
+
+            VkPipelineCacheCreateInfo ci = {};
+            ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            ci.initialDataSize = data.size();
+            ci.pInitialData = data.size() > 0 ? data.data() : nullptr;
+
+            VkResult result = vkCreatePipelineCache(m_device->get(), &ci, m_device->getInstance()->getAllocator(), &m_cache);
+            if (result != VK_SUCCESS && data.size() > 0) {
+                // the driver can still reject data that passed the header check
+                m_device->getInstance()->warn("Failed to create pipeline cache from '%s', starting with an empty cache", m_path.c_str());
+                ci.initialDataSize = 0;
+                ci.pInitialData = nullptr;
+                result = vkCreatePipelineCache(m_device->get(), &ci, m_device->getInstance()->getAllocator(), &m_cache);
+            }
+
+            if (result != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to create pipeline cache");
+                m_cache = VK_NULL_HANDLE;
+                return false;
+            }
+
+            return true;
+        }
+
+        bool PipelineCache::save() {
+            if (!m_cache || m_path.size() == 0) return false;
+
+            size_t size = 0;
+            if (vkGetPipelineCacheData(m_device->get(), m_cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+                return false;
+            }
+
+            Array<u8> data;
+            data.reserve(u32(size));
+            for (size_t i = 0;i < size;i++) data.push(0);
+
+            if (vkGetPipelineCacheData(m_device->get(), m_cache, &size, data.data()) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to retrieve pipeline cache data");
+                return false;
+            }
+
+            std::error_code ec;
+            std::filesystem::path outPath(m_path.c_str());
+            if (outPath.has_parent_path()) std::filesystem::create_directories(outPath.parent_path(), ec);
+
+            String tmpPath = String::Format("%s.tmp", m_path.c_str());
+            FILE* fp = fopen(tmpPath.c_str(), "wb");
+            if (!fp) {
+                m_device->getInstance()->error("Failed to open '%s' for writing", tmpPath.c_str());
+                return false;
+            }
+
+            bool written = fwrite(data.data(), 1, size, fp) == size;
+            fclose(fp);
+
+            if (written) std::filesystem::rename(tmpPath.c_str(), m_path.c_str(), ec);
+            if (!written || ec) {
+                m_device->getInstance()->error("Failed to write pipeline cache to '%s'", m_path.c_str());
+                std::filesystem::remove(tmpPath.c_str(), ec);
+                return false;
+            }
+
+            return true;
+        }
+
+        void PipelineCache::shutdown() {
+            if (!m_cache) return;
+
+            vkDestroyPipelineCache(m_device->get(), m_cache, m_device->getInstance()->getAllocator());
+            m_cache = VK_NULL_HANDLE;
+        }
+
+        bool PipelineCache::loadData(Array<u8>& data) {
+            FILE* fp = fopen(m_path.c_str(), "rb");
+            if (!fp) return false;
+
+            fseek(fp, 0, SEEK_END);
+            long size = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+
+            if (size <= 0) {
+                fclose(fp);
+                return false;
+            }
+
+            data.reserve(u32(size));
+            for (long i = 0;i < size;i++) data.push(0);
+
+            bool result = fread(data.data(), 1, size_t(size), fp) == size_t(size);
+            fclose(fp);
+
+            if (!result) data.clear();
+            return result;
+        }
+
+        bool PipelineCache::isCompatible(const u8* data, u64 size) const {
+            VkPipelineCacheHeaderVersionOne hdr;
+            if (size < sizeof(hdr)) return false;
+            memcpy(&hdr, data, sizeof(hdr));
+
+            const VkPhysicalDeviceProperties& props = m_device->getPhysicalDevice()->getProperties();
+
+            if (hdr.headerSize < sizeof(hdr) || hdr.headerSize > size) return false;
+            if (hdr.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+            if (hdr.vendorID != props.vendorID) return false;
+            if (hdr.deviceID != props.deviceID) return false;
+            if (memcmp(hdr.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+
+            return true;
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include <render/vulkan/PipelineCompiler.h>
+#include <render/vulkan/GraphicsPipeline.h>
+#include <render/vulkan/ComputePipeline.h>
+
+#include <utils/Array.hpp>
+#include <glslang/Public/ShaderLang.h>
+
+namespace render {
+    namespace vulkan {
+        //
+        // PipelineJob
+        //
+
+        PipelineJob::PipelineJob(PipelineCompiler* compiler) {
+            m_compiler = compiler;
+            m_graphicsPipeline = nullptr;
+            m_computePipeline = nullptr;
+            m_state = js_pending;
+        }
+
+        PipelineJob::~PipelineJob() {
+        }
+
+        bool PipelineJob::isReady() const {
+            return m_state == js_ready;
+        }
+
+        bool PipelineJob::isFailed() const {
+            return m_state == js_failed;
+        }
+
+        bool PipelineJob::isDone() const {
+            u8 state = m_state;
+            return state == js_ready || state == js_failed;
+        }
+
+        Pipeline* PipelineJob::getPipeline(Pipeline* fallback) const {
+            if (m_state != js_ready) return fallback;
+            if (m_graphicsPipeline) return m_graphicsPipeline;
+            return m_computePipeline;
+        }
+
+        void PipelineJob::wait() {
+            std::unique_lock<std::mutex> lock(m_compiler->m_lock);
+            m_compiler->m_jobFinished.wait(lock, [this]() { return isDone(); });
+        }
+
+        bool PipelineJob::execute() {
+            if (m_graphicsPipeline) {
+                GraphicsPipeline* p = m_graphicsPipeline;
+                if (m_vertexShaderSrc.size() > 0 && !p->setVertexShader(m_vertexShaderSrc)) return false;
+                if (m_fragShaderSrc.size() > 0 && !p->setFragmentShader(m_fragShaderSrc)) return false;
+                if (m_geomShaderSrc.size() > 0 && !p->setGeometryShader(m_geomShaderSrc)) return false;
+                return p->init();
+            }
+
+            if (m_computePipeline) {
+                ComputePipeline* p = m_computePipeline;
+                if (!p->setComputeShader(m_computeShaderSrc)) return false;
+                return p->init();
+            }
+
+            return false;
+        }
+
+
+
+
+        //
+        // PipelineCompiler
+        //
+
+        PipelineCompiler::PipelineCompiler(u32 workerCount) : ::utils::IWithLogging("Pipeline Compiler") {
+            m_workerCount = workerCount;
+            if (m_workerCount == 0) {
+                u32 hwThreads = std::thread::hardware_concurrency();
+                m_workerCount = hwThreads > 1 ? hwThreads - 1 : 1;
+            }
+
+            m_isStopping = false;
+            m_activeJobs = 0;
+        }
+
+        PipelineCompiler::~PipelineCompiler() {
+            shutdown();
+
+            m_jobs.each([](PipelineJob* job) {
+                delete job;
+            });
+            m_jobs.clear();
+        }
+
+        bool PipelineCompiler::init() {
+            if (m_workers.size() > 0) return false;
+
+            m_isStopping = false;
+            for (u32 i = 0;i < m_workerCount;i++) {
+                m_workers.emplace_back(&PipelineCompiler::workerMain, this);
+            }
+
+            return true;
+        }
+
+        void PipelineCompiler::shutdown() {
+            if (m_workers.size() == 0) return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_isStopping = true;
+
+                // jobs that never started are failed rather than left hanging
+                while (m_queue.size() > 0) {
+                    m_queue.front()->m_state = PipelineJob::js_failed;
+                    m_queue.pop_front();
+                }
+            }
+
+            m_workAvailable.notify_all();
+            m_jobFinished.notify_all();
+
+            for (u32 i = 0;i < m_workers.size();i++) m_workers[i].join();
+            m_workers.clear();
+        }
+
+        u32 PipelineCompiler::getWorkerCount() const {
+            return m_workerCount;
+        }
+
+        PipelineJob* PipelineCompiler::compile(
+            GraphicsPipeline* pipeline,
+            const String& vertexShader,
+            const String& fragmentShader,
+            const String& geometryShader
+        ) {
+            if (!pipeline) return nullptr;
+
+            PipelineJob* job = new PipelineJob(this);
+            job->m_graphicsPipeline = pipeline;
+            job->m_vertexShaderSrc = vertexShader;
+            job->m_fragShaderSrc = fragmentShader;
+            job->m_geomShaderSrc = geometryShader;
+
+            return enqueue(job);
+        }
+
+        PipelineJob* PipelineCompiler::compile(ComputePipeline* pipeline, const String& computeShader) {
+            if (!pipeline) return nullptr;
+
+            PipelineJob* job = new PipelineJob(this);
+            job->m_computePipeline = pipeline;
+            job->m_computeShaderSrc = computeShader;
+
+            return enqueue(job);
+        }
+
+        void PipelineCompiler::free(PipelineJob* job) {
+            if (!job) return;
+
+            std::unique_lock<std::mutex> lock(m_lock);
+            for (auto it = m_queue.begin();it != m_queue.end();it++) {
+                if (*it != job) continue;
+                m_queue.erase(it);
+                job->m_state = PipelineJob::js_failed;
+                break;
+            }
+
+            m_jobFinished.wait(lock, [job]() { return job->isDone(); });
+
+            i64 idx = m_jobs.findIndex([job](PipelineJob* j) { return j == job; });
+            if (idx != -1) m_jobs.remove(u32(idx));
+
+            delete job;
+        }
+
+        void PipelineCompiler::waitForIdle() {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_jobFinished.wait(lock, [this]() { return m_queue.size() == 0 && m_activeJobs == 0; });
+        }
+
+        PipelineJob* PipelineCompiler::enqueue(PipelineJob* job) {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_jobs.push(job);
+
+                if (m_workers.size() == 0 || m_isStopping) {
+                    error("Pipeline compiler is not running, job will not be processed");
+                    job->m_state = PipelineJob::js_failed;
+                    return job;
+                }
+
+                m_queue.push_back(job);
+            }
+
+            m_workAvailable.notify_one();
+            return job;
+        }
+
+        void PipelineCompiler::workerMain() {
+            // glslang keeps per-thread pools, each worker registers itself as a client
+            glslang::InitializeProcess();
+
+            while (true) {
+                PipelineJob* job = nullptr;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_lock);
+                    m_workAvailable.wait(lock, [this]() { return m_isStopping || m_queue.size() > 0; });
+                    if (m_queue.size() == 0) break;
+
+                    job = m_queue.front();
+                    m_queue.pop_front();
+                    job->m_state = PipelineJob::js_compiling;
+                    m_activeJobs++;
+                }
+
+                bool result = job->execute();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_lock);
+                    job->m_state = result ? PipelineJob::js_ready : PipelineJob::js_failed;
+                    m_activeJobs--;
+                }
+
+                m_jobFinished.notify_all();
+            }
+
+            glslang::FinalizeProcess();
+        }
+    };
+};
\ No newline at end of file
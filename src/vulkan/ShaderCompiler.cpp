@@ -4,11 +4,42 @@
 
 #include <glslang/Public/ShaderLang.h>
 #include <glslang/Public/ResourceLimits.h>
+#include <SPIRV/GlslangToSpv.h>
+#include <SPIRV/Logger.h>
+#include <utils/Array.hpp>
+
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
 
 namespace render {
     namespace vulkan {
-        TBuiltInResource DefaultResources(LogicalDevice* device) {
-            TBuiltInResource Resources;
+        // Bump whenever the compiler settings below change in a way that invalidates cached SPIR-V
+        constexpr u32 SPIRV_CACHE_VERSION = 1;
+        constexpr u32 SPIRV_CACHE_MAGIC = 0x43565053; // 'SPVC'
+        constexpr u32 SPIRV_MAGIC = 0x07230203;
+
+        struct spirv_cache_header {
+            u32 magic;
+            u32 version;
+            u64 key;
+            u32 wordCount;
+            u32 checksum;
+        };
+
+        static u64 fnv1a(const void* data, u64 size, u64 hash = 0xcbf29ce484222325ull) {
+            const u8* bytes = (const u8*)data;
+            for (u64 i = 0;i < size;i++) {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+            }
+
+            return hash;
+        }
+
+        void DefaultResources(LogicalDevice* device, TBuiltInResource& Resources) {
+            // zeroed so that padding bytes are stable, the whole struct gets hashed for the SPIR-V cache
+            memset(&Resources, 0, sizeof(TBuiltInResource));
 
             auto& props = device->getPhysicalDevice()->getProperties();
             auto& limits = props.limits;
@@ -114,13 +145,13 @@ namespace render {
             Resources.limits.generalSamplerIndexing               = 1;
             Resources.limits.generalVariableIndexing              = 1;
             Resources.limits.generalConstantMatrixVectorIndexing  = 1;
-
-            return Resources;
         }
 
         ShaderCompiler::ShaderCompiler(LogicalDevice* device) : utils::IWithLogging("Shader Compiler") {
             m_device = device;
             m_isInitialized = false;
+            m_resourceHash = 0;
+            memset(&m_resources, 0, sizeof(TBuiltInResource));
         }
 
         ShaderCompiler::~ShaderCompiler() {
@@ -129,7 +160,12 @@ namespace render {
 
         bool ShaderCompiler::init() {
             m_isInitialized = glslang::InitializeProcess();
-            return m_isInitialized;
+            if (!m_isInitialized) return false;
+
+            DefaultResources(m_device, m_resources);
+            m_resourceHash = fnv1a(&m_resources, sizeof(TBuiltInResource));
+
+            return true;
         }
 
         void ShaderCompiler::shutdown() {
@@ -137,10 +173,29 @@ namespace render {
 
             glslang::FinalizeProcess();
             m_isInitialized = false;
+
+            std::lock_guard<std::mutex> lock(m_cacheLock);
+            m_cache.clear();
+        }
+
+        void ShaderCompiler::setCacheDirectory(const String& path) {
+            m_cacheDir = path;
+            if (m_cacheDir.size() == 0) return;
+
+            std::error_code ec;
+            std::filesystem::create_directories(m_cacheDir.c_str(), ec);
+            if (ec) {
+                warn("Failed to create shader cache directory '%s', compiled shaders won't be persisted", m_cacheDir.c_str());
+                m_cacheDir = "";
+            }
+        }
+
+        const String& ShaderCompiler::getCacheDirectory() const {
+            return m_cacheDir;
         }
         
         glslang::TShader* ShaderCompiler::compileShader(const String& source, EShLanguage type) {
-            TBuiltInResource resources = DefaultResources(m_device);
+            const TBuiltInResource& resources = m_resources;
             EShMessages messageFlags = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
 
             glslang::TShader* shdr = new glslang::TShader(type);
@@ -181,5 +236,211 @@ namespace render {
 
             return shdr;
         }
+
+        bool ShaderCompiler::compileSpirv(const String& source, EShLanguage type, std::vector<u32>& out, bool* wasCached) {
+            out.clear();
+            if (wasCached) *wasCached = false;
+            if (!m_isInitialized) return false;
+
+            u64 key = hashShader(source, type);
+            if (loadCached(key, out)) {
+                if (wasCached) *wasCached = true;
+                return true;
+            }
+
+            glslang::TShader* shdr = compileShader(source, type);
+            if (!shdr) return false;
+
+            bool result = generateSpirv(shdr, type, out);
+            delete shdr;
+
+            if (!result) {
+                out.clear();
+                return false;
+            }
+
+            storeCached(key, out);
+            return true;
+        }
+
+        bool ShaderCompiler::validateLinkage(const String* sources, const EShLanguage* types, u32 count) {
+            if (!m_isInitialized) return false;
+
+            EShMessages messageFlags = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
+            Array<glslang::TShader*> shaders;
+            bool result = true;
+
+            for (u32 i = 0;i < count;i++) {
+                glslang::TShader* shdr = compileShader(sources[i], types[i]);
+                if (!shdr) {
+                    result = false;
+                    break;
+                }
+
+                shaders.push(shdr);
+            }
+
+            if (result) {
+                // the program references the shaders, so it has to go before they're deleted
+                glslang::TProgram prog;
+                shaders.each([&prog](glslang::TShader* shdr) { prog.addShader(shdr); });
+
+                if (!prog.link(messageFlags)) {
+                    error(String(prog.getInfoLog()));
+                    result = false;
+                }
+            }
+
+            shaders.each([](glslang::TShader* shdr) { delete shdr; });
+            return result;
+        }
+
+        u64 ShaderCompiler::hashShader(const String& source, EShLanguage type) const {
+            u32 env[] = {
+                SPIRV_CACHE_VERSION,
+                u32(type),
+                u32(glslang::EShTargetVulkan_1_3),
+                u32(glslang::EShTargetSpv_1_6),
+                450
+            };
+
+            u64 hash = fnv1a(env, sizeof(env));
+            hash = fnv1a(&m_resourceHash, sizeof(u64), hash);
+            return fnv1a(source.c_str(), source.size(), hash);
+        }
+
+        bool ShaderCompiler::loadCached(u64 key, std::vector<u32>& out) {
+            {
+                std::lock_guard<std::mutex> lock(m_cacheLock);
+                auto it = m_cache.find(key);
+                if (it != m_cache.end()) {
+                    out = it->second;
+                    return true;
+                }
+            }
+
+            if (m_cacheDir.size() == 0) return false;
+
+            String path = String::Format("%s/%016llx.spv", m_cacheDir.c_str(), key);
+            FILE* fp = fopen(path.c_str(), "rb");
+            if (!fp) return false;
+
+            spirv_cache_header hdr;
+            bool valid = fread(&hdr, sizeof(hdr), 1, fp) == 1;
+            valid = valid && hdr.magic == SPIRV_CACHE_MAGIC && hdr.version == SPIRV_CACHE_VERSION;
+            valid = valid && hdr.key == key && hdr.wordCount > 0;
+
+            if (valid) {
+                out.resize(hdr.wordCount);
+                valid = fread(out.data(), sizeof(u32), hdr.wordCount, fp) == hdr.wordCount;
+                valid = valid && out[0] == SPIRV_MAGIC;
+                valid = valid && u32(fnv1a(out.data(), out.size() * sizeof(u32))) == hdr.checksum;
+            }
+
+            fclose(fp);
+
+            if (!valid) {
+                warn("Ignoring invalid shader cache entry '%s'", path.c_str());
+                out.clear();
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(m_cacheLock);
+            m_cache[key] = out;
+            return true;
+        }
+
+        void ShaderCompiler::storeCached(u64 key, const std::vector<u32>& code) {
+            {
+                std::lock_guard<std::mutex> lock(m_cacheLock);
+                m_cache[key] = code;
+            }
+
+            if (m_cacheDir.size() == 0) return;
+
+            spirv_cache_header hdr;
+            hdr.magic = SPIRV_CACHE_MAGIC;
+            hdr.version = SPIRV_CACHE_VERSION;
+            hdr.key = key;
+            hdr.wordCount = u32(code.size());
+            hdr.checksum = u32(fnv1a(code.data(), code.size() * sizeof(u32)));
+
+            // write to a temporary file first so that a concurrent reader never sees a partial entry
+            String path = String::Format("%s/%016llx.spv", m_cacheDir.c_str(), key);
+            String tmpPath = String::Format("%s/%016llx.spv.%p.tmp", m_cacheDir.c_str(), key, (void*)&code);
+
+            FILE* fp = fopen(tmpPath.c_str(), "wb");
+            if (!fp) {
+                warn("Failed to write shader cache entry '%s'", path.c_str());
+                return;
+            }
+
+            bool written = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+            written = written && fwrite(code.data(), sizeof(u32), code.size(), fp) == code.size();
+            fclose(fp);
+
+            std::error_code ec;
+            if (written) std::filesystem::rename(tmpPath.c_str(), path.c_str(), ec);
+            if (!written || ec) {
+                warn("Failed to write shader cache entry '%s'", path.c_str());
+                std::filesystem::remove(tmpPath.c_str(), ec);
+            }
+        }
+
+        bool ShaderCompiler::generateSpirv(glslang::TShader* shader, EShLanguage type, std::vector<u32>& out) {
+            EShMessages messageFlags = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
+
+            glslang::TProgram prog;
+            prog.addShader(shader);
+
+            if (!prog.link(messageFlags)) {
+                error(String(prog.getInfoLog()));
+                return false;
+            }
+
+            glslang::TIntermediate& IR = *(prog.getIntermediate(type));
+
+            glslang::SpvOptions options = {};
+            options.validate = true;
+
+            spv::SpvBuildLogger logger;
+            glslang::GlslangToSpv(IR, out, &logger, &options);
+
+            String allLogs = logger.getAllMessages();
+            auto msgs = allLogs.split("\n");
+            for (u32 i = 0;i < msgs.size();i++) {
+                String& ln = msgs[i];
+
+                i64 idx = -1;
+                
+                idx = ln.firstIndexOf("TBD functionality: ");
+                if (idx > 0) {
+                    log(ln);
+                    continue;
+                }
+                
+                idx = ln.firstIndexOf("Missing functionality: ");
+                if (idx > 0) {
+                    log(ln);
+                    continue;
+                }
+        
+                idx = ln.firstIndexOf("warning: ");
+                if (idx > 0) {
+                    constexpr size_t len = sizeof("warning: ");
+                    warn(String(&ln[len], ln.size() - len));
+                    continue;
+                }
+
+                idx = ln.firstIndexOf("error: ");
+                if (idx > 0) {
+                    constexpr size_t len = sizeof("error: ");
+                    error(String(&ln[len], ln.size() - len));
+                    continue;
+                }
+            }
+
+            return out.size() > 0;
+        }
     };
 };
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include <render/vulkan/StorageBuffer.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/PhysicalDevice.h>
+#include <render/vulkan/Instance.h>
+#include <render/vulkan/CommandBuffer.h>
+#include <render/core/DataFormat.h>
+
+#include <utils/Array.hpp>
+#include <utils/Math.hpp>
+
+#include <numeric>
+
+namespace render {
+    namespace vulkan {
+        //
+        // StorageBuffer
+        //
+
+        StorageBuffer::StorageBuffer(LogicalDevice* device, core::DataFormat* fmt, u32 elementCapacity) : m_granularity(AllocationGranularity(device, fmt)), m_capacity(((elementCapacity + m_granularity - 1) / m_granularity) * m_granularity), m_buffer(device), m_stagingBuffer(device), m_allocator(m_capacity / m_granularity, 1), m_updated(m_capacity) {
+            m_device = device;
+            m_fmt = fmt;
+            m_elementSize = fmt->getStorageBlockSize();
+            m_elements = nullptr;
+            m_maxCopyGap = m_elementSize > 0 ? MaxCopyGapBytes / m_elementSize : 0;
+            m_factory = nullptr;
+            m_heapIndex = 0xFFFFFFFF;
+            m_isQueuedForSubmit = false;
+        }
+
+        StorageBuffer::~StorageBuffer() {
+            shutdown();
+        }
+
+        bool StorageBuffer::init() {
+            if (m_buffer.isValid()) return false;
+
+            bool r;
+
+            r = m_stagingBuffer.init(
+                u64(m_elementSize) * m_capacity,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+
+            if (!r) {
+                shutdown();
+                return false;
+            }
+
+            r = m_buffer.init(
+                u64(m_elementSize) * m_capacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+
+            if (!r) {
+                shutdown();
+                return false;
+            }
+
+            if (!m_stagingBuffer.map()) {
+                m_device->getInstance()->error("Failed to map staging buffer for writing");
+                shutdown();
+                return false;
+            }
+
+            m_elements = (u8*)m_stagingBuffer.getPointer();
+
+            return true;
+        }
+
+        void StorageBuffer::shutdown() {
+            if (m_elements) {
+                m_stagingBuffer.unmap();
+                m_elements = nullptr;
+            }
+
+            m_stagingBuffer.shutdown();
+            m_buffer.shutdown();
+
+            freeAllArrays();
+            m_updated.clear();
+        }
+
+        LogicalDevice* StorageBuffer::getDevice() const {
+            return m_device;
+        }
+
+        core::DataFormat* StorageBuffer::getFormat() const {
+            return m_fmt;
+        }
+
+        VkBuffer StorageBuffer::getBuffer() const {
+            return m_buffer.get();
+        }
+
+        VkDeviceMemory StorageBuffer::getMemory() const {
+            return m_buffer.getMemory();
+        }
+
+        u32 StorageBuffer::getCapacity() const {
+            if (!m_buffer.isValid()) return 0;
+            return m_capacity;
+        }
+
+        u32 StorageBuffer::getCurrentMaximumBlockSize() const {
+            if (!m_buffer.isValid()) return 0;
+            return m_allocator.getLargestFreeRange() * m_granularity;
+        }
+
+        u32 StorageBuffer::getUsedCount() const {
+            return m_allocator.getUsedSize() * m_granularity;
+        }
+
+        u32 StorageBuffer::getElementSize() const {
+            return m_elementSize;
+        }
+
+        StorageArray* StorageBuffer::allocate(u32 count) {
+            if (!m_buffer.isValid() || count == 0) return nullptr;
+
+            core::RangeAllocator::Range* r = m_allocator.allocate((count + m_granularity - 1) / m_granularity);
+            if (!r) return nullptr;
+
+            StorageArray* a = new StorageArray(this, r, count);
+            r->userData = a;
+
+            if (m_factory) m_factory->onCapacityChanged(this);
+            return a;
+        }
+
+        void StorageBuffer::free(StorageArray* arr) {
+            if (!m_buffer.isValid() || !arr || arr->m_buffer != this) return;
+
+            core::RangeAllocator::Range* r = arr->m_range;
+            delete arr;
+
+            m_allocator.free(r);
+            if (m_factory) m_factory->onCapacityChanged(this);
+        }
+
+        bool StorageBuffer::hasUpdates() const {
+            return m_updated.any();
+        }
+
+        void StorageBuffer::submitUpdates(CommandBuffer* cb) {
+            if (!m_buffer.isValid() || !m_updated.any()) return;
+            recordUpdates(cb);
+        }
+
+        u32 StorageBuffer::AllocationGranularity(LogicalDevice* device, core::DataFormat* fmt) {
+            u32 alignment = u32(device->getPhysicalDevice()->getProperties().limits.minStorageBufferOffsetAlignment);
+            u32 stride = fmt->getStorageBlockSize();
+            if (alignment <= 1 || stride == 0) return 1;
+
+            return alignment / std::gcd(stride, alignment);
+        }
+
+        void StorageBuffer::freeAllArrays() {
+            m_allocator.eachAllocated([](core::RangeAllocator::Range* r) {
+                delete (StorageArray*)r->userData;
+            });
+
+            m_allocator.reset();
+        }
+
+        void StorageBuffer::markUpdated(u32 first, u32 count) {
+            m_updated.setRange(first, count);
+
+            if (m_factory && !m_isQueuedForSubmit) {
+                m_factory->m_updatedBuffers.push(this);
+                m_isQueuedForSubmit = true;
+            }
+        }
+
+        void StorageBuffer::recordUpdates(CommandBuffer* cb) {
+            m_copyRanges.clear(false);
+
+            // The staging buffer always holds the latest data for every element, so copying the
+            // unmodified elements between two ranges is harmless
+            m_updated.consumeRuns(m_maxCopyGap, [this](u32 first, u32 count) {
+                m_copyRanges.push({
+                    u64(first) * m_elementSize,
+                    u64(first) * m_elementSize,
+                    u64(count) * m_elementSize
+                });
+            });
+
+            if (m_copyRanges.size() == 0) return;
+
+            vkCmdCopyBuffer(
+                cb->get(),
+                m_stagingBuffer.get(),
+                m_buffer.get(),
+                m_copyRanges.size(),
+                m_copyRanges.data()
+            );
+        }
+
+
+
+        //
+        // StorageArray
+        //
+
+        StorageArray::StorageArray(StorageBuffer* buf, core::RangeAllocator::Range* range, u32 count) {
+            m_buffer = buf;
+            m_range = range;
+            m_count = count;
+        }
+
+        StorageArray::~StorageArray() {
+        }
+
+        u32 StorageArray::getOffset() const {
+            return m_range->offset * m_buffer->m_granularity;
+        }
+
+        u32 StorageArray::getByteOffset() const {
+            return getOffset() * m_buffer->m_elementSize;
+        }
+
+        u32 StorageArray::getSize() const {
+            return m_count * m_buffer->m_elementSize;
+        }
+
+        u32 StorageArray::getCount() const {
+            return m_count;
+        }
+
+        StorageBuffer* StorageArray::getBuffer() const {
+            return m_buffer;
+        }
+
+        void StorageArray::free() {
+            m_buffer->free(this);
+        }
+
+        void* StorageArray::getPointer(u32 idx) const {
+            return m_buffer->m_elements + ((getOffset() + idx) * m_buffer->m_elementSize);
+        }
+
+        void StorageArray::markUpdated(u32 first, u32 count) {
+            if (first >= m_count) return;
+            if (count > m_count - first) count = m_count - first;
+
+            m_buffer->markUpdated(getOffset() + first, count);
+        }
+
+
+
+        //
+        // StorageBufferFactory
+        //
+
+        StorageBufferFactory::StorageBufferFactory(LogicalDevice* device, u32 minBufferCapacity) {
+            m_device = device;
+            m_minBufferCapacity = minBufferCapacity;
+        }
+
+        StorageBufferFactory::~StorageBufferFactory() {
+            freeAll();
+        }
+
+        void StorageBufferFactory::freeAll() {
+            m_buffers.each([](buffer_list* list) {
+                list->buffers.each([](StorageBuffer* buf) {
+                    delete buf;
+                });
+
+                delete list;
+            });
+            m_buffers.clear();
+            m_listMap.clear();
+            m_updatedBuffers.clear();
+        }
+
+        StorageArray* StorageBufferFactory::allocate(core::DataFormat* fmt, u32 count) {
+            buffer_list* list = findList(fmt);
+            if (!list) {
+                list = new buffer_list();
+                list->format = fmt;
+
+                m_listMap[fmt->getHash()].push(list);
+                m_buffers.push(list);
+            }
+
+            // if the buffer with the largest free range can't fit it then none of them can
+            StorageBuffer* buf = list->buffers.top();
+            if (buf && buf->getCurrentMaximumBlockSize() >= count) return buf->allocate(count);
+
+            buf = new StorageBuffer(m_device, list->format, utils::max(m_minBufferCapacity, count));
+            if (!buf->init()) {
+                delete buf;
+                return nullptr;
+            }
+
+            buf->m_factory = this;
+            list->buffers.insert(buf);
+            return buf->allocate(count);
+        }
+
+        void StorageBufferFactory::submitUpdates(CommandBuffer* cb) {
+            bool didCopy = false;
+            for (u32 i = 0;i < m_updatedBuffers.size();i++) {
+                StorageBuffer* buf = m_updatedBuffers[i];
+                buf->m_isQueuedForSubmit = false;
+
+                // may have already been submitted on its own
+                if (!buf->m_buffer.isValid() || !buf->m_updated.any()) continue;
+
+                buf->recordUpdates(cb);
+                didCopy = true;
+            }
+
+            m_updatedBuffers.clear(false);
+            if (!didCopy) return;
+
+            VkMemoryBarrier mb = {};
+            mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                cb->get(),
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1, &mb,
+                0, nullptr,
+                0, nullptr
+            );
+        }
+
+        StorageBufferFactory::buffer_list* StorageBufferFactory::findList(const core::DataFormat* fmt) const {
+            auto it = m_listMap.find(fmt->getHash());
+            if (it == m_listMap.end()) return nullptr;
+
+            const Array<buffer_list*>& lists = it->second;
+            for (u32 i = 0;i < lists.size();i++) {
+                if (lists[i]->format->isEqualTo(fmt)) return lists[i];
+            }
+
+            return nullptr;
+        }
+
+        void StorageBufferFactory::onCapacityChanged(StorageBuffer* buf) {
+            buffer_list* list = findList(buf->m_fmt);
+            if (list) list->buffers.update(buf);
+        }
+    };
+};
\ No newline at end of file
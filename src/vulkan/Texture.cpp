@@ -4,11 +4,14 @@
 #include <render/vulkan/CommandBuffer.h>
 #include <render/vulkan/Instance.h>
 #include <render/vulkan/Format.h>
+#include <render/vulkan/BindlessTable.h>
 
 namespace render {
     namespace vulkan {
         Texture::Texture(LogicalDevice* device) : m_stagingBuffer(device) {
             m_device = device;
+            m_bindlessTable = nullptr;
+            m_bindlessIndex = BindlessTable::InvalidIndex;
             m_format = VK_FORMAT_UNDEFINED;
             m_formatInfo = &getFormatInfo(m_format);
             m_mipLevels = 1;
@@ -16,7 +19,7 @@ namespace render {
             m_arrayLayerCount = 1;
             m_dimensions = vec2ui(0, 0);
             m_image = VK_NULL_HANDLE;
-            m_memory = VK_NULL_HANDLE;
+            m_memory = {};
             m_view = VK_NULL_HANDLE;
             m_sampler = VK_NULL_HANDLE;
         }
@@ -73,6 +76,10 @@ namespace render {
             return m_dimensions;
         }
 
+        u32 Texture::getBindlessIndex() const {
+            return m_bindlessIndex;
+        }
+
         VkImage Texture::get() const {
             return m_image;
         }
@@ -131,22 +138,18 @@ namespace render {
             VkMemoryRequirements memReqs;
             vkGetImageMemoryRequirements(m_device->get(), m_image, &memReqs);
 
-            VkMemoryAllocateInfo allocInfo{};
-            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocInfo.allocationSize = memReqs.size;
-            if (!m_device->getPhysicalDevice()->getMemoryTypeIndex(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocInfo.memoryTypeIndex)) {
-                m_device->getInstance()->error("Failed to find correct memory type for image");
+            if (!m_device->getMemoryAllocator()->allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, m_memory)) {
+                m_device->getInstance()->error("Failed to allocate %llu bytes for image", memReqs.size);
                 shutdown();
                 return false;
             }
 
-            if (vkAllocateMemory(m_device->get(), &allocInfo, nullptr, &m_memory) != VK_SUCCESS) {
+            if (vkBindImageMemory(m_device->get(), m_image, m_memory.memory, m_memory.offset) != VK_SUCCESS) {
+                m_device->getInstance()->error("Failed to bind allocated memory to image");
                 shutdown();
                 return false;
             }
 
-            vkBindImageMemory(m_device->get(), m_image, m_memory, 0);
-
             VkImageViewCreateInfo vi = {};
             vi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
             vi.image = m_image;
@@ -230,6 +233,8 @@ namespace render {
         }
 
         void Texture::shutdown() {
+            if (m_bindlessTable) m_bindlessTable->remove(this);
+
             if (m_sampler) {
                 vkDestroySampler(m_device->get(), m_sampler, m_device->getInstance()->getAllocator());
                 m_sampler = VK_NULL_HANDLE;
@@ -245,10 +250,7 @@ namespace render {
                 m_image = VK_NULL_HANDLE;
             }
 
-            if (m_memory) {
-                vkFreeMemory(m_device->get(), m_memory, m_device->getInstance()->getAllocator());
-                m_memory = VK_NULL_HANDLE;
-            }
+            if (m_memory.block) m_device->getMemoryAllocator()->free(m_memory);
 
             shutdownStagingBuffer();
 
@@ -0,0 +1,222 @@
+#include <render/vulkan/TransferBatch.h>
+#include <render/vulkan/LogicalDevice.h>
+#include <render/vulkan/Instance.h>
+#include <render/vulkan/Buffer.h>
+#include <render/vulkan/CommandBuffer.h>
+#include <render/vulkan/CommandPool.h>
+#include <render/vulkan/Queue.h>
+
+#include <utils/Array.hpp>
+
+#include <string.h>
+
+namespace render {
+    namespace vulkan {
+        TransferBatch::TransferBatch(LogicalDevice* device, u64 stagingBlockSize) {
+            m_device = device;
+            m_stagingBlockSize = stagingBlockSize;
+            m_pendingSize = 0;
+            m_cmdPool = nullptr;
+            m_cmdBuffer = nullptr;
+        }
+
+        TransferBatch::~TransferBatch() {
+            shutdown();
+        }
+
+        LogicalDevice* TransferBatch::getDevice() const {
+            return m_device;
+        }
+
+        bool TransferBatch::hasPending() const {
+            return m_copies.size() > 0;
+        }
+
+        u64 TransferBatch::getPendingSize() const {
+            return m_pendingSize;
+        }
+
+        void* TransferBatch::stage(Buffer* dst, u64 dstOffset, u64 size) {
+            if (!dst || size == 0) return nullptr;
+
+            staging_block* block = getStagingBlock(size);
+            if (!block) return nullptr;
+
+            u64 srcOffset = block->used;
+            block->used += (size + 15) & ~15ull;
+            m_pendingSize += size;
+
+            // merge with the previous copy when it's contiguous on both sides
+            if (m_copies.size() > 0) {
+                pending_copy& last = m_copies.last();
+                if (
+                    last.src == block->buffer &&
+                    last.dst == dst &&
+                    last.region.srcOffset + last.region.size == srcOffset &&
+                    last.region.dstOffset + last.region.size == dstOffset
+                ) {
+                    last.region.size += size;
+                    return block->data + srcOffset;
+                }
+            }
+
+            m_copies.push({
+                block->buffer,
+                dst,
+                { srcOffset, dstOffset, size }
+            });
+
+            return block->data + srcOffset;
+        }
+
+        bool TransferBatch::write(Buffer* dst, u64 dstOffset, const void* data, u64 size) {
+            void* mem = stage(dst, dstOffset, size);
+            if (!mem) return false;
+
+            memcpy(mem, data, size);
+            return true;
+        }
+
+        void TransferBatch::record(CommandBuffer* cb, u32 frameIdx) {
+            if (m_copies.size() == 0) return;
+
+            for (u32 i = 0;i < m_copies.size();) {
+                Buffer* src = m_copies[i].src;
+                Buffer* dst = m_copies[i].dst;
+
+                m_regions.clear(false);
+                for (;i < m_copies.size() && m_copies[i].src == src && m_copies[i].dst == dst;i++) {
+                    m_regions.push(m_copies[i].region);
+                }
+
+                vkCmdCopyBuffer(cb->get(), src->get(), dst->get(), m_regions.size(), m_regions.data());
+            }
+
+            VkMemoryBarrier mb = {};
+            mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            mb.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                cb->get(),
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1, &mb,
+                0, nullptr,
+                0, nullptr
+            );
+
+            m_copies.clear(false);
+            m_pendingSize = 0;
+
+            m_pendingBlocks.each([this, frameIdx](staging_block& b) {
+                b.frameIdx = frameIdx;
+                m_submittedBlocks.push(b);
+            });
+            m_pendingBlocks.clear(false);
+        }
+
+        void TransferBatch::releaseSubmitted(u32 frameIdx) {
+            for (u32 i = 0;i < m_submittedBlocks.size();) {
+                staging_block& b = m_submittedBlocks[i];
+                if (b.frameIdx != frameIdx) {
+                    i++;
+                    continue;
+                }
+
+                // keep one block around so that small uploads don't have to reallocate every time
+                if (m_freeBlocks.size() == 0 && b.buffer->getSize() == m_stagingBlockSize) {
+                    b.used = 0;
+                    m_freeBlocks.push(b);
+                } else {
+                    delete b.buffer;
+                }
+
+                m_submittedBlocks.remove(i);
+            }
+        }
+
+        bool TransferBatch::flush(Queue* queue) {
+            if (m_copies.size() == 0) return true;
+
+            if (!m_cmdPool) {
+                m_cmdPool = new CommandPool(m_device, &queue->getFamily());
+                if (!m_cmdPool->init(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)) {
+                    delete m_cmdPool;
+                    m_cmdPool = nullptr;
+                    return false;
+                }
+
+                m_cmdBuffer = m_cmdPool->createBuffer(true);
+            }
+
+            if (!m_cmdBuffer) return false;
+            if (!m_cmdBuffer->reset()) return false;
+            if (!m_cmdBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) return false;
+
+            record(m_cmdBuffer, FlushFrameIdx);
+
+            if (!m_cmdBuffer->end()) return false;
+            if (!queue->submit(m_cmdBuffer)) return false;
+            if (!queue->waitForIdle()) return false;
+
+            releaseSubmitted(FlushFrameIdx);
+            return true;
+        }
+
+        void TransferBatch::shutdown() {
+            m_pendingBlocks.each([](staging_block& b) { delete b.buffer; });
+            m_submittedBlocks.each([](staging_block& b) { delete b.buffer; });
+            m_freeBlocks.each([](staging_block& b) { delete b.buffer; });
+            m_pendingBlocks.clear();
+            m_submittedBlocks.clear();
+            m_freeBlocks.clear();
+            m_copies.clear();
+            m_pendingSize = 0;
+
+            if (m_cmdPool) {
+                if (m_cmdBuffer) m_cmdPool->freeBuffer(m_cmdBuffer);
+                delete m_cmdPool;
+                m_cmdPool = nullptr;
+                m_cmdBuffer = nullptr;
+            }
+        }
+
+        TransferBatch::staging_block* TransferBatch::getStagingBlock(u64 size) {
+            if (m_pendingBlocks.size() > 0) {
+                staging_block& b = m_pendingBlocks.last();
+                if (b.used + size <= b.buffer->getSize()) return &b;
+            }
+
+            if (m_freeBlocks.size() > 0 && size <= m_stagingBlockSize) {
+                m_pendingBlocks.push(m_freeBlocks.last());
+                m_freeBlocks.remove(m_freeBlocks.size() - 1);
+                return &m_pendingBlocks.last();
+            }
+
+            u64 blockSize = size > m_stagingBlockSize ? size : m_stagingBlockSize;
+
+            Buffer* buf = new Buffer(m_device);
+            if (!buf->init(
+                blockSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            )) {
+                m_device->getInstance()->error("Failed to allocate %llu byte staging buffer", blockSize);
+                delete buf;
+                return nullptr;
+            }
+
+            if (!buf->map()) {
+                m_device->getInstance()->error("Failed to map staging buffer");
+                delete buf;
+                return nullptr;
+            }
+
+            m_pendingBlocks.push({ buf, (u8*)buf->getPointer(), 0, FlushFrameIdx });
+            return &m_pendingBlocks.last();
+        }
+    };
+};
\ No newline at end of file
@@ -15,28 +15,28 @@ namespace render {
         // UniformBuffer
         //
 
-        UniformBuffer::UniformBuffer(LogicalDevice* device, core::DataFormat* fmt, u32 objectCapacity) : m_buffer(device), m_stagingBuffer(device) {
+        UniformBuffer::UniformBuffer(LogicalDevice* device, core::DataFormat* fmt, u32 objectCapacity) : m_buffer(device), m_stagingBuffer(device), m_updated(objectCapacity) {
             m_device = device;
             m_fmt = fmt;
             m_capacity = objectCapacity;
             m_usedCount = 0;
             m_objects = nullptr;
-            m_objUpdated = new u8[m_capacity];
-            m_hasUpdates = false;
-            m_minUpdateIdx = m_capacity;
-            m_maxUpdateIdx = 0;
+            m_factory = nullptr;
+            m_heapIndex = 0xFFFFFFFF;
             m_paddedObjectSize = m_fmt->getUniformBlockSize();
 
             u32 alignment = device->getPhysicalDevice()->getProperties().limits.minUniformBufferOffsetAlignment;
             if (alignment > 0) m_paddedObjectSize = (m_paddedObjectSize + alignment - 1) & ~(alignment - 1);
 
+            m_maxCopyGap = m_paddedObjectSize > 0 ? MaxCopyGapBytes / m_paddedObjectSize : 0;
+            m_isQueuedForSubmit = false;
+
             m_nodes = new UniformObject[m_capacity];
             m_free = m_used = nullptr;
 
             for (u32 i = 0;i < m_capacity;i++) {
                 m_nodes[i].m_buffer = this;
                 m_nodes[i].m_index = i;
-                m_objUpdated[i] = 0;
             }
 
             resetNodes();
@@ -47,9 +47,6 @@ namespace render {
             
             delete [] m_nodes;
             m_nodes = nullptr;
-
-            delete [] m_objUpdated;
-            m_objUpdated = nullptr;
         }
 
         bool UniformBuffer::init() {
@@ -102,11 +99,7 @@ namespace render {
             m_buffer.shutdown();
 
             resetNodes();
-
-            m_hasUpdates = false;
-            m_minUpdateIdx = m_capacity;
-            m_maxUpdateIdx = 0;
-            for (u32 i = 0;i < m_capacity;i++) m_objUpdated[i] = 0;
+            m_updated.clear();
         }
 
         LogicalDevice* UniformBuffer::getDevice() const {
@@ -134,6 +127,10 @@ namespace render {
             return m_capacity - m_usedCount;
         }
 
+        u32 UniformBuffer::getObjectSize() const {
+            return m_paddedObjectSize;
+        }
+
         UniformObject* UniformBuffer::allocate() {
             if (!m_buffer.isValid() || !m_free) return nullptr;
             UniformObject* n = m_free;
@@ -146,6 +143,8 @@ namespace render {
             m_used = n;
 
             m_usedCount++;
+
+            if (m_factory) m_factory->onCapacityChanged(this);
             return n;
         }
 
@@ -159,34 +158,33 @@ namespace render {
             
             insertToFreeList(n);
             m_usedCount--;
+
+            if (m_factory) m_factory->onCapacityChanged(this);
+        }
+
+        bool UniformBuffer::hasUpdates() const {
+            return m_updated.any();
         }
 
         void UniformBuffer::submitUpdates(CommandBuffer* cb) {
-            if (!m_buffer.isValid() || !m_hasUpdates) return;
+            if (!m_buffer.isValid() || !m_updated.any()) return;
+            recordUpdates(cb);
+        }
 
+        void UniformBuffer::recordUpdates(CommandBuffer* cb) {
             m_copyRanges.clear(false);
-            VkBufferCopy* cur = nullptr;
-            bool doStartNewRange = true;
-
-            for (u32 i = m_minUpdateIdx;i <= m_maxUpdateIdx;i++) {
-                if (!m_objUpdated[i]) {
-                    doStartNewRange = true;
-                    continue;
-                }
-
-                m_objUpdated[i] = false;
 
-                if (doStartNewRange) {
-                    m_copyRanges.emplace();
-                    cur = &m_copyRanges.last();
-                    cur->srcOffset = cur->dstOffset = i * m_paddedObjectSize;
-                    cur->size = m_paddedObjectSize;
-                    doStartNewRange = false;
-                    continue;
-                }
+            // The staging buffer always holds the latest data for every object, so copying the
+            // unmodified objects between two ranges is harmless
+            m_updated.consumeRuns(m_maxCopyGap, [this](u32 first, u32 count) {
+                m_copyRanges.push({
+                    u64(first) * m_paddedObjectSize,
+                    u64(first) * m_paddedObjectSize,
+                    u64(count) * m_paddedObjectSize
+                });
+            });
 
-                cur->size += m_paddedObjectSize;
-            }
+            if (m_copyRanges.size() == 0) return;
 
             vkCmdCopyBuffer(
                 cb->get(),
@@ -195,10 +193,6 @@ namespace render {
                 m_copyRanges.size(),
                 m_copyRanges.data()
             );
-
-            m_hasUpdates = false;
-            m_minUpdateIdx = m_capacity;
-            m_maxUpdateIdx = 0;
         }
 
         void UniformBuffer::resetNodes() {
@@ -256,131 +250,29 @@ namespace render {
         
         void UniformBuffer::updateObject(UniformObject* n, const void* data) {
             u32 idx = n->m_index;
-            copyData(m_fmt, (u8*)data, m_objects + (idx * m_paddedObjectSize));
+            m_fmt->packBlock(BL_STD140, data, m_objects + (idx * m_paddedObjectSize));
+            markUpdated(idx);
+        }
+
+        void UniformBuffer::markUpdated(u32 idx) {
+            m_updated.set(idx);
 
-            m_hasUpdates = true;
-            m_objUpdated[idx] = 1;
-            m_minUpdateIdx = utils::min(m_minUpdateIdx, idx);
-            m_maxUpdateIdx = utils::max(m_maxUpdateIdx, idx);
+            if (m_factory && !m_isQueuedForSubmit) {
+                m_factory->m_updatedBuffers.push(this);
+                m_isQueuedForSubmit = true;
+            }
         }
         
-        u8* UniformBuffer::copyData(const core::DataFormat* fmt, const u8* src, u8* dst) {
-            auto& attrs = fmt->getAttributes();
-            for (u32 i = 0;i < attrs.size();i++) {
-                auto& a = attrs[i];
-                switch (a.type) {
-                    case dt_int:
-                    case dt_float:
-                    case dt_uint: {
-                        u32* dstE = (u32*)dst;
-                        const u32* srcE = (u32*)(src + a.offset);
-                        for (u32 c = 0;c < a.elementCount;c++) *(dstE++) = *(srcE++);
-
-                        dst += a.uniformAlignedSize;
-                        break;
-                    }
-                    case dt_vec2i:
-                    case dt_vec2f:
-                    case dt_vec2ui: {
-                        u32* dstE = (u32*)dst;
-                        const u32* srcE = (u32*)(src + a.offset);
-                        for (u32 c = 0;c < a.elementCount;c++) {
-                            *(dstE++) = *(srcE++); // x
-                            *(dstE++) = *(srcE++); // y
-                        }
-
-                        dst += a.uniformAlignedSize;
-                        break;
-                    }
-                    case dt_vec3i:
-                    case dt_vec3f:
-                    case dt_vec3ui: {
-                        u32* dstE = (u32*)dst;
-                        const u32* srcE = (u32*)(src + a.offset);
-                        for (u32 c = 0;c < a.elementCount;c++) {
-                            *(dstE++) = *(srcE++); // x
-                            *(dstE++) = *(srcE++); // y
-                            *(dstE++) = *(srcE++); // z
-                            *(dstE++) = 0; // 4 bytes padding for vulkan only
-                        }
-
-                        dst += a.uniformAlignedSize;
-                        break;
-                    }
-                    case dt_vec4i:
-                    case dt_vec4f:
-                    case dt_vec4ui: {
-                        u32* dstE = (u32*)dst;
-                        const u32* srcE = (u32*)(src + a.offset);
-                        for (u32 c = 0;c < a.elementCount;c++) {
-                            *(dstE++) = *(srcE++); // x
-                            *(dstE++) = *(srcE++); // y
-                            *(dstE++) = *(srcE++); // z
-                            *(dstE++) = *(srcE++); // w
-                        }
-
-                        dst += a.uniformAlignedSize;
-                        break;
-                    }
-                    case dt_mat3i:
-                    case dt_mat3f:
-                    case dt_mat3ui: {
-                        u32* dstE = (u32*)dst;
-                        const u32* srcE = (u32*)(src + a.offset);
-                        for (u32 c = 0;c < a.elementCount;c++) {
-                            *(dstE++) = *(srcE++); // mat.x.x
-                            *(dstE++) = *(srcE++); // mat.x.y
-                            *(dstE++) = *(srcE++); // mat.x.z
-                            *(dstE++) = 0; // 4 bytes padding for vulkan only
-                            *(dstE++) = *(srcE++); // mat.y.x
-                            *(dstE++) = *(srcE++); // mat.y.y
-                            *(dstE++) = *(srcE++); // mat.y.z
-                            *(dstE++) = 0; // 4 bytes padding for vulkan only
-                            *(dstE++) = *(srcE++); // mat.z.x
-                            *(dstE++) = *(srcE++); // mat.z.y
-                            *(dstE++) = *(srcE++); // mat.z.z
-                            *(dstE++) = 0; // 4 bytes padding for vulkan only
-                        }
-
-                        dst += a.uniformAlignedSize;
-                        break;
-                    }
-                    case dt_mat4i:
-                    case dt_mat4f:
-                    case dt_mat4ui: {
-                        u32* dstE = (u32*)dst;
-                        const u32* srcE = (u32*)(src + a.offset);
-                        for (u32 c = 0;c < a.elementCount;c++) {
-                            *(dstE++) = *(srcE++); // mat.x.x
-                            *(dstE++) = *(srcE++); // mat.x.y
-                            *(dstE++) = *(srcE++); // mat.x.z
-                            *(dstE++) = *(srcE++); // mat.x.w
-                            *(dstE++) = *(srcE++); // mat.y.x
-                            *(dstE++) = *(srcE++); // mat.y.y
-                            *(dstE++) = *(srcE++); // mat.y.z
-                            *(dstE++) = *(srcE++); // mat.y.w
-                            *(dstE++) = *(srcE++); // mat.z.x
-                            *(dstE++) = *(srcE++); // mat.z.y
-                            *(dstE++) = *(srcE++); // mat.z.z
-                            *(dstE++) = *(srcE++); // mat.z.w
-                            *(dstE++) = *(srcE++); // mat.w.x
-                            *(dstE++) = *(srcE++); // mat.w.y
-                            *(dstE++) = *(srcE++); // mat.w.z
-                            *(dstE++) = *(srcE++); // mat.w.w
-                        }
-
-                        dst += a.uniformAlignedSize;
-                        break;
-                    }
-                    case dt_struct: {
-                        dst = copyData(a.formatRef, src + a.offset, dst);
-                        break;
-                    }
-                    case dt_enum_count: break;
-                }
-            }
+        bool UniformBuffer::validateLayoutSize(u32 size) const {
+            if (size <= m_paddedObjectSize) return true;
 
-            return dst;
+            m_device->getInstance()->error(
+                "UniformObject::set: Packed layout size (%u bytes) is larger than the objects in this buffer (%u bytes)",
+                size,
+                m_paddedObjectSize
+            );
+
+            return false;
         }
 
 
@@ -407,6 +299,10 @@ namespace render {
             if (size) *size = sz;
         }
 
+        u32 UniformObject::getDynamicOffset() const {
+            return m_index * m_buffer->m_paddedObjectSize;
+        }
+
         void UniformObject::free() {
             m_buffer->free(this);
         }
@@ -427,48 +323,89 @@ namespace render {
         }
 
         void UniformBufferFactory::freeAll() {
-            m_formats.clear();
-            m_buffers.each([](Array<UniformBuffer*>& arr) {
-                arr.each([](UniformBuffer* buf) {
+            m_buffers.each([](buffer_list* list) {
+                list->buffers.each([](UniformBuffer* buf) {
                     delete buf;
                 });
+
+                delete list;
             });
             m_buffers.clear();
+            m_listMap.clear();
+            m_updatedBuffers.clear();
         }
 
         UniformObject* UniformBufferFactory::allocate(core::DataFormat* fmt) {
-            i32 idx = m_formats.findIndex([fmt](core::DataFormat* f) {
-                return f->isEqualTo(fmt);
-            });
-
-            if (idx == -1) {
-                UniformBuffer* buf = new UniformBuffer(m_device, fmt, m_maxObjectsPerBuffer);
-                if (!buf->init()) {
-                    delete buf;
-                    return nullptr;
-                }
-
-                m_formats.push(fmt);
-                m_buffers.push({ buf });
+            buffer_list* list = findList(fmt);
+            if (!list) {
+                list = new buffer_list();
+                list->format = fmt;
 
-                return buf->allocate();
+                m_listMap[fmt->getHash()].push(list);
+                m_buffers.push(list);
             }
 
-            Array<UniformBuffer*>& arr = m_buffers[u32(idx)];
-            UniformBuffer* buf = arr.find([](UniformBuffer* b) {
-                return b->getRemaining() > 0;
-            });
-
-            if (buf) return buf->allocate();
+            UniformBuffer* buf = list->buffers.top();
+            if (buf && buf->getRemaining() > 0) return buf->allocate();
             
-            buf = new UniformBuffer(m_device, fmt, m_maxObjectsPerBuffer);
+            buf = new UniformBuffer(m_device, list->format, m_maxObjectsPerBuffer);
             if (!buf->init()) {
                 delete buf;
                 return nullptr;
             }
 
-            arr.push(buf);
+            buf->m_factory = this;
+            list->buffers.insert(buf);
             return buf->allocate();
         }
+
+        UniformBufferFactory::buffer_list* UniformBufferFactory::findList(const core::DataFormat* fmt) const {
+            auto it = m_listMap.find(fmt->getHash());
+            if (it == m_listMap.end()) return nullptr;
+
+            const Array<buffer_list*>& lists = it->second;
+            for (u32 i = 0;i < lists.size();i++) {
+                if (lists[i]->format->isEqualTo(fmt)) return lists[i];
+            }
+
+            return nullptr;
+        }
+
+        void UniformBufferFactory::onCapacityChanged(UniformBuffer* buf) {
+            buffer_list* list = findList(buf->m_fmt);
+            if (list) list->buffers.update(buf);
+        }
+
+        void UniformBufferFactory::submitUpdates(CommandBuffer* cb) {
+            bool didCopy = false;
+            for (u32 i = 0;i < m_updatedBuffers.size();i++) {
+                UniformBuffer* buf = m_updatedBuffers[i];
+                buf->m_isQueuedForSubmit = false;
+
+                // may have already been submitted on its own
+                if (!buf->m_buffer.isValid() || !buf->m_updated.any()) continue;
+
+                buf->recordUpdates(cb);
+                didCopy = true;
+            }
+
+            m_updatedBuffers.clear(false);
+            if (!didCopy) return;
+
+            VkMemoryBarrier mb = {};
+            mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            mb.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                cb->get(),
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1, &mb,
+                0, nullptr,
+                0, nullptr
+            );
+        }
     };
 };
\ No newline at end of file
@@ -2,12 +2,14 @@
 #include <render/vulkan/LogicalDevice.h>
 #include <render/vulkan/PhysicalDevice.h>
 #include <render/vulkan/Instance.h>
+#include <render/vulkan/TransferBatch.h>
+#include <render/vulkan/CommandBuffer.h>
 #include <render/core/DataFormat.h>
+#include <render/core/Hash.h>
 
 #include <utils/Array.hpp>
 
-#define MAX_NODE_COUNT 1024
-#define MIN_NODE_SIZE 3
+#include <string.h>
 
 namespace render {
     namespace vulkan {
@@ -15,35 +17,67 @@ namespace render {
         // VertexBuffer
         //
 
-        VertexBuffer::VertexBuffer(LogicalDevice* device, core::DataFormat* fmt, u32 vertexCapacity) : m_buffer(device) {
+        VertexBuffer::VertexBuffer(
+            LogicalDevice* device,
+            core::DataFormat* fmt,
+            u32 vertexCapacity,
+            BUFFER_PLACEMENT placement,
+            TransferBatch* transfer
+        ) : m_buffer(device), m_allocator(vertexCapacity) {
             m_device = device;
+            m_placement = placement;
+            m_transfer = transfer;
             m_fmt = fmt;
             m_capacity = vertexCapacity;
-            m_currentMaximumBlockSize = vertexCapacity;
             m_memoryMapRefCount = 0;
-            m_nodeCount = MAX_NODE_COUNT;
-
-            m_unusedNodes = m_nodes = new node[m_nodeCount];
-            m_freeBlocks = m_usedBlocks = nullptr;
-
-            for (u32 i = 0;i < m_nodeCount;i++) m_nodes[i].verts = nullptr;
-
-            resetNodes();
+            m_isDraining = false;
+            m_factory = nullptr;
+            m_heapIndex = 0xFFFFFFFF;
         }
 
         VertexBuffer::~VertexBuffer() {
             shutdown();
-            
-            delete [] m_nodes;
-            m_nodes = nullptr;
         }
 
         bool VertexBuffer::init() {
             if (m_buffer.isValid()) return false;
 
+            u64 size = m_fmt->getSize() * m_capacity;
+
+            // transfer usage is needed for the factory to move vertices between buffers
+            VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+            if (m_placement == BP_DEVICE_LOCAL) {
+                if (!m_transfer) {
+                    m_device->getInstance()->error("Device local vertex buffers require a TransferBatch");
+                    return false;
+                }
+
+                return m_buffer.init(
+                    size,
+                    usage,
+                    VK_SHARING_MODE_EXCLUSIVE,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                );
+            }
+
+            if (m_placement == BP_DEVICE_LOCAL_MAPPED) {
+                bool r = m_buffer.init(
+                    size,
+                    usage,
+                    VK_SHARING_MODE_EXCLUSIVE,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                );
+
+                if (r) return true;
+
+                m_device->getInstance()->warn("Host visible device local memory is unavailable, falling back to host memory");
+                m_placement = BP_HOST_VISIBLE;
+            }
+
             return m_buffer.init(
-                m_fmt->getSize() * m_capacity,
-                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                size,
+                usage,
                 VK_SHARING_MODE_EXCLUSIVE,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
             );
@@ -51,7 +85,8 @@ namespace render {
 
         void VertexBuffer::shutdown() {
             m_buffer.shutdown();
-            resetNodes();
+            freeAllVertices();
+            m_isDraining = false;
         }
 
         LogicalDevice* VertexBuffer::getDevice() const {
@@ -62,6 +97,10 @@ namespace render {
             return m_fmt;
         }
 
+        BUFFER_PLACEMENT VertexBuffer::getPlacement() const {
+            return m_placement;
+        }
+
         VkBuffer VertexBuffer::getBuffer() const {
             return m_buffer.get();
         }
@@ -76,220 +115,100 @@ namespace render {
         }
 
         u32 VertexBuffer::getCurrentMaximumBlockSize() const {
-            if (!m_buffer.isValid()) return 0;
-            return m_currentMaximumBlockSize;
+            if (!m_buffer.isValid() || m_isDraining) return 0;
+            return m_allocator.getLargestFreeRange();
         }
 
-        Vertices* VertexBuffer::allocate(u32 count) {
-            if (!m_buffer.isValid() || !m_freeBlocks) return nullptr;
-
-            node* n = getNode(count);
-            if (!n) return nullptr;
-
-            u32 originalBlockSize = n->size;
-
-            // spawn new node if there's a reasonable amount of remaining space (and more nodes left...)
-            if (n->size > count && (n->size - count) > MIN_NODE_SIZE && m_unusedNodes) {
-                node* split = m_unusedNodes;
-                if (split->next) split->next->last = nullptr;
-                m_unusedNodes = split->next;
-                split->next = nullptr;
-
-                split->offset = n->offset + count;
-                split->size = n->size - count;
-                n->size -= split->size;
-
-                insertToFreeList(split);
-            }
-
-            if (originalBlockSize >= m_currentMaximumBlockSize) {
-                recalculateMaximumBlockSize();
-            }
-
-            n->verts = new Vertices(this, m_fmt, n);
-            return n->verts;
+        u32 VertexBuffer::getUsedCount() const {
+            return m_allocator.getUsedSize();
         }
 
-        void VertexBuffer::free(Vertices* verts) {
-            if (!m_buffer.isValid() || !m_usedBlocks || !verts || verts->m_buffer != this) return;
-
-            node* n = verts->m_node;
-
-            delete n->verts;
-            n->verts = nullptr;
-
-            if (n->last) n->last->next = n->next;
-            if (n->next) n->next->last = n->last;
-
-            if (n == m_usedBlocks) m_usedBlocks = n->next;
-            
-            insertToFreeList(n);
+        u32 VertexBuffer::getAllocationCount() const {
+            return m_allocator.getAllocationCount();
         }
 
-        void VertexBuffer::recalculateMaximumBlockSize() {
-            if (!m_buffer.isValid() || !m_usedBlocks) return;
-
-            m_currentMaximumBlockSize = 0;
-
-            node* n = m_freeBlocks;
-            while (n) {
-                if (n->size > m_currentMaximumBlockSize) m_currentMaximumBlockSize = n->size;
-                n = n->next;
-            }
+        f32 VertexBuffer::getFragmentation() const {
+            return m_allocator.getFragmentation();
         }
 
-        void VertexBuffer::resetNodes() {
-            for (u32 i = 0;i < m_nodeCount;i++) {
-                if (m_nodes[i].verts) delete m_nodes[i].verts;
-                m_nodes[i].verts = nullptr;
-                m_nodes[i].offset = 0;
-                m_nodes[i].size = 0;
-
-                if (i > 0) {
-                    m_nodes[i].last = &m_nodes[i - 1];
-                    m_nodes[i].next = nullptr;
-                    m_nodes[i - 1].next = &m_nodes[i];
-                } else {
-                    m_nodes[i].last = nullptr;
-                    m_nodes[i].next = nullptr;
-                }
-            }
-
-            node* initial = &m_nodes[0];
+        Vertices* VertexBuffer::allocate(u32 count) {
+            if (!m_buffer.isValid() || m_isDraining) return nullptr;
 
-            m_unusedNodes = initial->next;
-            m_freeBlocks = initial;
-            m_usedBlocks = nullptr;
-            if (m_unusedNodes) m_unusedNodes->last = nullptr;
+            core::RangeAllocator::Range* r = m_allocator.allocate(count);
+            if (!r) return nullptr;
 
-            initial->last = nullptr;
-            initial->next = nullptr;
-            initial->offset = 0;
-            initial->size = m_capacity;
+            Vertices* v = new Vertices(this, m_fmt, r, count);
+            r->userData = v;
 
-            m_currentMaximumBlockSize = m_capacity;
+            if (m_factory) m_factory->onCapacityChanged(this);
+            return v;
         }
-    
-        VertexBuffer::node* VertexBuffer::getNode(u32 vcount) {
-            node* minNode = nullptr;
-            node* n = m_freeBlocks;
 
-            while (n) {
-                if (n->size >= vcount && (!minNode || n->size < minNode->size)) minNode = n;
-                n = n->next;
-            }
-
-            if (!minNode) return nullptr;
-
-            if (minNode == m_freeBlocks) {
-                m_freeBlocks = minNode->next;
-                if (m_freeBlocks) m_freeBlocks->last = nullptr;
-            }
+        void VertexBuffer::free(Vertices* verts) {
+            if (!m_buffer.isValid() || !verts || verts->m_buffer != this) return;
 
-            if (minNode->last) minNode->last->next = minNode->next;
-            if (minNode->next) minNode->next->last = minNode->last;
-            
-            minNode->next = m_usedBlocks;
-            if (m_usedBlocks) m_usedBlocks->last = minNode;
-            m_usedBlocks = minNode;
+            core::RangeAllocator::Range* r = verts->m_range;
+            delete verts;
 
-            return minNode;
+            m_allocator.free(r);
+            if (m_factory) m_factory->onCapacityChanged(this);
         }
 
-        void VertexBuffer::recycleNode(node* n) {
-            n->verts = nullptr;
-            n->offset = n->size = 0;
-
-            if (n->last) n->last->next = n->next;
-            if (n->next) n->next->last = n->last;
-
-            n->last = nullptr;
-            n->next = m_unusedNodes;
-            if (n->next) n->next->last = n;
+        void VertexBuffer::freeAllVertices() {
+            m_allocator.eachAllocated([](core::RangeAllocator::Range* r) {
+                delete (Vertices*)r->userData;
+            });
 
-            m_unusedNodes = n;
+            m_allocator.reset();
         }
-    
-        void VertexBuffer::insertToFreeList(node* n) {
-            node* i = m_freeBlocks;
-            while (i) {
-                if (i->offset + i->size > n->offset) {
-                    // this node, and all that follow are after node n. n should be first
-                    i = nullptr;
-                    break;
-                }
-
-                if (!i->next || i->next->offset >= n->offset + n->size) {
-                    // the next node comes after n, or n should be the last node
-                    break;
-                }
 
-                i = i->next;
+        bool VertexBuffer::mapMemory() {
+            if (m_memoryMapRefCount == 0) {
+                if (!m_buffer.map()) return false;
             }
 
-            if (i) {
-                // insert n after i
-                n->next = i->next;
-                n->last = i;
-                i->next = n;
-                if (n->next) n->next->last = n;
-            } else {
-                // insert n at start
-                n->next = m_freeBlocks;
-                n->last = nullptr;
-                m_freeBlocks = n;
-            }
+            m_memoryMapRefCount++;
+            return true;
+        }
 
-            // join with last node if adjacent
-            if (n->last && n->last->offset + n->last->size == n->offset) {
-                // previous node ends at start of current node
-                n->last->size += n->size;
+        void VertexBuffer::unmapMemory() {
+            if (m_memoryMapRefCount == 0) return;
 
-                node* tmp = n->last;
-                recycleNode(n);
-                n = tmp;
-            }
+            m_memoryMapRefCount--;
+            if (m_memoryMapRefCount == 0) m_buffer.unmap();
+        }
 
-            // join with next node if adjacent
-            if (n->next && n->offset + n->size == n->next->offset) {
-                // next node starts at the end of current node
-                n->size += n->next->size;
-                recycleNode(n->next);
-            }
 
-            if (n->size > m_currentMaximumBlockSize) {
-                m_currentMaximumBlockSize = n->size;
-            }
-        }
-    
 
         //
         // Vertices
         //
 
-        Vertices::Vertices(VertexBuffer* buf, core::DataFormat* fmt, VertexBuffer::node* n) {
+        Vertices::Vertices(VertexBuffer* buf, core::DataFormat* fmt, core::RangeAllocator::Range* range, u32 count) {
             m_buffer = buf;
             m_fmt = fmt;
-            m_node = n;
+            m_range = range;
+            m_count = count;
+            m_writePtr = nullptr;
         }
 
         Vertices::~Vertices() {
         }
 
         u32 Vertices::getOffset() const {
-            return m_node->offset;
+            return m_range->offset;
         }
 
         u32 Vertices::getByteOffset() const {
-            return m_node->offset * m_fmt->getSize();
+            return m_range->offset * m_fmt->getSize();
         }
 
         u32 Vertices::getSize() const {
-            return m_node->size * m_fmt->getSize();
+            return m_count * m_fmt->getSize();
         }
 
         u32 Vertices::getCount() const {
-            return m_node->size;
+            return m_count;
         }
 
         VertexBuffer* Vertices::getBuffer() const {
@@ -301,35 +220,42 @@ namespace render {
         }
 
         bool Vertices::beginUpdate() {
-            if (m_buffer->m_memoryMapRefCount == 0) {
-                if (!m_buffer->m_buffer.map()) return false;
+            if (m_buffer->m_placement == BP_DEVICE_LOCAL) {
+                if (m_writePtr) return true;
+
+                m_writePtr = (u8*)m_buffer->m_transfer->stage(&m_buffer->m_buffer, getByteOffset(), getSize());
+                return m_writePtr != nullptr;
             }
-            
-            m_buffer->m_memoryMapRefCount++;
+
+            if (!m_buffer->mapMemory()) return false;
+            m_writePtr = (u8*)m_buffer->m_buffer.getPointer(getByteOffset());
             return true;
         }
         
-        bool Vertices::write(void* data, u32 offset, u32 count) {
-            return m_buffer->m_buffer.write(
-                data,
-                offset * m_fmt->getSize(),
-                count * m_fmt->getSize()
-            );
+        bool Vertices::write(const void* data, u32 offset, u32 count) {
+            if (!m_writePtr || offset + count > m_count) return false;
+
+            memcpy(m_writePtr + (offset * m_fmt->getSize()), data, count * m_fmt->getSize());
+            return true;
         }
 
         bool Vertices::commitUpdate() {
+            if (m_buffer->m_placement == BP_DEVICE_LOCAL) {
+                // the copy was queued when the data was staged
+                if (!m_writePtr) return false;
+                m_writePtr = nullptr;
+                return true;
+            }
+
             if (m_buffer->m_memoryMapRefCount == 0) {
                 m_buffer->m_device->getInstance()->warn("Vertices::commitUpdate called more times than Vertices::beginUpdate");
                 return false;
             }
 
-            bool r = m_buffer->m_buffer.flush(
-                m_node->offset * m_fmt->getSize(),
-                m_node->size * m_fmt->getSize()
-            );
+            bool r = m_buffer->m_buffer.flush(getByteOffset(), getSize());
             
-            m_buffer->m_memoryMapRefCount--;
-            if (m_buffer->m_memoryMapRefCount == 0) m_buffer->m_buffer.unmap();
+            m_writePtr = nullptr;
+            m_buffer->unmapMemory();
 
             return r;
         }
@@ -339,58 +265,270 @@ namespace render {
         // VertexBufferFactory
         //
 
-        VertexBufferFactory::VertexBufferFactory(LogicalDevice* device, u32 minBufferCapacity) {
+        VertexBufferFactory::VertexBufferFactory(LogicalDevice* device, u32 minBufferCapacity, u32 framesInFlight) {
             m_device = device;
             m_minBufferCapacity = minBufferCapacity;
+            m_framesInFlight = framesInFlight;
+            m_transfer = new TransferBatch(device);
         }
 
         VertexBufferFactory::~VertexBufferFactory() {
             freeAll();
+
+            delete m_transfer;
+            m_transfer = nullptr;
         }
 
         void VertexBufferFactory::freeAll() {
-            m_formats.clear();
-            m_buffers.each([](Array<VertexBuffer*>& arr) {
-                arr.each([](VertexBuffer* buf) {
+            m_buffers.each([](buffer_list* list) {
+                list->buffers.each([](VertexBuffer* buf) {
                     delete buf;
                 });
+
+                delete list;
             });
             m_buffers.clear();
-        }
+            m_listMap.clear();
 
-        Vertices* VertexBufferFactory::allocate(core::DataFormat* fmt, u32 count) {
-            i32 idx = m_formats.findIndex([fmt](core::DataFormat* f) {
-                return f->isEqualTo(fmt);
+            m_retired.each([](retired_buffer& r) {
+                delete r.buffer;
             });
+            m_retired.clear();
+        }
 
-            if (idx == -1) {
-                VertexBuffer* buf = new VertexBuffer(m_device, fmt, utils::max(m_minBufferCapacity, count));
-                if (!buf->init()) {
-                    delete buf;
-                    return nullptr;
-                }
+        TransferBatch* VertexBufferFactory::getTransferBatch() const {
+            return m_transfer;
+        }
 
-                m_formats.push(fmt);
-                m_buffers.push({ buf });
+        Vertices* VertexBufferFactory::allocate(core::DataFormat* fmt, u32 count, BUFFER_PLACEMENT placement) {
+            buffer_list* list = findList(fmt, placement);
+            if (!list) {
+                list = new buffer_list();
+                list->format = fmt;
+                list->placement = placement;
+                list->draining = nullptr;
 
-                return buf->allocate(count);
+                m_listMap[ListKey(fmt, placement)].push(list);
+                m_buffers.push(list);
             }
 
-            Array<VertexBuffer*>& arr = m_buffers[u32(idx)];
-            VertexBuffer* buf = arr.find([count](VertexBuffer* b) {
-                return b->getCurrentMaximumBlockSize() >= count;
-            });
-
-            if (buf) return buf->allocate(count);
+            // if the buffer with the largest free range can't fit it then none of them can
+            VertexBuffer* buf = list->buffers.top();
+            if (buf && buf->getCurrentMaximumBlockSize() >= count) return buf->allocate(count);
             
-            buf = new VertexBuffer(m_device, fmt, utils::max(m_minBufferCapacity, count));
+            buf = new VertexBuffer(m_device, list->format, utils::max(m_minBufferCapacity, count), placement, m_transfer);
             if (!buf->init()) {
                 delete buf;
                 return nullptr;
             }
 
-            arr.push(buf);
+            buf->m_factory = this;
+            list->buffers.insert(buf);
             return buf->allocate(count);
         }
+
+        u64 VertexBufferFactory::ListKey(const core::DataFormat* fmt, BUFFER_PLACEMENT placement) {
+            return core::HashCombine(fmt->getHash(), u64(placement));
+        }
+
+        VertexBufferFactory::buffer_list* VertexBufferFactory::findList(const core::DataFormat* fmt, BUFFER_PLACEMENT placement) const {
+            auto it = m_listMap.find(ListKey(fmt, placement));
+            if (it == m_listMap.end()) return nullptr;
+
+            const Array<buffer_list*>& lists = it->second;
+            for (u32 i = 0;i < lists.size();i++) {
+                if (lists[i]->placement == placement && lists[i]->format->isEqualTo(fmt)) return lists[i];
+            }
+
+            return nullptr;
+        }
+
+        void VertexBufferFactory::onCapacityChanged(VertexBuffer* buf) {
+            buffer_list* list = findList(buf->m_fmt, buf->m_placement);
+            if (list) list->buffers.update(buf);
+        }
+
+        u64 VertexBufferFactory::defragment(CommandBuffer* cb, u64 maxBytes, f32 maxOccupancy) {
+            releaseRetiredBuffers();
+
+            // staged uploads would land in the old location if vertices were moved before they're recorded
+            if (m_transfer->hasPending()) return 0;
+
+            u64 bytesMoved = 0;
+            u64 bytesCopiedOnDevice = 0;
+            for (u32 i = 0;i < m_buffers.size() && bytesMoved < maxBytes;i++) {
+                buffer_list* list = m_buffers[i];
+                if (list->buffers.size() < 2) continue;
+
+                VertexBuffer* src = list->draining;
+                if (!src) {
+                    f32 minOccupancy = maxOccupancy;
+                    for (u32 b = 0;b < list->buffers.size();b++) {
+                        VertexBuffer* buf = list->buffers[b];
+                        f32 occupancy = f32(buf->getUsedCount()) / f32(buf->m_capacity);
+                        if (occupancy < minOccupancy) {
+                            minOccupancy = occupancy;
+                            src = buf;
+                        }
+                    }
+
+                    if (!src) continue;
+
+                    // Only drain the buffer if everything in it can fit in the others
+                    u32 freeElsewhere = 0;
+                    for (u32 b = 0;b < list->buffers.size();b++) {
+                        if (list->buffers[b] != src) freeElsewhere += list->buffers[b]->m_allocator.getFreeSize();
+                    }
+
+                    if (freeElsewhere < src->getUsedCount()) continue;
+
+                    src->m_isDraining = true;
+                    list->draining = src;
+                    list->buffers.update(src);
+                }
+
+                u64 moved = drainBuffer(list, src, maxBytes - bytesMoved, cb);
+                if (list->placement == BP_DEVICE_LOCAL) bytesCopiedOnDevice += moved;
+                bytesMoved += moved;
+            }
+
+            if (bytesCopiedOnDevice > 0) {
+                VkMemoryBarrier mb = {};
+                mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                mb.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+                vkCmdPipelineBarrier(
+                    cb->get(),
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    0,
+                    1, &mb,
+                    0, nullptr,
+                    0, nullptr
+                );
+            }
+
+            return bytesMoved;
+        }
+
+        u64 VertexBufferFactory::drainBuffer(buffer_list* list, VertexBuffer* src, u64 maxBytes, CommandBuffer* cb) {
+            u32 vertexSize = list->format->getSize();
+            u64 bytesMoved = 0;
+            bool isDrained = true;
+            VertexBuffer* dst = nullptr;
+
+            /*
+             * Moved vertices point at their new range straight away. If the new range was filled by a
+             * copy recorded to cb, an update made to it before cb executes would be overwritten with the
+             * old data, so host visible vertices are copied on the CPU instead
+             */
+            bool copyOnHost = list->placement != BP_DEVICE_LOCAL;
+            if (copyOnHost && !src->mapMemory()) return 0;
+
+            m_copyRegions.clear(false);
+
+            src->m_allocator.eachAllocated([&](core::RangeAllocator::Range* r) {
+                Vertices* v = (Vertices*)r->userData;
+
+                // already moved, the range stays allocated until the whole buffer is released
+                if (!v) return;
+
+                // vertices that are being written can't be moved until the update is committed
+                if (v->m_writePtr || (bytesMoved > 0 && bytesMoved + v->getSize() > maxBytes)) {
+                    isDrained = false;
+                    return;
+                }
+
+                // src is draining so it always reports no free space and can't be on top
+                VertexBuffer* target = list->buffers.top();
+                if (!target || target == src || target->getCurrentMaximumBlockSize() < v->m_count) {
+                    isDrained = false;
+                    return;
+                }
+
+                if (target != dst) {
+                    if (m_copyRegions.size() > 0) {
+                        vkCmdCopyBuffer(cb->get(), src->m_buffer.get(), dst->m_buffer.get(), m_copyRegions.size(), m_copyRegions.data());
+                        m_copyRegions.clear(false);
+                    }
+
+                    if (copyOnHost) {
+                        if (dst) dst->unmapMemory();
+                        dst = nullptr;
+
+                        if (!target->mapMemory()) {
+                            isDrained = false;
+                            return;
+                        }
+                    }
+
+                    dst = target;
+                }
+
+                core::RangeAllocator::Range* nr = dst->m_allocator.allocate(v->m_count);
+                if (!nr) {
+                    isDrained = false;
+                    return;
+                }
+
+                list->buffers.update(dst);
+
+                VkBufferCopy region = {
+                    u64(r->offset) * vertexSize,
+                    u64(nr->offset) * vertexSize,
+                    u64(v->m_count) * vertexSize
+                };
+
+                if (copyOnHost) {
+                    // nothing reads the new range until cb is submitted, and the old range stays intact
+                    // for frames that are still in flight
+                    src->m_buffer.fetch(region.srcOffset, region.size);
+                    memcpy(dst->m_buffer.getPointer(region.dstOffset), src->m_buffer.getPointer(region.srcOffset), region.size);
+                    dst->m_buffer.flush(region.dstOffset, region.size);
+                } else m_copyRegions.push(region);
+
+                r->userData = nullptr;
+                nr->userData = v;
+                v->m_buffer = dst;
+                v->m_range = nr;
+
+                bytesMoved += v->getSize();
+            });
+
+            if (m_copyRegions.size() > 0) {
+                vkCmdCopyBuffer(cb->get(), src->m_buffer.get(), dst->m_buffer.get(), m_copyRegions.size(), m_copyRegions.data());
+                m_copyRegions.clear(false);
+            }
+
+            if (copyOnHost) {
+                if (dst) dst->unmapMemory();
+                src->unmapMemory();
+            }
+
+            if (isDrained) {
+                // frames that were recorded before this one may still be reading from it
+                list->buffers.remove(src);
+                list->draining = nullptr;
+                src->m_factory = nullptr;
+                m_retired.push({ src, m_framesInFlight + 1 });
+            }
+
+            return bytesMoved;
+        }
+
+        void VertexBufferFactory::releaseRetiredBuffers() {
+            for (u32 i = 0;i < m_retired.size();) {
+                retired_buffer& r = m_retired[i];
+                if (r.framesRemaining > 0) {
+                    r.framesRemaining--;
+                    i++;
+                    continue;
+                }
+
+                delete r.buffer;
+                m_retired.remove(i);
+            }
+        }
     };
 };
\ No newline at end of file